@@ -0,0 +1,330 @@
+// Bus throughput and latency benchmark. Runs workload mixes through the real
+// master and slave code on the simulated bus (test/susi_bus_sim.h) and prints
+// one JSON document. All figures except wall_ms are in virtual time and do not
+// depend on the machine, so they can be compared across releases.
+//
+//   run_bus_benchmarks [--quick] [--out FILE]
+
+#include "susi_bus_sim.h"
+#include "susi_master.h"
+#include "susi_slave.h"
+#include "susi_commands.h"
+#include "EEPROM.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int SLAVES = 3;
+
+// Gaps between edges up to this long count as bus time; bits are 20us apart
+const uint32_t BUSY_GAP_NS = 100000;
+
+// A master and three slaves with module numbers 1-3
+struct Bus {
+    SusiBusSim sim;
+    SusiSimNode& master_node;
+    SusiSimNode* slave_nodes[SLAVES];
+    SusiHAL master_hal;
+    SUSI_Master master;
+    SUSI_Master_API api;
+    SusiHAL* slave_hals[SLAVES];
+    SUSI_Slave* slaves[SLAVES];
+
+    // Virtual times at which each slave's main loop handled a packet, host
+    // calls aside
+    std::vector<uint64_t> handled_ns[SLAVES];
+
+    explicit Bus(const SusiBusSimConfig& config)
+        : sim(config), master_node(sim.addNode()),
+          master_hal(master_node.clockPin(), master_node.dataPin()),
+          master(master_hal), api(master) {
+        for (int i = 0; i < SLAVES; i++) {
+            slave_nodes[i] = &sim.addNode();
+            slave_hals[i] = new SusiSimHAL(sim, *slave_nodes[i]);
+            slaves[i] = new SUSI_Slave(*slave_hals[i]);
+            SUSI_Slave* slave = slaves[i];
+            std::vector<uint64_t>* handled = &handled_ns[i];
+            SusiBusSim* bus_sim = &sim;
+            slave_nodes[i]->setLoop([slave, handled, bus_sim]() {
+                                        SUSI_Packet packet = slave->read();
+                                        if (packet.command != SUSI_CMD_BIDI_HOST_CALL) {
+                                            handled->push_back(bus_sim->now());
+                                        }
+                                    },
+                                    [slave]() { return slave->available(); });
+        }
+        api.begin();
+        for (int i = 0; i < SLAVES; i++) {
+            SUSI_Slave* slave = slaves[i];
+            uint8_t address = i + 1;
+            sim.runOn(*slave_nodes[i], [slave, address]() { slave->begin(address); });
+        }
+    }
+
+    ~Bus() {
+        for (int i = 0; i < SLAVES; i++) {
+            delete slaves[i];
+            delete slave_hals[i];
+        }
+    }
+};
+
+struct Result {
+    std::string name;
+    std::string description;
+    uint64_t commands = 0;
+    uint64_t errors = 0;
+    uint64_t virtual_ns = 0;
+    uint64_t busy_ns = 0;
+    std::vector<uint64_t> latency_ns;
+    double wall_ms = 0;
+};
+
+uint64_t percentile(std::vector<uint64_t> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)(p * values.size() + 0.999999);
+    return values[rank > 0 ? rank - 1 : 0];
+}
+
+// Runs a workload on a fresh bus and measures it from its first command on
+Result run(const char* name, const char* description,
+           const std::function<void(Bus&, Result&)>& workload) {
+    mock_hal_reset();
+    EEPROM.clear();
+    SusiBusSimConfig config;
+    config.record_activity = true;
+    Bus bus(config);
+
+    Result result;
+    result.name = name;
+    result.description = description;
+    auto wall_start = std::chrono::steady_clock::now();
+    uint64_t start_ns = bus.sim.now();
+    workload(bus, result);
+    result.virtual_ns = bus.sim.now() - start_ns;
+    result.busy_ns = bus.sim.busyTime(start_ns, bus.sim.now(), BUSY_GAP_NS);
+    result.wall_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - wall_start).count();
+    return result;
+}
+
+// Commands whose end is the slave's main loop handling the packet. The slave
+// may get to it after the master has moved on, so the handling times are
+// matched to the commands once the bus has settled.
+void sendToSlaves(Bus& bus, Result& result, int count,
+                  const std::function<SusiMasterResult(Bus&, int, uint8_t)>& command) {
+    std::vector<uint64_t> issued_ns[SLAVES];
+    for (int i = 0; i < count; i++) {
+        int slave = i % SLAVES;
+        issued_ns[slave].push_back(bus.sim.now());
+        if (command(bus, i, slave + 1) != SUCCESS) {
+            result.errors++;
+        }
+        result.commands++;
+    }
+    bus.sim.runFor(20000);
+    for (int slave = 0; slave < SLAVES; slave++) {
+        const std::vector<uint64_t>& handled = bus.handled_ns[slave];
+        if (handled.size() != issued_ns[slave].size()) {
+            result.errors++;
+            continue;
+        }
+        for (size_t i = 0; i < handled.size(); i++) {
+            result.latency_ns.push_back(handled[i] - issued_ns[slave][i]);
+        }
+    }
+}
+
+// Commands that end when the API call returns
+void timeCall(Bus& bus, Result& result, const std::function<SusiMasterResult()>& call) {
+    uint64_t start_ns = bus.sim.now();
+    if (call() != SUCCESS) {
+        result.errors++;
+    }
+    result.latency_ns.push_back(bus.sim.now() - start_ns);
+    result.commands++;
+}
+
+// BiDi messages, from queueing on the slave to the master's event callback
+struct BidiProbe {
+    Bus* bus;
+    uint64_t queued_ns[SLAVES];
+    Result* result;
+};
+
+BidiProbe bidi_probe;
+
+void onBidiEvent(uint8_t address, uint8_t header, uint8_t data) {
+    (void)data;
+    if (header != SUSI_MSG_BIDI_ANALOG_A || address < 1 || address > SLAVES) {
+        return;
+    }
+    bidi_probe.result->latency_ns.push_back(bidi_probe.bus->sim.now() -
+                                            bidi_probe.queued_ns[address - 1]);
+}
+
+void enableBidi(Bus& bus, Result& result) {
+    bidi_probe.bus = &bus;
+    bidi_probe.result = &result;
+    for (int i = 0; i < SLAVES; i++) {
+        SUSI_Slave* slave = bus.slaves[i];
+        bus.sim.runOn(*bus.slave_nodes[i], [slave]() { slave->enableBidirectionalMode(); });
+        bus.api.registerBiDiSlave(i + 1);
+    }
+    bus.api.onBidiEvent(onBidiEvent);
+}
+
+void queueBidiValue(Bus& bus, int slave, uint8_t value) {
+    SUSI_Slave* target = bus.slaves[slave];
+    bus.sim.runOn(*bus.slave_nodes[slave], [&bus, target, slave, value]() {
+        bidi_probe.queued_ns[slave] = bus.sim.now();
+        target->sendAnalogValue(0, value);
+    });
+}
+
+void printJson(FILE* out, const std::vector<Result>& results, bool quick) {
+    SusiBusSimConfig config;
+    fprintf(out, "{\n");
+    fprintf(out, "  \"benchmark\": \"susi_bus\",\n");
+    fprintf(out, "  \"quick\": %s,\n", quick ? "true" : "false");
+    fprintf(out, "  \"slaves\": %d,\n", SLAVES);
+    fprintf(out, "  \"propagation_ns\": %u,\n", config.propagation_ns);
+    fprintf(out, "  \"loop_latency_ns\": %u,\n", config.loop_latency_ns);
+    fprintf(out, "  \"workloads\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        double seconds = r.virtual_ns / 1e9;
+        fprintf(out, "    {\n");
+        fprintf(out, "      \"name\": \"%s\",\n", r.name.c_str());
+        fprintf(out, "      \"description\": \"%s\",\n", r.description.c_str());
+        fprintf(out, "      \"commands\": %llu,\n", (unsigned long long)r.commands);
+        fprintf(out, "      \"errors\": %llu,\n", (unsigned long long)r.errors);
+        fprintf(out, "      \"virtual_s\": %.6f,\n", seconds);
+        fprintf(out, "      \"commands_per_s\": %.2f,\n", seconds > 0 ? r.commands / seconds : 0.0);
+        fprintf(out, "      \"bus_utilization\": %.4f,\n",
+                r.virtual_ns > 0 ? (double)r.busy_ns / r.virtual_ns : 0.0);
+        fprintf(out, "      \"latency_us\": {\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f},\n",
+                percentile(r.latency_ns, 0.50) / 1e3, percentile(r.latency_ns, 0.99) / 1e3,
+                percentile(r.latency_ns, 1.0) / 1e3);
+        fprintf(out, "      \"wall_ms\": %.1f\n", r.wall_ms);
+        fprintf(out, "    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    const char* out_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--quick] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    const int scale = quick ? 1 : 10;
+
+    std::vector<Result> results;
+
+    results.push_back(run("refresh",
+                          "setSpeed and setFunction round robin; latency to the slave's main loop",
+                          [scale](Bus& bus, Result& result) {
+        sendToSlaves(bus, result, 60 * scale, [](Bus& b, int i, uint8_t address) {
+            if (i % 2 == 0) {
+                return b.api.setSpeed(address, (i / 2) % 128, true);
+            }
+            return b.api.setFunction(address, (i / 2) % 13, (i / 6) % 2 == 0);
+        });
+    }));
+
+    results.push_back(run("refresh_bidi",
+                          "setFunction round robin, three BiDi modules polled after each round",
+                          [scale](Bus& bus, Result& result) {
+        enableBidi(bus, result);
+        // Only the function updates are measured, the polls are background load
+        Result polls;
+        bidi_probe.result = &polls;
+        sendToSlaves(bus, result, 60 * scale, [](Bus& b, int i, uint8_t address) {
+            SusiMasterResult r = b.api.setFunction(address, (i / 3) % 13, (i / 9) % 2 == 0);
+            if (address == SLAVES) {
+                b.api.pollSlaves();
+            }
+            return r;
+        });
+    }));
+
+    results.push_back(run("bidi_polling",
+                          "three BiDi modules each queue a value, then one poll; latency from queueing to the event",
+                          [scale](Bus& bus, Result& result) {
+        enableBidi(bus, result);
+        for (int round = 0; round < 20 * scale; round++) {
+            for (int i = 0; i < SLAVES; i++) {
+                queueBidiValue(bus, i, round % 256);
+            }
+            size_t received = result.latency_ns.size();
+            bus.api.pollSlaves();
+            result.commands += SLAVES;
+            result.errors += SLAVES - (result.latency_ns.size() - received);
+        }
+    }));
+
+    results.push_back(run("cv_programming", "writeCV followed by a verifying readCV",
+                          [scale](Bus& bus, Result& result) {
+        for (int i = 0; i < 10 * scale; i++) {
+            uint8_t address = 1 + i % SLAVES;
+            uint16_t cv = 2 + (i / SLAVES) % 16;
+            uint8_t value = (uint8_t)(i * 7);
+            timeCall(bus, result, [&]() { return bus.api.writeCV(address, cv, value); });
+            uint8_t read = 0;
+            timeCall(bus, result, [&]() {
+                SusiMasterResult r = bus.api.readCV(address, cv, read);
+                return r == SUCCESS && read != value ? INVALID_ACK : r;
+            });
+        }
+    }));
+
+    results.push_back(run("bank_reads", "readCVBank of banks 0-2 round robin",
+                          [scale](Bus& bus, Result& result) {
+        uint8_t bank[SUSI_CV_BANK_SIZE];
+        for (int i = 0; i < 6 * scale; i++) {
+            uint8_t address = 1 + i % SLAVES;
+            uint8_t index = (i / SLAVES) % 3;
+            timeCall(bus, result, [&]() { return bus.api.readCVBank(address, index, bank); });
+        }
+    }));
+
+    FILE* out = stdout;
+    if (out_path != nullptr) {
+        out = fopen(out_path, "w");
+        if (out == nullptr) {
+            perror(out_path);
+            return 2;
+        }
+    }
+    printJson(out, results, quick);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].errors > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+#include "susi_crc.h"
+#include <vector>
+
+namespace {
+
+// crc16_ccitt() before SusiCRC: a bit-at-a-time loop
+uint16_t bitwiseCRC16(const uint8_t* data, int length) {
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int j = 0; j < 8; j++) {
+            if (crc & 0x8000) {
+                crc = (crc << 1) ^ 0x1021;
+            } else {
+                crc <<= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+uint8_t bitwiseCRC8(const uint8_t* data, int length) {
+    uint8_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int j = 0; j < 8; j++) {
+            crc = crc & 0x01 ? (crc >> 1) ^ 0x8C : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+typedef SusiCRC<uint16_t, 16, 0x1021, 0xFFFF, false, false> CRC16Bytes;
+typedef SusiCRC<uint16_t, 16, 0x1021, 0xFFFF, false, true> CRC16Nibbles;
+typedef SusiCRC<uint8_t, 8, 0x31, 0x00, true, false> CRC8Bytes;
+typedef SusiCRC<uint8_t, 8, 0x31, 0x00, true, true> CRC8Nibbles;
+
+std::vector<uint8_t> testData(size_t length) {
+    std::vector<uint8_t> data(length);
+    for (size_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)(i * 37);
+    }
+    return data;
+}
+
+template <class CRC>
+void BM_Table(benchmark::State& state) {
+    std::vector<uint8_t> data = testData(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CRC::compute(data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+template <class Result, Result (*Function)(const uint8_t*, int)>
+void BM_Bitwise(benchmark::State& state) {
+    std::vector<uint8_t> data = testData(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Function(data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+// One byte at a time, as the bytes of a bank read arrive
+template <class CRC>
+void BM_Update(benchmark::State& state) {
+    CRC crc;
+    uint8_t byte = 0;
+    for (auto _ : state) {
+        crc.update(byte++);
+        benchmark::DoNotOptimize(crc.value());
+    }
+    state.SetBytesProcessed(state.iterations());
+}
+
+} // namespace
+
+// 6 bytes: a CV log record; 40 bytes: a CV bank
+BENCHMARK_TEMPLATE(BM_Bitwise, uint16_t, bitwiseCRC16)->Arg(6)->Arg(40);
+BENCHMARK_TEMPLATE(BM_Table, CRC16Bytes)->Arg(6)->Arg(40);
+BENCHMARK_TEMPLATE(BM_Table, CRC16Nibbles)->Arg(6)->Arg(40);
+BENCHMARK_TEMPLATE(BM_Bitwise, uint8_t, bitwiseCRC8)->Arg(40);
+BENCHMARK_TEMPLATE(BM_Table, CRC8Bytes)->Arg(40);
+BENCHMARK_TEMPLATE(BM_Table, CRC8Nibbles)->Arg(40);
+BENCHMARK_TEMPLATE(BM_Update, CRC8Bytes);
+BENCHMARK_TEMPLATE(BM_Update, CRC8Nibbles);
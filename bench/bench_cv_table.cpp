@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+#include "susi_cv_table.h"
+
+namespace {
+
+// The CV storage used by SUSI_Slave before SusiCVTable: two parallel arrays
+// of 32 entries searched linearly.
+class LinearCVTable {
+public:
+    static const uint8_t CAPACITY = 32;
+
+    bool get(uint16_t cv, uint8_t& value) const {
+        for (int i = 0; i < _count; i++) {
+            if (_keys[i] == cv) {
+                value = _values[i];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool set(uint16_t cv, uint8_t value) {
+        for (int i = 0; i < _count; i++) {
+            if (_keys[i] == cv) {
+                _values[i] = value;
+                return true;
+            }
+        }
+        if (_count >= CAPACITY) {
+            return false;
+        }
+        _keys[_count] = cv;
+        _values[_count] = value;
+        _count++;
+        return true;
+    }
+
+private:
+    uint16_t _keys[CAPACITY];
+    uint8_t _values[CAPACITY];
+    uint8_t _count = 0;
+};
+
+// A typical sound module: a few CVs below the window, the rest in 897–1024.
+template <class Table>
+void fill(Table& table, int count) {
+    for (int i = 0; i < count; i++) {
+        uint16_t cv = i < 8 ? 2 + i * 5 : SUSI_CV_WINDOW_START + i - 8;
+        table.set(cv, i);
+    }
+}
+
+template <class Table>
+void BM_Lookup(benchmark::State& state) {
+    Table table;
+    fill(table, state.range(0));
+    uint16_t cv = SUSI_CV_WINDOW_START;
+    for (auto _ : state) {
+        uint8_t value = 0;
+        benchmark::DoNotOptimize(table.get(cv, value));
+        benchmark::DoNotOptimize(value);
+        cv = cv == 1023 ? 0 : cv + 1;
+    }
+}
+
+template <class Table>
+void BM_Update(benchmark::State& state) {
+    Table table;
+    fill(table, state.range(0));
+    uint16_t cv = SUSI_CV_WINDOW_START;
+    uint8_t value = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.set(cv, value++));
+        cv = cv == 1023 ? SUSI_CV_WINDOW_START : cv + 1;
+    }
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_Lookup, LinearCVTable)->Arg(32);
+BENCHMARK_TEMPLATE(BM_Lookup, SusiCVTable)->Arg(32)->Arg(MAX_CVS);
+BENCHMARK_TEMPLATE(BM_Update, LinearCVTable)->Arg(32);
+BENCHMARK_TEMPLATE(BM_Update, SusiCVTable)->Arg(32)->Arg(MAX_CVS);
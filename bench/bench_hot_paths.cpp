@@ -0,0 +1,177 @@
+#include <benchmark/benchmark.h>
+#include "susi_master.h"
+#include "susi_slave.h"
+#include "susi_commands.h"
+#include "EEPROM.h"
+
+// The functions that run for every bit or packet on the bus, with the slave
+// holding 32 CVs or the whole table, and with traffic for the slave or for
+// another module. The slave's clock interrupt is called directly, as the real
+// ISR, with the data bit taken from BenchHAL.
+
+namespace {
+
+const uint8_t BENCH_CLOCK_PIN = 2;
+const uint8_t BENCH_DATA_PIN = 3;
+const uint8_t BENCH_ADDRESS = 1;
+const uint8_t FOREIGN_ADDRESS = 2;
+
+// A HAL without I/O: reads return the bit set by the benchmark, writes and
+// ACKs do nothing.
+class BenchHAL : public SusiHAL {
+public:
+    BenchHAL() : SusiHAL(BENCH_CLOCK_PIN, BENCH_DATA_PIN), data(true) {}
+
+    bool data;
+
+    void begin() override {}
+    void set_clock_high() override {}
+    void set_clock_low() override {}
+    void generate_clock_pulse() override {}
+    void set_data_high() override {}
+    void set_data_low() override {}
+    bool read_data() override { return data; }
+    bool read_clock() override { return false; }
+    bool read_bit() override { return data; }
+    SusiMasterResult waitForAck(uint32_t) override { return SUCCESS; }
+    void sendAck() override {}
+    void sendAckFromISR() override {}
+    void release_data() override {}
+    bool sendByte(uint8_t byte) override {
+        (void)byte;
+        return true;
+    }
+};
+
+// A slave with the given number of CVs stored through CV write packets: the
+// window 897–1024 first, the rest below it.
+struct BenchSlave {
+    BenchHAL hal;
+    SUSI_Slave slave;
+    void (*clock_isr)();
+
+    explicit BenchSlave(int cvs) : slave(hal) {
+        mock_hal_reset();
+        EEPROM.clear();
+        slave.begin(BENCH_ADDRESS);
+        clock_isr = isr_map[BENCH_CLOCK_PIN];
+        for (int i = 0; i < cvs; i++) {
+            uint16_t cv = i < 128 ? SUSI_CV_WINDOW_START + i : i - 128;
+            writeCV(cv, 0x80 | (i & 0x7F));
+        }
+    }
+
+    void writeCV(uint16_t cv, uint8_t value) {
+        receive({BENCH_ADDRESS, SUSI_CMD_WRITE_CV, (uint8_t)(cv >> 8)});
+        receive({BENCH_ADDRESS, (uint8_t)(cv & 0xFF), value});
+    }
+
+    void receive(const SUSI_Packet& packet) {
+        slave._test_receive_packet(packet);
+        slave.read();
+    }
+
+    // Clocks a packet in bit by bit: start bit, 24 data bits and stop bit
+    void clockIn(const uint8_t* frame) {
+        hal.data = false;
+        clock_isr();
+        for (int i = 0; i < 24; i++) {
+            hal.data = (frame[i / 8] >> (i % 8)) & 0x01;
+            clock_isr();
+        }
+        hal.data = true;
+        clock_isr();
+    }
+};
+
+// One packet through the clock interrupt. A packet for the slave is also
+// dispatched by read(), which is what the main loop does next.
+void BM_ReceivePacket(benchmark::State& state) {
+    BenchSlave bench(32);
+    bool matching = state.range(0) != 0;
+    uint8_t frame[3] = {matching ? BENCH_ADDRESS : FOREIGN_ADDRESS, SUSI_CMD_SET_SPEED, 0x85};
+    for (auto _ : state) {
+        bench.clockIn(frame);
+        benchmark::DoNotOptimize(bench.slave.read());
+        frame[2] ^= 0x01;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(matching ? "matching" : "foreign");
+}
+
+// Dispatch of a received packet by read()
+void BM_ReadDispatch(benchmark::State& state) {
+    BenchSlave bench(32);
+    SUSI_Packet packets[] = {
+        {BENCH_ADDRESS, SUSI_CMD_SET_SPEED, 0x85},
+        {BENCH_ADDRESS, SUSI_CMD_SET_FUNCTION, 0x83},
+        {BENCH_ADDRESS, SUSI_CMD_READ_CV_BANK_0, 0},
+    };
+    const char* labels[] = {"speed", "function", "bank_read"};
+    const SUSI_Packet& packet = packets[state.range(0)];
+    for (auto _ : state) {
+        bench.slave._test_receive_packet(packet);
+        benchmark::DoNotOptimize(bench.slave.read());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(labels[state.range(0)]);
+}
+
+// A CV write of two packets, stored in RAM and marked for the EEPROM
+void BM_WriteCV(benchmark::State& state) {
+    BenchSlave bench(state.range(0));
+    uint8_t value = 0;
+    for (auto _ : state) {
+        bench.writeCV(SUSI_CV_WINDOW_START + 20, value++ | 0x80);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ReadCV(benchmark::State& state) {
+    BenchSlave bench(state.range(0));
+    uint16_t cv = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bench.slave.readCV(cv));
+        cv = cv == 1023 ? 0 : cv + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_GetCVBank(benchmark::State& state) {
+    BenchSlave bench(state.range(0));
+    uint8_t data[SUSI_CV_BANK_SIZE];
+    uint8_t bank = 0;
+    for (auto _ : state) {
+        bench.slave._test_get_cv_bank(bank, data);
+        benchmark::DoNotOptimize(data);
+        bank = (bank + 1) % SUSI_CV_BANK_COUNT;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// getFunction() with the state of the given number of slaves known to the
+// master, looking up the last one
+void BM_MasterGetFunction(benchmark::State& state) {
+    mock_hal_reset();
+    BenchHAL hal;
+    SUSI_Master master(hal);
+    SUSI_Master_API api(master);
+    api.begin();
+    int slaves = state.range(0);
+    for (int i = 0; i < slaves; i++) {
+        api.setFunction(i + 1, 3, true);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(api.getFunction(slaves, 3));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+} // namespace
+
+BENCHMARK(BM_ReceivePacket)->Arg(1)->Arg(0);
+BENCHMARK(BM_ReadDispatch)->DenseRange(0, 2);
+BENCHMARK(BM_WriteCV)->Arg(32)->Arg(MAX_CVS);
+BENCHMARK(BM_ReadCV)->Arg(32)->Arg(MAX_CVS);
+BENCHMARK(BM_GetCVBank)->Arg(32)->Arg(MAX_CVS);
+BENCHMARK(BM_MasterGetFunction)->Arg(1)->Arg(MAX_SLAVES);
@@ -0,0 +1,171 @@
+#include "susi_bidi_queue.h"
+#include "susi_commands.h"
+
+SusiBidiQueue::SusiBidiQueue() {
+    _count = 0;
+    _dropped = 0;
+    _overwritten = 0;
+}
+
+bool SusiBidiQueue::push(uint8_t header, uint8_t data, uint8_t priority) {
+    if (!makeRoom(1, priority)) {
+        _dropped++;
+        return false;
+    }
+
+    SusiBidiMessage& message = _messages[_count++];
+    message.header = header;
+    message.data = data;
+    message.priority = priority;
+    message.linked = false;
+    return true;
+}
+
+bool SusiBidiQueue::pushPair(uint8_t header1, uint8_t data1, uint8_t header2, uint8_t data2, uint8_t priority) {
+    if (!makeRoom(2, priority)) {
+        _dropped += 2;
+        return false;
+    }
+
+    SusiBidiMessage& first = _messages[_count++];
+    first.header = header1;
+    first.data = data1;
+    first.priority = priority;
+    first.linked = true;
+
+    SusiBidiMessage& second = _messages[_count++];
+    second.header = header2;
+    second.data = data2;
+    second.priority = priority;
+    second.linked = false;
+    return true;
+}
+
+bool SusiBidiQueue::pushAnalog(uint8_t header, uint8_t value) {
+    for (uint8_t i = 0; i < _count; i++) {
+        SusiBidiMessage& message = _messages[i];
+        if (message.priority == SUSI_BIDI_PRIORITY_ANALOG && message.header == header && !message.linked) {
+            // Only the latest value of a channel is of interest.
+            message.data = value;
+            _overwritten++;
+            return true;
+        }
+    }
+    return push(header, value, SUSI_BIDI_PRIORITY_ANALOG);
+}
+
+bool SusiBidiQueue::peekResponse(uint8_t* response) const {
+    int first;
+    int second;
+    if (!select(first, second)) {
+        return false;
+    }
+
+    response[0] = _messages[first].header;
+    response[1] = _messages[first].data;
+    if (second >= 0) {
+        response[2] = _messages[second].header;
+        response[3] = _messages[second].data;
+    } else {
+        response[2] = SUSI_MSG_BIDI_EMPTY;
+        response[3] = 0;
+    }
+    return true;
+}
+
+bool SusiBidiQueue::popResponse(uint8_t* response) {
+    if (!peekResponse(response)) {
+        return false;
+    }
+
+    int first;
+    int second;
+    select(first, second);
+    SusiBidiMessage message;
+    if (second > first) {
+        pop(second, message);
+        pop(first, message);
+    } else {
+        pop(first, message);
+        if (second >= 0) {
+            pop(second, message);
+        }
+    }
+    return true;
+}
+
+void SusiBidiQueue::clear() {
+    _count = 0;
+}
+
+void SusiBidiQueue::getStats(SusiBidiQueueStats& stats) const {
+    stats.dropped = _dropped;
+    stats.overwritten = _overwritten;
+    stats.pending = _count;
+}
+
+bool SusiBidiQueue::makeRoom(uint8_t count, uint8_t priority) {
+    while (SUSI_BIDI_QUEUE_SIZE - _count < count) {
+        // Find the newest message of the lowest priority below the new one.
+        int victim = -1;
+        for (int i = _count - 1; i >= 0; i--) {
+            if (_messages[i].priority > priority &&
+                (victim < 0 || _messages[i].priority > _messages[victim].priority)) {
+                victim = i;
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+
+        // Drop the whole group the victim belongs to.
+        uint8_t start = victim;
+        while (start > 0 && _messages[start - 1].linked) {
+            start--;
+        }
+        SusiBidiMessage message;
+        do {
+            pop(start, message);
+            _dropped++;
+        } while (message.linked);
+    }
+    return true;
+}
+
+bool SusiBidiQueue::select(int& first, int& second) const {
+    if (_count == 0) {
+        return false;
+    }
+
+    first = 0;
+    for (uint8_t i = 1; i < _count; i++) {
+        if (_messages[i].priority < _messages[first].priority) {
+            first = i;
+        }
+    }
+
+    if (_messages[first].linked) {
+        // The partner directly follows its linked message.
+        second = first + 1;
+        return true;
+    }
+
+    // Both halves of a response are independent messages, so the second half
+    // carries the next single message instead of an empty one.
+    second = -1;
+    for (uint8_t i = 0; i < _count; i++) {
+        bool single = !_messages[i].linked && (i == 0 || !_messages[i - 1].linked);
+        if (i != first && single && (second < 0 || _messages[i].priority < _messages[second].priority)) {
+            second = i;
+        }
+    }
+    return true;
+}
+
+void SusiBidiQueue::pop(uint8_t index, SusiBidiMessage& message) {
+    message = _messages[index];
+    for (uint8_t i = index + 1; i < _count; i++) {
+        _messages[i - 1] = _messages[i];
+    }
+    _count--;
+}
@@ -0,0 +1,144 @@
+#ifndef SUSI_BIDI_QUEUE_H
+#define SUSI_BIDI_QUEUE_H
+
+#include <Arduino.h>
+
+/**
+ * @brief The number of 2-byte BiDi messages that can wait for a host call.
+ * @details Can be overridden at compile time.
+ */
+#ifndef SUSI_BIDI_QUEUE_SIZE
+#define SUSI_BIDI_QUEUE_SIZE 8
+#endif
+
+/**
+ * @brief Priority of errors and positions, sent before everything else.
+ */
+const uint8_t SUSI_BIDI_PRIORITY_URGENT = 0;
+
+/**
+ * @brief Priority of regular state messages.
+ */
+const uint8_t SUSI_BIDI_PRIORITY_NORMAL = 1;
+
+/**
+ * @brief Priority of analog values, which are superseded by newer values.
+ */
+const uint8_t SUSI_BIDI_PRIORITY_ANALOG = 2;
+
+/**
+ * @brief A 2-byte BiDi message, one half of a 4-byte BiDi response.
+ * @see RCN-601
+ */
+struct SusiBidiMessage {
+    uint8_t header;
+    uint8_t data;
+    uint8_t priority;
+    // Whether the next message belongs to this one and is sent in the same response.
+    bool linked;
+};
+
+/**
+ * @brief Counters of the BiDi transmit queue.
+ */
+struct SusiBidiQueueStats {
+    /**
+     * @brief The number of messages that were dropped because the queue was full.
+     */
+    uint16_t dropped;
+    /**
+     * @brief The number of pending analog values replaced by a newer value.
+     */
+    uint16_t overwritten;
+    /**
+     * @brief The number of messages waiting for a host call.
+     */
+    uint8_t pending;
+};
+
+/**
+ * @brief A fixed-capacity priority queue of BiDi messages on the slave.
+ * @details Events that occur between two host calls are queued instead of
+ * overwriting each other. Messages leave the queue by priority and in order of
+ * arrival within a priority. A new analog value replaces the pending value of
+ * the same channel. When the queue is full, the newest message of a lower
+ * priority is dropped to make room; otherwise the new message is dropped.
+ */
+class SusiBidiQueue {
+public:
+    /**
+     * @brief Constructs an empty queue.
+     */
+    SusiBidiQueue();
+
+    /**
+     * @brief Queues a message.
+     * @param header The message header.
+     * @param data The message data.
+     * @param priority The priority, SUSI_BIDI_PRIORITY_URGENT being the highest.
+     * @return bool Whether the message was queued.
+     */
+    bool push(uint8_t header, uint8_t data, uint8_t priority);
+
+    /**
+     * @brief Queues two messages that must be sent together in one response.
+     * @return bool Whether the messages were queued; either both or none are.
+     */
+    bool pushPair(uint8_t header1, uint8_t data1, uint8_t header2, uint8_t data2, uint8_t priority);
+
+    /**
+     * @brief Queues an analog value, replacing a pending value with the same header.
+     * @param header The analog channel header.
+     * @param value The analog value.
+     * @return bool Whether the value was queued.
+     */
+    bool pushAnalog(uint8_t header, uint8_t value);
+
+    /**
+     * @brief Takes the next 4-byte response from the queue.
+     * @details The first half is the most urgent message. The second half is its
+     * linked message, otherwise the most urgent single message, so two
+     * independent events are sent per host call. If nothing else is pending,
+     * the second half is an empty message.
+     * @param response A pointer to a 4-byte buffer for the response.
+     * @return bool Whether a message was pending.
+     */
+    bool popResponse(uint8_t* response);
+
+    /**
+     * @brief Gets the response popResponse() would return, without removing it.
+     * @param response A pointer to a 4-byte buffer for the response.
+     * @return bool Whether a message was pending.
+     */
+    bool peekResponse(uint8_t* response) const;
+
+    /**
+     * @brief Gets the number of pending messages.
+     * @return uint8_t The number of pending messages.
+     */
+    uint8_t pending() const { return _count; }
+
+    /**
+     * @brief Removes all pending messages; the counters are kept.
+     */
+    void clear();
+
+    /**
+     * @brief Gets the queue counters.
+     * @param stats A reference to a structure to store the counters in.
+     */
+    void getStats(SusiBidiQueueStats& stats) const;
+
+private:
+    bool makeRoom(uint8_t count, uint8_t priority);
+    bool select(int& first, int& second) const;
+    void pop(uint8_t index, SusiBidiMessage& message);
+
+    // Messages in order of arrival.
+    SusiBidiMessage _messages[SUSI_BIDI_QUEUE_SIZE];
+    uint8_t _count;
+    uint16_t _dropped;
+    uint16_t _overwritten;
+};
+
+#endif // SUSI_BIDI_QUEUE_H
@@ -0,0 +1,83 @@
+#include "susi_binary_states.h"
+
+SusiBinaryStates::SusiBinaryStates() {
+    for (uint8_t i = 0; i < SUSI_BINARY_STATE_CAPACITY; i++) {
+        _epochs[i] = 0;
+    }
+    _epoch = 1;
+    _count = 0;
+    _common = false;
+    _short_common = false;
+}
+
+bool SusiBinaryStates::find(uint16_t number, uint8_t& index) const {
+    for (uint8_t i = 0; i < SUSI_BINARY_STATE_CAPACITY; i++) {
+        if (_epochs[i] == _epoch && _numbers[i] == number) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SusiBinaryStates::common(uint16_t number) const {
+    return number <= SUSI_BINARY_STATE_SHORT_MAX ? _short_common : _common;
+}
+
+bool SusiBinaryStates::get(uint16_t number) const {
+    uint8_t index;
+    return find(number, index) != common(number);
+}
+
+bool SusiBinaryStates::set(uint16_t number, bool on) {
+    if (number == 0 || number > SUSI_BINARY_STATE_MAX) {
+        return false;
+    }
+
+    uint8_t index;
+    bool stored = find(number, index);
+    if (on == common(number)) {
+        if (stored) {
+            _epochs[index] = 0;
+            _count--;
+        }
+        return true;
+    }
+    if (stored) {
+        return true;
+    }
+
+    for (uint8_t i = 0; i < SUSI_BINARY_STATE_CAPACITY; i++) {
+        if (_epochs[i] != _epoch) {
+            _numbers[i] = number;
+            _epochs[i] = _epoch;
+            _count++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SusiBinaryStates::setAll(bool on) {
+    _common = on;
+    _short_common = on;
+    _count = 0;
+    if (++_epoch == 0) {
+        // Once every 255 broadcasts the old epochs are cleared, so that an
+        // entry of an earlier round can never become current again.
+        for (uint8_t i = 0; i < SUSI_BINARY_STATE_CAPACITY; i++) {
+            _epochs[i] = 0;
+        }
+        _epoch = 1;
+    }
+}
+
+void SusiBinaryStates::setAllShort(bool on) {
+    _short_common = on;
+    for (uint8_t i = 0; i < SUSI_BINARY_STATE_CAPACITY; i++) {
+        if (_epochs[i] == _epoch && _numbers[i] <= SUSI_BINARY_STATE_SHORT_MAX) {
+            _epochs[i] = 0;
+            _count--;
+        }
+    }
+}
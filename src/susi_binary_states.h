@@ -0,0 +1,89 @@
+#ifndef SUSI_BINARY_STATES_H
+#define SUSI_BINARY_STATES_H
+
+#include <Arduino.h>
+
+/**
+ * @brief The number of binary states that can differ from the common state.
+ * @details Each entry costs 3 bytes of RAM. Can be overridden at compile time.
+ */
+#ifndef SUSI_BINARY_STATE_CAPACITY
+#define SUSI_BINARY_STATE_CAPACITY 32
+#endif
+
+/**
+ * @brief The highest binary state number of the long form.
+ * @see RCN-600
+ */
+const uint16_t SUSI_BINARY_STATE_MAX = 32767;
+
+/**
+ * @brief The highest binary state number of the short form.
+ * @see RCN-600
+ */
+const uint16_t SUSI_BINARY_STATE_SHORT_MAX = 127;
+
+/**
+ * @brief The binary states 1–32767 of a SUSI slave, stored sparsely.
+ * @details The states 1–127 of the short form and the states above share a
+ * common state each; only the states that differ from the common state of
+ * their range are stored. Setting all states, the broadcast of the long form,
+ * changes both common states and starts a new epoch, which drops all stored
+ * entries in constant time: an entry only counts if it was written in the
+ * current epoch. The broadcast of the short form only sets states 1–127.
+ */
+class SusiBinaryStates {
+public:
+    /**
+     * @brief Constructs a store with all states off.
+     */
+    SusiBinaryStates();
+
+    /**
+     * @brief Gets a binary state.
+     * @param number The state number (1–32767).
+     * @return bool The state.
+     */
+    bool get(uint16_t number) const;
+
+    /**
+     * @brief Sets a binary state.
+     * @param number The state number (1–32767).
+     * @param on The state.
+     * @return bool Whether the state was stored, false if the number is out of
+     * range or too many states differ from the common state.
+     */
+    bool set(uint16_t number, bool on);
+
+    /**
+     * @brief Sets all binary states at once.
+     * @param on The state.
+     */
+    void setAll(bool on);
+
+    /**
+     * @brief Sets the binary states 1–127 at once, leaving the higher states.
+     * @param on The state.
+     */
+    void setAllShort(bool on);
+
+    /**
+     * @brief Gets the number of states that differ from the common state.
+     * @return uint8_t The number of stored entries.
+     */
+    uint8_t size() const { return _count; }
+
+private:
+    bool find(uint16_t number, uint8_t& index) const;
+    bool common(uint16_t number) const;
+
+    uint16_t _numbers[SUSI_BINARY_STATE_CAPACITY];
+    // The epoch an entry was written in; 0 marks a free entry
+    uint8_t _epochs[SUSI_BINARY_STATE_CAPACITY];
+    uint8_t _epoch;
+    uint8_t _count;
+    bool _common;
+    bool _short_common; // Common state of the states 1–127
+};
+
+#endif // SUSI_BINARY_STATES_H
@@ -0,0 +1,63 @@
+#include "susi_bitbang_transport.h"
+
+SusiBitBangTransport::SusiBitBangTransport(SusiHAL& hal) {
+    _hal = &hal;
+    _clock = &hal.clock();
+}
+
+void SusiBitBangTransport::setClock(SusiClock& clock) {
+    SusiTransport::setClock(clock);
+    if (_hal != nullptr) {
+        _hal->setClock(clock);
+    }
+}
+
+SusiBitBangTransport::SusiBitBangTransport() {
+    _hal = nullptr;
+}
+
+void SusiBitBangTransport::begin() {
+    _hal->begin();
+    _hal->set_clock_high(); // Clock idle is HIGH
+    _hal->set_data_high();  // Data idle is HIGH
+}
+
+SusiMasterResult SusiBitBangTransport::sendPacket(const SUSI_Packet& packet, bool expectAck) {
+    waitForSyncGap(packet);
+
+    uint32_t frame = susiEncodeFrame(packet);
+    for (uint8_t i = 0; i < SUSI_FRAME_BITS; i++) {
+        if ((frame >> i) & 0x01) {
+            _hal->set_data_high();
+        } else {
+            _hal->set_data_low();
+        }
+        _hal->generate_clock_pulse();
+    }
+
+    packetSent();
+
+    if (expectAck) {
+        SusiMasterResult result = _hal->waitForAck(_ack_timeout_us);
+        _ack_latency_us = _hal->ackLatency();
+        return result;
+    }
+
+    return SUCCESS;
+}
+
+uint8_t SusiBitBangTransport::readByte() {
+    uint8_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        if (_hal->read_bit()) {
+            value |= (1 << i);
+        }
+    }
+    busClocked();
+    return value;
+}
+
+void SusiBitBangTransport::clockPulse() {
+    _hal->generate_clock_pulse();
+    busClocked();
+}
@@ -0,0 +1,34 @@
+#ifndef SUSI_BITBANG_TRANSPORT_H
+#define SUSI_BITBANG_TRANSPORT_H
+
+#include "susi_transport.h"
+#include "susi_hal.h"
+
+class SUSI_Master;
+
+/**
+ * @brief A transport that bit-bangs the packets on the pins of a SusiHAL.
+ */
+class SusiBitBangTransport : public SusiTransport {
+public:
+    /**
+     * @brief Constructs a new SusiBitBangTransport object.
+     * @param hal The hardware abstraction of the clock and data pins.
+     */
+    SusiBitBangTransport(SusiHAL& hal);
+
+    void begin() override;
+    SusiMasterResult sendPacket(const SUSI_Packet& packet, bool expectAck) override;
+    uint8_t readByte() override;
+    void clockPulse() override;
+    void setClock(SusiClock& clock) override;
+
+private:
+    // SUSI_Master keeps an unbound instance for when it is given another transport.
+    friend class SUSI_Master;
+    SusiBitBangTransport();
+
+    SusiHAL* _hal;
+};
+
+#endif // SUSI_BITBANG_TRANSPORT_H
@@ -0,0 +1,21 @@
+#include "susi_clock.h"
+
+// delayMicroseconds() is only accurate up to 16383 us on AVR.
+const uint32_t SUSI_CLOCK_MAX_DELAY_US = 16000;
+
+uint32_t SusiArduinoClock::nowMicros() {
+    return micros();
+}
+
+void SusiArduinoClock::delayMicros(uint32_t us) {
+    while (us > SUSI_CLOCK_MAX_DELAY_US) {
+        delayMicroseconds(SUSI_CLOCK_MAX_DELAY_US);
+        us -= SUSI_CLOCK_MAX_DELAY_US;
+    }
+    delayMicroseconds(us);
+}
+
+SusiClock& susiDefaultClock() {
+    static SusiArduinoClock clock;
+    return clock;
+}
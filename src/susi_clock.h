@@ -0,0 +1,72 @@
+#ifndef SUSI_CLOCK_H
+#define SUSI_CLOCK_H
+
+#include <Arduino.h>
+
+/**
+ * @brief The monotonic time base of the library's bus timing.
+ * @details The time is a 32-bit count of microseconds that wraps around after
+ * about 71 minutes. Times are only ever compared by subtraction, see
+ * susiElapsed() and susiTimeReached(), which stays correct across the wrap.
+ *
+ * The default clock uses micros() and delayMicroseconds(). A target can derive
+ * its own from a hardware timer, and tests inject a virtual clock, so that all
+ * timing of the master, the slave and the HAL runs on one time base.
+ */
+class SusiClock {
+public:
+    /**
+     * @brief Destroy the SusiClock object
+     */
+    virtual ~SusiClock() = default;
+
+    /**
+     * @brief Gets the current time.
+     * @return uint32_t The time in microseconds.
+     */
+    virtual uint32_t nowMicros() = 0;
+
+    /**
+     * @brief Waits for a time.
+     * @param us The time to wait in microseconds.
+     */
+    virtual void delayMicros(uint32_t us) = 0;
+};
+
+/**
+ * @brief The clock of the Arduino core: micros() and delayMicroseconds().
+ */
+class SusiArduinoClock : public SusiClock {
+public:
+    uint32_t nowMicros() override;
+    void delayMicros(uint32_t us) override;
+};
+
+/**
+ * @brief The clock used until another one is set.
+ * @return SusiClock& The Arduino clock.
+ */
+SusiClock& susiDefaultClock();
+
+/**
+ * @brief Gets the time from one clock reading to another, across the wrap.
+ * @param since The earlier reading.
+ * @param now The later reading.
+ * @return uint32_t The time in microseconds.
+ */
+inline uint32_t susiElapsed(uint32_t since, uint32_t now) {
+    return now - since;
+}
+
+/**
+ * @brief Checks whether a deadline has been reached, across the wrap.
+ * @details Valid while the deadline is less than 2^31 us (35 minutes) away.
+ * @param now The current clock reading.
+ * @param deadline The deadline.
+ * @return bool Whether now is at or after the deadline.
+ */
+inline bool susiTimeReached(uint32_t now, uint32_t deadline) {
+    return (int32_t)(now - deadline) >= 0;
+}
+
+#endif // SUSI_CLOCK_H
@@ -13,6 +13,42 @@
  */
 const uint8_t SUSI_CMD_SET_FUNCTION = 0x60;
 
+/**
+ * @brief The first direct command, which sets outputs 1–8 at once; 0x41–0x43
+ * set outputs 9–16, 17–24 and 25–32.
+ * @details Bit n of the data is the state of output 8 * (command - 0x40) + n + 1.
+ * @see RCN-600
+ */
+const uint8_t SUSI_CMD_DIRECT_OUTPUTS = 0x40;
+
+/**
+ * @brief The number of direct commands, 8 outputs each.
+ */
+const uint8_t SUSI_DIRECT_OUTPUT_BYTES = 4;
+
+/**
+ * @brief The binary state command, short form: DLLLLLLL sets state L (1–127)
+ * to D. L = 0 sets the states 1–127 to D; all states take the long form.
+ * @see RCN-600
+ */
+const uint8_t SUSI_CMD_BINARY_STATE_SHORT = 0x6D;
+
+/**
+ * @brief The binary state command, long form, first packet: DLLLLLLL holds
+ * the state D and the low 7 bits of the state number.
+ * @details Takes effect with the SUSI_CMD_BINARY_STATE_LONG_H packet that
+ * follows it. State number 0 sets all binary states.
+ * @see RCN-600
+ */
+const uint8_t SUSI_CMD_BINARY_STATE_LONG_L = 0x6E;
+
+/**
+ * @brief The binary state command, long form, second packet: the high 8 bits
+ * of the state number (1–32767).
+ * @see RCN-600
+ */
+const uint8_t SUSI_CMD_BINARY_STATE_LONG_H = 0x6F;
+
 /**
  * @brief The SUSI command to set the speed.
  */
@@ -28,6 +64,30 @@ const uint8_t SUSI_CMD_WRITE_CV = 0x04;
  */
 const uint8_t SUSI_CMD_READ_CV = 0x03;
 
+/**
+ * @brief The CV manipulation command to verify a byte (3-byte command).
+ * @details Sent as two packets: the command with 0x80 | (CV - 897), then the
+ * command again with the value to compare. The slave acknowledges the second
+ * packet only if the CV holds that value.
+ * @see RCN-600
+ */
+const uint8_t SUSI_CMD_VERIFY_CV_BYTE = 0x77;
+
+/**
+ * @brief The CV manipulation command to verify or write a bit (3-byte command).
+ * @details Sent as two packets like SUSI_CMD_VERIFY_CV_BYTE. The value of the
+ * second packet is 111KDBBB: K = 1 writes D to bit B, K = 0 verifies that bit
+ * B is D, acknowledged only on a match.
+ * @see RCN-600
+ */
+const uint8_t SUSI_CMD_CV_BIT = 0x7B;
+
+/**
+ * @brief The first CV that the CV manipulation commands reach (V = 0).
+ * @see RCN-600
+ */
+const uint16_t SUSI_CV_MANIPULATION_FIRST = 897;
+
 /**
  * @brief The SUSI command for a BiDi Host Call.
  * @see RCN-601
@@ -98,6 +158,26 @@ const uint8_t SUSI_CMD_READ_CV_BANK_1 = 0x0D;
  */
 const uint8_t SUSI_CMD_READ_CV_BANK_2 = 0x0E;
 
+/**
+ * @brief The BiDi command to read a CV of 769–1024 in one packet.
+ * @details The data byte is the CV number minus SUSI_BIDI_READ_CV_OFFSET. The
+ * module answers with the values of the CV and the next CV.
+ * @see RCN-601
+ */
+const uint8_t SUSI_CMD_BIDI_READ_CV = 0x0F;
+
+/**
+ * @brief The CV number that SUSI_CMD_BIDI_READ_CV reads with data 0.
+ * @see RCN-601
+ */
+const uint16_t SUSI_BIDI_READ_CV_OFFSET = 769;
+
+/**
+ * @brief The BiDi error code for a CV that is not available.
+ * @see RCN-601
+ */
+const uint8_t SUSI_BIDI_ERROR_CV_NOT_AVAILABLE = 0x02;
+
 // RCN-602 Specific CVs
 const uint16_t CV_SUSI_MODULE_NUM = 897;
 const uint16_t CV_MANUFACTURER_ID = 900;
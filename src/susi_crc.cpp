@@ -1,16 +1,9 @@
 #include "susi_crc.h"
 
 uint16_t crc16_ccitt(const uint8_t* data, int length) {
-    uint16_t crc = 0xFFFF;
-    for (int i = 0; i < length; i++) {
-        crc ^= (uint16_t)data[i] << 8;
-        for (int j = 0; j < 8; j++) {
-            if (crc & 0x8000) {
-                crc = (crc << 1) ^ 0x1021;
-            } else {
-                crc <<= 1;
-            }
-        }
-    }
-    return crc;
+    return SusiCRC16::compute(data, length);
+}
+
+uint8_t crc8_rcn218(const uint8_t* data, int length) {
+    return SusiCRC8::compute(data, length);
 }
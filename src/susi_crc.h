@@ -1,7 +1,176 @@
 #ifndef SUSI_CRC_H
 #define SUSI_CRC_H
 
-#include <stdint.h>
+#include <Arduino.h>
+
+/**
+ * @brief Selects 16-entry nibble tables instead of 256-entry byte tables for
+ * the CRCs used by the library.
+ * @details A nibble table takes 16 instead of 256 entries of flash and needs two
+ * lookups per byte. Can be set to 1 at compile time for flash-constrained
+ * targets.
+ */
+#ifndef SUSI_CRC_NIBBLE_TABLES
+#define SUSI_CRC_NIBBLE_TABLES 0
+#endif
+
+template <uint16_t... I>
+struct SusiCRCIndices {};
+
+template <uint16_t N, uint16_t... I>
+struct SusiCRCMakeIndices : SusiCRCMakeIndices<N - 1, N - 1, I...> {};
+
+template <uint16_t... I>
+struct SusiCRCMakeIndices<0, I...> {
+    typedef SusiCRCIndices<I...> type;
+};
+
+/**
+ * @brief The lookup table of a CRC engine, generated at compile time and kept
+ * in program memory.
+ */
+template <class Engine, class Indices>
+struct SusiCRCTable;
+
+template <class Engine, uint16_t... I>
+struct SusiCRCTable<Engine, SusiCRCIndices<I...> > {
+    static const typename Engine::value_type values[sizeof...(I)];
+};
+
+template <class Engine, uint16_t... I>
+const typename Engine::value_type SusiCRCTable<Engine, SusiCRCIndices<I...> >::values[sizeof...(I)]
+    PROGMEM = {Engine::entry(I)...};
+
+inline uint8_t susiCRCTableRead(const uint8_t* entry) { return pgm_read_byte(entry); }
+inline uint16_t susiCRCTableRead(const uint16_t* entry) { return pgm_read_word(entry); }
+
+/**
+ * @brief A table-driven CRC of 8 to 16 bits that is fed one byte at a time.
+ * @details The lookup table is computed by the compiler from the polynomial and
+ * placed in program memory. Bytes can be folded in as they are sent or
+ * received, so a stream does not have to be buffered to check it.
+ * @tparam T uint8_t or uint16_t, wide enough for the CRC.
+ * @tparam WIDTH The width of the CRC in bits (8–16).
+ * @tparam POLY The polynomial in normal form without the top bit, e.g. 0x31 for
+ * x^8 + x^5 + x^4 + 1.
+ * @tparam INIT The initial value.
+ * @tparam REFLECTED Whether the bytes are processed LSB first.
+ * @tparam NIBBLE_TABLE Whether to use a 16-entry table, two lookups per byte.
+ */
+template <typename T, uint8_t WIDTH, T POLY, T INIT, bool REFLECTED, bool NIBBLE_TABLE = false>
+class SusiCRC {
+    static_assert(WIDTH >= 8 && WIDTH <= 16 && WIDTH <= sizeof(T) * 8, "CRC width must be 8-16 bits and fit T");
+
+public:
+    typedef T value_type;
+
+    /**
+     * @brief The number of bits looked up at once.
+     */
+    static const uint8_t TABLE_BITS = NIBBLE_TABLE ? 4 : 8;
+
+    /**
+     * @brief Constructs a CRC with the initial value.
+     */
+    SusiCRC() : _crc(INIT) {}
+
+    /**
+     * @brief Starts over with the initial value.
+     */
+    void reset() { _crc = INIT; }
+
+    /**
+     * @brief Folds one byte into the CRC.
+     * @param byte The byte.
+     */
+    void update(uint8_t byte) {
+        if (NIBBLE_TABLE) {
+            _crc = step(_crc, REFLECTED ? byte & 0x0F : byte >> 4);
+            _crc = step(_crc, REFLECTED ? byte >> 4 : byte & 0x0F);
+        } else {
+            _crc = step(_crc, byte);
+        }
+    }
+
+    /**
+     * @brief Folds a block of bytes into the CRC.
+     * @param data A pointer to the data.
+     * @param length The length of the data in bytes.
+     */
+    void update(const uint8_t* data, uint16_t length) {
+        for (uint16_t i = 0; i < length; i++) {
+            update(data[i]);
+        }
+    }
+
+    /**
+     * @brief Gets the CRC of the bytes folded in so far.
+     * @return T The CRC.
+     */
+    T value() const { return _crc; }
+
+    /**
+     * @brief Calculates the CRC of a block of data.
+     * @param data A pointer to the data.
+     * @param length The length of the data in bytes.
+     * @return T The CRC.
+     */
+    static T compute(const uint8_t* data, uint16_t length) {
+        SusiCRC crc;
+        crc.update(data, length);
+        return crc.value();
+    }
+
+    /**
+     * @brief Calculates an entry of the lookup table bit by bit.
+     * @param index The index in the table.
+     * @return T The CRC of the index shifted through the register.
+     */
+    static constexpr T entry(uint16_t index) {
+        return shift(REFLECTED ? (T)index : (T)(index << (WIDTH - TABLE_BITS)), TABLE_BITS);
+    }
+
+private:
+    typedef SusiCRCTable<SusiCRC, typename SusiCRCMakeIndices<1 << TABLE_BITS>::type> Table;
+
+    static constexpr T mask() { return (T)((1UL << WIDTH) - 1); }
+
+    static constexpr T reflect(T value, uint8_t bits) {
+        return bits == 0 ? 0 : (T)(((value & 1) << (bits - 1)) | reflect(value >> 1, bits - 1));
+    }
+
+    static constexpr T bitStep(T crc) {
+        return REFLECTED ? ((crc & 1) ? (T)((crc >> 1) ^ reflect(POLY, WIDTH)) : (T)(crc >> 1))
+                         : ((crc >> (WIDTH - 1)) & 1 ? (T)(((crc << 1) ^ POLY) & mask())
+                                                     : (T)((crc << 1) & mask()));
+    }
+
+    static constexpr T shift(T crc, uint8_t bits) {
+        return bits == 0 ? crc : shift(bitStep(crc), bits - 1);
+    }
+
+    static T step(T crc, uint8_t chunk) {
+        const uint8_t index_mask = (1 << TABLE_BITS) - 1;
+        if (REFLECTED) {
+            return (T)((uint32_t)crc >> TABLE_BITS) ^ susiCRCTableRead(&Table::values[(crc ^ chunk) & index_mask]);
+        }
+        uint8_t index = ((crc >> (WIDTH - TABLE_BITS)) ^ chunk) & index_mask;
+        return (T)(((uint32_t)crc << TABLE_BITS) ^ susiCRCTableRead(&Table::values[index])) & mask();
+    }
+
+    T _crc;
+};
+
+/**
+ * @brief CRC-16-CCITT: polynomial 0x1021, initial value 0xFFFF, MSB first.
+ */
+typedef SusiCRC<uint16_t, 16, 0x1021, 0xFFFF, false, SUSI_CRC_NIBBLE_TABLES> SusiCRC16;
+
+/**
+ * @brief The CRC-8 of RCN-218: x^8 + x^5 + x^4 + 1, initial value 0, LSB
+ * first, not inverted. Over data followed by its CRC, the result is 0.
+ */
+typedef SusiCRC<uint8_t, 8, 0x31, 0x00, true, SUSI_CRC_NIBBLE_TABLES> SusiCRC8;
 
 /**
  * @brief Calculates the CRC-16-CCITT checksum for a block of data.
@@ -11,4 +180,13 @@
  */
 uint16_t crc16_ccitt(const uint8_t* data, int length);
 
+/**
+ * @brief Calculates the RCN-218 CRC-8 for a block of data.
+ * @param data A pointer to the data.
+ * @param length The length of the data in bytes.
+ * @return uint8_t The calculated CRC-8 checksum.
+ * @see RCN-218
+ */
+uint8_t crc8_rcn218(const uint8_t* data, int length);
+
 #endif // SUSI_CRC_H
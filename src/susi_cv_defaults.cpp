@@ -0,0 +1,40 @@
+#include "susi_cv_defaults.h"
+
+SusiCVDefaults::SusiCVDefaults() {
+    _table = nullptr;
+    _count = 0;
+}
+
+bool SusiCVDefaults::set(const SusiCVDefault* table, uint16_t count) {
+    for (uint16_t i = 1; i < count; i++) {
+        if (pgm_read_word(&table[i - 1].cv) >= pgm_read_word(&table[i].cv)) {
+            return false;
+        }
+    }
+    _table = table;
+    _count = count;
+    return true;
+}
+
+bool SusiCVDefaults::get(uint16_t cv, uint8_t& value) const {
+    uint16_t low = 0;
+    uint16_t high = _count;
+    while (low < high) {
+        uint16_t mid = (low + high) / 2;
+        uint16_t mid_cv = cvAt(mid);
+        if (mid_cv == cv) {
+            value = pgm_read_byte(&_table[mid].value);
+            return true;
+        }
+        if (mid_cv < cv) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return false;
+}
+
+uint16_t SusiCVDefaults::cvAt(uint16_t index) const {
+    return pgm_read_word(&_table[index].cv);
+}
@@ -0,0 +1,57 @@
+#ifndef SUSI_CV_DEFAULTS_H
+#define SUSI_CV_DEFAULTS_H
+
+#include <Arduino.h>
+
+/**
+ * @brief The factory default value of one CV.
+ */
+struct SusiCVDefault {
+    uint16_t cv;
+    uint8_t value;
+};
+
+/**
+ * @brief A read-only table of CV factory defaults in program memory.
+ * @details The entries are sorted by CV number and found by binary search, so
+ * a module with hundreds of CVs only spends RAM on the CVs that differ from
+ * their default. The table is declared by the application, e.g.
+ * `const SusiCVDefault defaults[] PROGMEM = {{1, 3}, {2, 10}};`
+ */
+class SusiCVDefaults {
+public:
+    /**
+     * @brief Constructs an empty defaults table.
+     */
+    SusiCVDefaults();
+
+    /**
+     * @brief Sets the table of defaults.
+     * @param table The entries in program memory, sorted by CV number.
+     * @param count The number of entries.
+     * @return bool Whether the table was accepted, false if it is not sorted.
+     */
+    bool set(const SusiCVDefault* table, uint16_t count);
+
+    /**
+     * @brief Looks up the default of a CV.
+     * @param cv The CV number.
+     * @param value A reference to a byte to store the default in.
+     * @return bool Whether the CV has a default.
+     */
+    bool get(uint16_t cv, uint8_t& value) const;
+
+    /**
+     * @brief Gets the number of CVs with a default.
+     * @return uint16_t The number of entries.
+     */
+    uint16_t size() const { return _count; }
+
+private:
+    uint16_t cvAt(uint16_t index) const;
+
+    const SusiCVDefault* _table;
+    uint16_t _count;
+};
+
+#endif // SUSI_CV_DEFAULTS_H
@@ -0,0 +1,398 @@
+#include "susi_cv_log.h"
+#include "susi_crc.h"
+#include <EEPROM.h>
+
+// --- EEPROM Layout ---
+// The EEPROM is split into two equally sized halves. Only the half with the
+// newest valid header is active; the other one holds an older generation and is
+// the target of the next compaction.
+//
+// Offset  | Size | Description
+//---------|------|-----------------------------------------------------------
+// 0       | 7    | Header:
+//         |      | - 1 byte:  CV_LOG_MAGIC
+//         |      | - 1 byte:  CV_LOG_VERSION
+//         |      | - 2 bytes: Generation, incremented by every compaction
+//         |      | - 2 bytes: Sequence number of the first record
+//         |      | - 1 byte:  CRC-8 over the previous 6 bytes
+// 7...    | 5/CV | Append-only CV records:
+//         |      | - 14 bits: Sequence number (base + slot)
+//         |      | - 10 bits: CV number
+//         |      | - 1 byte:  CV value
+//         |      | - 1 byte:  CRC-8 over the generation and the record
+//----------------------------------------------------------------------------
+// At boot the records of the active half are replayed in slot order until the
+// first slot whose sequence number or checksum does not match, which is where
+// the next record will be appended. Later records override earlier ones.
+const uint8_t CV_LOG_MAGIC = 0x5C;
+const uint8_t CV_LOG_VERSION = 2;
+const uint8_t CV_LOG_HEADER_SIZE = 7;
+const uint8_t CV_LOG_RECORD_SIZE = 5;
+const uint16_t CV_LOG_SEQ_MASK = 0x3FFF;
+
+// Layout used by earlier library versions: magic, count, then 3 bytes per CV.
+const uint8_t LEGACY_MAGIC_BYTE = 0x55;
+const int LEGACY_ADDR_CV_COUNT = 1;
+const int LEGACY_ADDR_CV_DATA_START = 2;
+const uint8_t LEGACY_MAX_CVS = 32;
+
+SusiCVLog::SusiCVLog(SusiCVTable& table, const SusiCVDefaults& defaults)
+    : _table(table), _defaults(defaults) {
+    _half_size = 0;
+    _slots = 0;
+    _active = 0;
+    _generation = 0;
+    _next_slot = 0;
+    _next_seq = 0;
+    _compacting = false;
+    _compact_again = false;
+    _compact_index = 0;
+    _compact_cv = 0;
+    _compact_base = 0;
+    _dirty_count = 0;
+    _cv_writes = 0;
+    _compactions = 0;
+    _overflow = false;
+    _corrupt_records = 0;
+    _load_time_us = 0;
+}
+
+void SusiCVLog::begin() {
+    unsigned long start_us = micros();
+    _half_size = EEPROM.length() / 2;
+    _slots = (_half_size - CV_LOG_HEADER_SIZE) / CV_LOG_RECORD_SIZE;
+    _queue.clear();
+    _table.clear();
+    _compacting = false;
+    _compact_again = false;
+    _dirty_count = 0;
+    _overflow = false;
+    _corrupt_records = 0;
+
+    uint16_t generation[2];
+    uint16_t base_seq[2];
+    bool valid0 = readHeader(0, generation[0], base_seq[0]);
+    bool valid1 = readHeader(1, generation[1], base_seq[1]);
+
+    if (!valid0 && !valid1) {
+        if (EEPROM.read(0) == LEGACY_MAGIC_BYTE) {
+            loadLegacy();
+        }
+        // Format by compacting the (possibly migrated) CVs into half 1 in idle
+        // time, which leaves any legacy data in half 0 intact until the new
+        // header is valid.
+        _active = 0;
+        _generation = 0;
+        _next_slot = 0;
+        _next_seq = 0;
+        startCompaction();
+        _load_time_us = micros() - start_us;
+        return;
+    }
+
+    if (valid0 && (!valid1 || (int16_t)(generation[0] - generation[1]) > 0)) {
+        _active = 0;
+    } else {
+        _active = 1;
+    }
+    _generation = generation[_active];
+
+    _next_slot = replay(base_seq[_active]);
+    _next_seq = (base_seq[_active] + _next_slot) & CV_LOG_SEQ_MASK;
+    if (_corrupt_records > 0) {
+        // Never append behind a damaged record; move the live CVs to the other half.
+        startCompaction();
+    }
+    _load_time_us = micros() - start_us;
+}
+
+uint16_t SusiCVLog::replay(uint16_t base_seq) {
+    uint8_t block[SUSI_CV_LOG_BOOT_BLOCK][CV_LOG_RECORD_SIZE];
+    uint16_t slot = 0;
+    while (slot < _slots) {
+        // Whole blocks are fetched with one EEPROM.get(), only the tail byte by byte.
+        uint16_t count = _slots - slot;
+        uint16_t address = recordAddress(_active, slot);
+        if (count >= SUSI_CV_LOG_BOOT_BLOCK) {
+            count = SUSI_CV_LOG_BOOT_BLOCK;
+            EEPROM.get(address, block);
+        } else {
+            for (uint16_t i = 0; i < count * CV_LOG_RECORD_SIZE; i++) {
+                block[i / CV_LOG_RECORD_SIZE][i % CV_LOG_RECORD_SIZE] = EEPROM.read(address + i);
+            }
+        }
+
+        for (uint16_t i = 0; i < count; i++, slot++) {
+            uint16_t seq = (base_seq + slot) & CV_LOG_SEQ_MASK;
+            uint16_t cv;
+            uint8_t value;
+            if (parseRecord(block[i], _generation, seq, cv, value)) {
+                restore(cv, value);
+            } else if (slot + 1 < _slots &&
+                       readRecord(_active, slot + 1, _generation, (seq + 1) & CV_LOG_SEQ_MASK, cv, value)) {
+                // Records are written in slot order, so a valid successor means this
+                // record was damaged after it was written, not torn by a power loss.
+                _corrupt_records++;
+            } else {
+                return slot;
+            }
+        }
+    }
+    return slot;
+}
+
+void SusiCVLog::reset() {
+    _table.clear();
+    if (_compacting) {
+        // Records already queued for the aborted compaction must not line up
+        // with the sequence numbers of the new one.
+        _next_seq = (_compact_base + _compact_index) & CV_LOG_SEQ_MASK;
+    }
+    _overflow = false;
+    _compact_again = false;
+    // Compacting the empty table writes nothing but the header of the other half.
+    startCompaction();
+}
+
+bool SusiCVLog::markDirty(uint16_t cv) {
+    if (_overflow) {
+        return false;
+    }
+
+    for (int i = 0; i < _dirty_count; i++) {
+        if (_dirty[i] == cv) {
+            return true;
+        }
+    }
+
+    if (_dirty_count == SUSI_CV_LOG_DIRTY_SIZE) {
+        // No room to wait for a record. A compaction copies every CV with its
+        // current value, so it persists this change too; a running one may
+        // already have passed the CV, so another one follows it.
+        if (_compacting) {
+            _compact_again = true;
+        } else {
+            startCompaction();
+        }
+        return true;
+    }
+
+    _dirty[_dirty_count++] = cv;
+    return true;
+}
+
+bool SusiCVLog::step() {
+    bool produced = produce();
+    bool committed = _queue.step();
+    return produced || committed;
+}
+
+void SusiCVLog::flush() {
+    while (pending() > 0) {
+        step();
+    }
+}
+
+uint16_t SusiCVLog::pending() const {
+    return _dirty_count + _queue.pending() + (_compacting ? 1 : 0);
+}
+
+void SusiCVLog::getStats(SusiCVLogStats& stats) const {
+    stats.cv_writes = _cv_writes;
+    stats.eeprom_writes = _queue.written();
+    stats.compactions = _compactions;
+    stats.generation = _generation;
+    stats.overflow = _overflow;
+    stats.corrupt_records = _corrupt_records;
+    stats.load_time_us = _load_time_us;
+}
+
+bool SusiCVLog::produce() {
+    if (_compacting) {
+        uint8_t target = 1 - _active;
+        uint16_t new_generation = _generation + 1;
+
+        uint16_t cv = _compact_cv;
+        uint8_t value;
+        if (_table.next(cv, value)) {
+            if (_compact_index >= _slots) {
+                // The live CVs do not fit into one half; keep the old half active.
+                _compacting = false;
+                _compact_again = false;
+                _overflow = true;
+                return true;
+            }
+            if (_queue.available() < CV_LOG_RECORD_SIZE) {
+                return false;
+            }
+            // The table is walked in CV order, so CVs added meanwhile are not missed.
+            queueRecord(target, _compact_index, new_generation,
+                        (_compact_base + _compact_index) & CV_LOG_SEQ_MASK, cv, value);
+            _compact_index++;
+            _compact_cv = cv + 1;
+            return true;
+        }
+
+        if (_queue.available() < CV_LOG_HEADER_SIZE) {
+            return false;
+        }
+        // The header is queued last; the new half only becomes valid once it is committed.
+        queueHeader(target, new_generation, _compact_base);
+        _active = target;
+        _generation = new_generation;
+        _next_slot = _compact_index;
+        _next_seq = (_compact_base + _compact_index) & CV_LOG_SEQ_MASK;
+        _compacting = false;
+        _compactions++;
+        if (_compact_again) {
+            _compact_again = false;
+            startCompaction();
+        }
+        return true;
+    }
+
+    if (_dirty_count == 0) {
+        return false;
+    }
+
+    if (_next_slot >= _slots) {
+        startCompaction();
+        return true;
+    }
+
+    if (_queue.available() < CV_LOG_RECORD_SIZE) {
+        return false;
+    }
+
+    uint16_t cv = _dirty[0];
+    _dirty_count--;
+    for (int i = 0; i < _dirty_count; i++) {
+        _dirty[i] = _dirty[i + 1];
+    }
+
+    uint8_t value;
+    if (_table.get(cv, value) || _defaults.get(cv, value)) {
+        queueRecord(_active, _next_slot, _generation, _next_seq, cv, value);
+        _next_slot++;
+        _next_seq = (_next_seq + 1) & CV_LOG_SEQ_MASK;
+        _cv_writes++;
+    }
+    return true;
+}
+
+void SusiCVLog::startCompaction() {
+    // The compaction copies the current value of every CV, so nothing is dirty anymore.
+    _compacting = true;
+    _compact_index = 0;
+    _compact_cv = 0;
+    _compact_base = _next_seq;
+    _dirty_count = 0;
+}
+
+bool SusiCVLog::readHeader(uint8_t half, uint16_t& generation, uint16_t& base_seq) const {
+    uint8_t header[CV_LOG_HEADER_SIZE];
+    EEPROM.get(half * _half_size, header);
+
+    if (header[0] != CV_LOG_MAGIC || header[1] != CV_LOG_VERSION) {
+        return false;
+    }
+    if (header[6] != crc8_rcn218(header, 6)) {
+        return false;
+    }
+
+    generation = header[2] | (header[3] << 8);
+    base_seq = header[4] | (header[5] << 8);
+    return true;
+}
+
+bool SusiCVLog::readRecord(uint8_t half, uint16_t slot, uint16_t generation, uint16_t seq, uint16_t& cv, uint8_t& value) const {
+    uint8_t raw[CV_LOG_RECORD_SIZE];
+    EEPROM.get(recordAddress(half, slot), raw);
+    return parseRecord(raw, generation, seq, cv, value);
+}
+
+bool SusiCVLog::parseRecord(const uint8_t* raw, uint16_t generation, uint16_t seq, uint16_t& cv, uint8_t& value) const {
+    uint8_t record[2 + CV_LOG_RECORD_SIZE];
+    record[0] = generation & 0xFF;
+    record[1] = generation >> 8;
+    for (int i = 0; i < CV_LOG_RECORD_SIZE; i++) {
+        record[2 + i] = raw[i];
+    }
+
+    uint16_t record_seq = record[2] | ((record[3] & 0x3F) << 8);
+    if (record_seq != seq) {
+        return false;
+    }
+    // The checksum covers the generation, so stale records left over from an
+    // earlier use of this half are rejected as well.
+    if (record[6] != crc8_rcn218(record, 6)) {
+        return false;
+    }
+
+    cv = ((record[3] >> 6) << 8) | record[4];
+    value = record[5];
+    return true;
+}
+
+void SusiCVLog::queueHeader(uint8_t half, uint16_t generation, uint16_t base_seq) {
+    uint8_t header[CV_LOG_HEADER_SIZE];
+    header[0] = CV_LOG_MAGIC;
+    header[1] = CV_LOG_VERSION;
+    header[2] = generation & 0xFF;
+    header[3] = generation >> 8;
+    header[4] = base_seq & 0xFF;
+    header[5] = base_seq >> 8;
+    header[6] = crc8_rcn218(header, 6);
+
+    uint16_t address = half * _half_size;
+    for (int i = 0; i < CV_LOG_HEADER_SIZE; i++) {
+        _queue.push(address + i, header[i]);
+    }
+}
+
+void SusiCVLog::queueRecord(uint8_t half, uint16_t slot, uint16_t generation, uint16_t seq, uint16_t cv, uint8_t value) {
+    uint8_t record[2 + CV_LOG_RECORD_SIZE];
+    record[0] = generation & 0xFF;
+    record[1] = generation >> 8;
+    record[2] = seq & 0xFF;
+    record[3] = ((seq >> 8) & 0x3F) | ((cv >> 8) << 6);
+    record[4] = cv & 0xFF;
+    record[5] = value;
+    record[6] = crc8_rcn218(record, 6);
+
+    // The checksum is the last byte written, so a torn record is never valid.
+    uint16_t address = recordAddress(half, slot);
+    for (int i = 0; i < CV_LOG_RECORD_SIZE; i++) {
+        _queue.push(address + i, record[2 + i]);
+    }
+}
+
+void SusiCVLog::restore(uint16_t cv, uint8_t value) {
+    // A record that returns a CV to its default removes the override.
+    uint8_t default_value;
+    if (_defaults.get(cv, default_value) && default_value == value) {
+        _table.erase(cv);
+    } else {
+        _table.set(cv, value);
+    }
+}
+
+uint16_t SusiCVLog::recordAddress(uint8_t half, uint16_t slot) const {
+    return half * _half_size + CV_LOG_HEADER_SIZE + slot * CV_LOG_RECORD_SIZE;
+}
+
+void SusiCVLog::loadLegacy() {
+    uint8_t count = EEPROM.read(LEGACY_ADDR_CV_COUNT);
+    if (count > LEGACY_MAX_CVS) {
+        return; // Data corruption, start with empty CVs.
+    }
+
+    int address = LEGACY_ADDR_CV_DATA_START;
+    for (int i = 0; i < count; i++) {
+        uint16_t cv;
+        EEPROM.get(address, cv);
+        address += sizeof(uint16_t);
+        restore(cv, EEPROM.read(address));
+        address += sizeof(uint8_t);
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef SUSI_CV_LOG_H
+#define SUSI_CV_LOG_H
+
+#include <Arduino.h>
+#include "susi_cv_table.h"
+#include "susi_cv_defaults.h"
+#include "susi_eeprom_queue.h"
+
+/**
+ * @brief The number of changed CVs that can wait for their log record.
+ * @details Can be overridden at compile time. Repeated writes to a waiting CV
+ * are merged into a single record.
+ */
+#ifndef SUSI_CV_LOG_DIRTY_SIZE
+#define SUSI_CV_LOG_DIRTY_SIZE 16
+#endif
+
+/**
+ * @brief The number of log records fetched with one EEPROM block read at boot.
+ * @details Can be overridden at compile time; costs 5 bytes of stack per record.
+ */
+#ifndef SUSI_CV_LOG_BOOT_BLOCK
+#define SUSI_CV_LOG_BOOT_BLOCK 8
+#endif
+
+/**
+ * @brief Wear statistics of the CV log.
+ */
+struct SusiCVLogStats {
+    /**
+     * @brief The number of CV records appended for changed CVs.
+     */
+    uint32_t cv_writes;
+    /**
+     * @brief The number of EEPROM cells physically written, including compaction.
+     * @details eeprom_writes / cv_writes is the write amplification.
+     */
+    uint32_t eeprom_writes;
+    /**
+     * @brief The number of completed compactions.
+     */
+    uint16_t compactions;
+    /**
+     * @brief The generation of the active log half.
+     */
+    uint16_t generation;
+    /**
+     * @brief Whether the stored CVs no longer fit into one log half.
+     * @details CV changes are then kept in RAM only, and markDirty() returns
+     * false, until reset() or the next begin().
+     */
+    bool overflow;
+    /**
+     * @brief The number of damaged records skipped by the last begin().
+     * @details The log is compacted into the other half when this is not 0.
+     */
+    uint16_t corrupt_records;
+    /**
+     * @brief The time the last begin() took to load the CVs, in microseconds.
+     */
+    uint32_t load_time_us;
+};
+
+/**
+ * @brief A log-structured, wear-levelled EEPROM store for the slave's CVs.
+ * @details The EEPROM is split into two halves. The active half holds a header
+ * followed by an append-only log of CV records. A changed CV is appended as a new
+ * record instead of rewriting its previous cell. When the active half is full, the
+ * live CVs are compacted into the other half, which then becomes active, so writes
+ * rotate across the whole EEPROM.
+ *
+ * All writes go through a SusiEepromQueue and are committed in idle time, one
+ * byte per step(). Records are only valid once their trailing checksum is written
+ * and a compacted half only becomes active once its header is written, so a power
+ * loss at any point leaves the last consistent state.
+ */
+class SusiCVLog {
+public:
+    /**
+     * @brief Constructs a new SusiCVLog object.
+     * @param table The RAM index that the log persists.
+     * @param defaults The CV defaults; CVs equal to their default are not kept in the table.
+     */
+    SusiCVLog(SusiCVTable& table, const SusiCVDefaults& defaults);
+
+    /**
+     * @brief Rebuilds the RAM index from the EEPROM.
+     * @details Scans the active half once, reading the records in blocks. An
+     * EEPROM without a valid log header is formatted in idle time, like any other
+     * write, and all CVs fall back to their defaults; CVs in the layout of earlier
+     * library versions are migrated.
+     * A damaged record inside the log is skipped and the log is compacted.
+     */
+    void begin();
+
+    /**
+     * @brief Drops all stored CVs, returning every CV to its default.
+     * @details Only a new, empty log header is written, in idle time like any
+     * other change.
+     */
+    void reset();
+
+    /**
+     * @brief Schedules the current RAM value of a CV to be persisted.
+     * @details A CV that is not in the table is persisted with its default.
+     * Never writes the EEPROM itself: when more CVs change than can wait for
+     * their records, a compaction is scheduled instead, which persists the
+     * current value of every CV.
+     * @param cv The CV number.
+     * @return bool Whether the change will be persisted, false if the stored
+     * CVs overflow one log half and the change is kept in RAM only.
+     */
+    bool markDirty(uint16_t cv);
+
+    /**
+     * @brief Performs a slice of the pending work, writing at most one EEPROM byte.
+     * @return bool Whether any work was done.
+     */
+    bool step();
+
+    /**
+     * @brief Persists all pending CV changes.
+     */
+    void flush();
+
+    /**
+     * @brief Gets the amount of pending work.
+     * @return uint16_t The number of waiting CVs plus queued EEPROM bytes; 0 when idle.
+     */
+    uint16_t pending() const;
+
+    /**
+     * @brief Gets the wear statistics.
+     * @param stats A reference to a structure to store the statistics in.
+     */
+    void getStats(SusiCVLogStats& stats) const;
+
+private:
+    bool produce();
+    void startCompaction();
+    bool readHeader(uint8_t half, uint16_t& generation, uint16_t& base_seq) const;
+    uint16_t replay(uint16_t base_seq);
+    uint16_t recordAddress(uint8_t half, uint16_t slot) const;
+    bool parseRecord(const uint8_t* raw, uint16_t generation, uint16_t seq, uint16_t& cv, uint8_t& value) const;
+    bool readRecord(uint8_t half, uint16_t slot, uint16_t generation, uint16_t seq, uint16_t& cv, uint8_t& value) const;
+    void queueHeader(uint8_t half, uint16_t generation, uint16_t base_seq);
+    void queueRecord(uint8_t half, uint16_t slot, uint16_t generation, uint16_t seq, uint16_t cv, uint8_t value);
+    void loadLegacy();
+    void restore(uint16_t cv, uint8_t value);
+
+    SusiCVTable& _table;
+    const SusiCVDefaults& _defaults;
+    SusiEepromQueue _queue;
+    uint16_t _half_size;
+    uint16_t _slots;
+
+    uint8_t _active;
+    uint16_t _generation;
+    uint16_t _next_slot;
+    uint16_t _next_seq;
+
+    bool _compacting;
+    bool _compact_again; // A CV the running compaction may have passed changed
+    uint16_t _compact_index;
+    uint16_t _compact_cv;
+    uint16_t _compact_base;
+
+    uint16_t _dirty[SUSI_CV_LOG_DIRTY_SIZE];
+    uint8_t _dirty_count;
+
+    uint32_t _cv_writes;
+    uint16_t _compactions;
+    bool _overflow;
+    uint16_t _corrupt_records;
+    uint32_t _load_time_us;
+};
+
+#endif // SUSI_CV_LOG_H
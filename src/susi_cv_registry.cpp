@@ -0,0 +1,135 @@
+#include "susi_cv_registry.h"
+
+const uint8_t SUSI_CV_REGISTRY_PAGE_SHIFT = 4;
+const uint8_t SUSI_CV_REGISTRY_PAGES = 1024 >> SUSI_CV_REGISTRY_PAGE_SHIFT;
+const uint8_t SUSI_CV_REGISTRY_NONE = 0xFF;
+
+SusiCVRegistry::SusiCVRegistry() {
+    clear();
+}
+
+bool SusiCVRegistry::bind(uint16_t first, uint16_t count, CVReadCallback read, CVWriteCallback write,
+                          void* context, uint8_t bank) {
+    SusiCVProvider provider;
+    provider.first = first;
+    provider.count = count;
+    provider.bank = bank;
+    provider.writable = write != nullptr;
+    provider.memory = nullptr;
+    provider.read = read;
+    provider.write = write;
+    provider.context = context;
+    return add(provider);
+}
+
+bool SusiCVRegistry::bindMemory(uint16_t first, uint16_t count, uint8_t* memory, bool writable,
+                                uint8_t bank) {
+    SusiCVProvider provider;
+    provider.first = first;
+    provider.count = count;
+    provider.bank = bank;
+    provider.writable = writable;
+    provider.memory = memory;
+    provider.read = nullptr;
+    provider.write = nullptr;
+    provider.context = nullptr;
+    return add(provider);
+}
+
+bool SusiCVRegistry::read(uint16_t cv, uint8_t bank, uint8_t& value) const {
+    bool banked;
+    const SusiCVProvider* provider = find(cv, bank, banked);
+    if (provider == nullptr) {
+        if (banked) {
+            value = 0;
+        }
+        return banked;
+    }
+
+    if (provider->memory != nullptr) {
+        value = provider->memory[cv - provider->first];
+    } else if (provider->read != nullptr) {
+        value = provider->read(cv, provider->context);
+    } else {
+        value = 0;
+    }
+    return true;
+}
+
+bool SusiCVRegistry::write(uint16_t cv, uint8_t bank, uint8_t value) {
+    bool banked;
+    const SusiCVProvider* provider = find(cv, bank, banked);
+    if (provider == nullptr) {
+        return banked;
+    }
+
+    if (provider->writable) {
+        if (provider->memory != nullptr) {
+            provider->memory[cv - provider->first] = value;
+        } else {
+            provider->write(cv, value, provider->context);
+        }
+    }
+    return true;
+}
+
+void SusiCVRegistry::clear() {
+    _count = 0;
+    for (int i = 0; i < SUSI_CV_REGISTRY_PAGES; i++) {
+        _pages[i] = SUSI_CV_REGISTRY_NONE;
+    }
+}
+
+bool SusiCVRegistry::add(const SusiCVProvider& provider) {
+    if (_count >= SUSI_CV_REGISTRY_SIZE || provider.count == 0 ||
+        provider.first + provider.count > 1024) {
+        return false;
+    }
+
+    uint8_t index = _count;
+    while (index > 0 && _providers[index - 1].first > provider.first) {
+        _providers[index] = _providers[index - 1];
+        index--;
+    }
+    _providers[index] = provider;
+    _count++;
+
+    // Rebuild the page directory: for every page, the first range (in sorted
+    // order) that ends in or after the page.
+    for (int page = 0; page < SUSI_CV_REGISTRY_PAGES; page++) {
+        uint16_t page_start = page << SUSI_CV_REGISTRY_PAGE_SHIFT;
+        uint16_t page_end = page_start + (1 << SUSI_CV_REGISTRY_PAGE_SHIFT);
+        _pages[page] = SUSI_CV_REGISTRY_NONE;
+        for (uint8_t i = 0; i < _count && _providers[i].first < page_end; i++) {
+            if (_providers[i].first + _providers[i].count > page_start) {
+                _pages[page] = i;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+const SusiCVProvider* SusiCVRegistry::find(uint16_t cv, uint8_t bank, bool& banked) const {
+    banked = false;
+    if (cv >= 1024) {
+        return nullptr;
+    }
+
+    uint8_t index = _pages[cv >> SUSI_CV_REGISTRY_PAGE_SHIFT];
+    if (index == SUSI_CV_REGISTRY_NONE) {
+        return nullptr;
+    }
+
+    for (; index < _count && _providers[index].first <= cv; index++) {
+        const SusiCVProvider& provider = _providers[index];
+        if (cv >= provider.first + provider.count) {
+            continue;
+        }
+        if (provider.bank == SUSI_CV_ANY_BANK || provider.bank == bank) {
+            return &provider;
+        }
+        banked = true;
+    }
+    return nullptr;
+}
@@ -0,0 +1,136 @@
+#ifndef SUSI_CV_REGISTRY_H
+#define SUSI_CV_REGISTRY_H
+
+#include <Arduino.h>
+
+/**
+ * @brief The maximum number of CV ranges that can be bound to providers.
+ * @details The slave uses 9 entries for its own special CVs. Can be overridden
+ * at compile time.
+ */
+#ifndef SUSI_CV_REGISTRY_SIZE
+#define SUSI_CV_REGISTRY_SIZE 16
+#endif
+
+/**
+ * @brief The bank qualifier of a provider that answers in every CV bank.
+ */
+const uint8_t SUSI_CV_ANY_BANK = 0xFF;
+
+/**
+ * @brief A callback function that provides the value of a virtual CV.
+ * @param cv The CV that is read.
+ * @param context The context pointer given when the CV range was bound.
+ * @return uint8_t The value of the CV.
+ */
+typedef uint8_t (*CVReadCallback)(uint16_t cv, void* context);
+
+/**
+ * @brief A callback function that is called when a virtual CV is written.
+ * @param cv The CV that is written.
+ * @param value The new value.
+ * @param context The context pointer given when the CV range was bound.
+ */
+typedef void (*CVWriteCallback)(uint16_t cv, uint8_t value, void* context);
+
+/**
+ * @brief A range of CVs bound to callbacks or to a memory location.
+ */
+struct SusiCVProvider {
+    uint16_t first;
+    uint16_t count;
+    uint8_t bank;
+    bool writable;
+    uint8_t* memory;
+    CVReadCallback read;
+    CVWriteCallback write;
+    void* context;
+};
+
+/**
+ * @brief A registry of virtual CVs.
+ * @details Applications bind CV ranges to read/write callbacks or directly to
+ * memory, e.g. to expose live values such as a temperature or the volume as CVs.
+ * CVs that are not bound are stored in the regular CV table.
+ *
+ * A range can be restricted to one CV bank (the value of CV 1021), which is how
+ * the RCN-602 identification CVs 900/940/980 show different values per bank. A
+ * CV that is only bound for other banks reads as 0 and ignores writes.
+ *
+ * Lookups go through a directory of 16-CV pages that points to the first range
+ * reaching into the page, so only the few ranges near a CV are checked.
+ */
+class SusiCVRegistry {
+public:
+    /**
+     * @brief Constructs an empty registry.
+     */
+    SusiCVRegistry();
+
+    /**
+     * @brief Binds a CV range to callbacks.
+     * @param first The first CV of the range.
+     * @param count The number of CVs in the range.
+     * @param read The callback that provides the values.
+     * @param write The callback for writes, or nullptr for read-only CVs.
+     * @param context A pointer that is passed to the callbacks.
+     * @param bank The CV bank the range is valid in, or SUSI_CV_ANY_BANK.
+     * @return bool Whether the range was bound, false if the registry is full.
+     */
+    bool bind(uint16_t first, uint16_t count, CVReadCallback read, CVWriteCallback write,
+              void* context, uint8_t bank = SUSI_CV_ANY_BANK);
+
+    /**
+     * @brief Binds a CV range directly to memory.
+     * @param first The first CV of the range.
+     * @param count The number of CVs in the range.
+     * @param memory The memory location of the first CV, one byte per CV.
+     * @param writable Whether writes to the CVs change the memory.
+     * @param bank The CV bank the range is valid in, or SUSI_CV_ANY_BANK.
+     * @return bool Whether the range was bound, false if the registry is full.
+     */
+    bool bindMemory(uint16_t first, uint16_t count, uint8_t* memory, bool writable,
+                    uint8_t bank = SUSI_CV_ANY_BANK);
+
+    /**
+     * @brief Reads a virtual CV.
+     * @param cv The CV number.
+     * @param bank The currently selected CV bank.
+     * @param value A reference to a byte to store the value in.
+     * @return bool Whether the CV is bound, false if it is a regular CV.
+     */
+    bool read(uint16_t cv, uint8_t bank, uint8_t& value) const;
+
+    /**
+     * @brief Writes a virtual CV.
+     * @param cv The CV number.
+     * @param bank The currently selected CV bank.
+     * @param value The value to write.
+     * @return bool Whether the CV is bound, false if it is a regular CV.
+     */
+    bool write(uint16_t cv, uint8_t bank, uint8_t value);
+
+    /**
+     * @brief Removes all bindings.
+     */
+    void clear();
+
+    /**
+     * @brief Gets the number of bound ranges.
+     * @return uint8_t The number of bound ranges.
+     */
+    uint8_t size() const { return _count; }
+
+private:
+    bool add(const SusiCVProvider& provider);
+    const SusiCVProvider* find(uint16_t cv, uint8_t bank, bool& banked) const;
+
+    // Ranges sorted by their first CV; ranges with the same first CV keep the
+    // order in which they were bound.
+    SusiCVProvider _providers[SUSI_CV_REGISTRY_SIZE];
+    uint8_t _count;
+    // Index of the first range reaching into each page of 16 CVs.
+    uint8_t _pages[1024 / 16];
+};
+
+#endif // SUSI_CV_REGISTRY_H
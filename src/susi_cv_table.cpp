@@ -0,0 +1,168 @@
+#include "susi_cv_table.h"
+
+const uint8_t SUSI_CV_NO_PAGE = 0xFF;
+
+SusiCVTable::SusiCVTable() {
+    clear();
+}
+
+bool SusiCVTable::get(uint16_t cv, uint8_t& value) const {
+    if (cv >= SUSI_CV_WINDOW_START && cv < 1024) {
+        uint16_t offset = cv - SUSI_CV_WINDOW_START;
+        uint8_t page = _page_dir[offset / SUSI_CV_PAGE_SIZE];
+        if (page != SUSI_CV_NO_PAGE) {
+            if (_page_bits[page] & (1u << (offset % SUSI_CV_PAGE_SIZE))) {
+                value = _page_values[page][offset % SUSI_CV_PAGE_SIZE];
+                return true;
+            }
+            return false;
+        }
+        // Without a page the CV can only be in the sparse region.
+    }
+
+    uint16_t index;
+    if (findSparse(cv, index)) {
+        value = _sparse_values[index];
+        return true;
+    }
+    return false;
+}
+
+bool SusiCVTable::set(uint16_t cv, uint8_t value) {
+    uint16_t index;
+    if (findSparse(cv, index)) {
+        _sparse_values[index] = value;
+        return true;
+    }
+
+    if (cv >= SUSI_CV_WINDOW_START && cv < 1024) {
+        uint16_t offset = cv - SUSI_CV_WINDOW_START;
+        uint8_t& page = _page_dir[offset / SUSI_CV_PAGE_SIZE];
+        if (page == SUSI_CV_NO_PAGE && _pages_used < SUSI_CV_WINDOW_PAGES) {
+            page = _pages_used++;
+            _page_bits[page] = 0;
+        }
+        if (page != SUSI_CV_NO_PAGE) {
+            uint16_t bit = 1u << (offset % SUSI_CV_PAGE_SIZE);
+            if (!(_page_bits[page] & bit)) {
+                _page_bits[page] |= bit;
+                _count++;
+            }
+            _page_values[page][offset % SUSI_CV_PAGE_SIZE] = value;
+            return true;
+        }
+        // All pages are in use, fall back to the sparse region.
+    } else if (cv >= 1024) {
+        return false;
+    }
+
+    if (_sparse_count >= SUSI_CV_SPARSE_CAPACITY) {
+        return false;
+    }
+
+    for (uint16_t i = _sparse_count; i > index; i--) {
+        _sparse_keys[i] = _sparse_keys[i - 1];
+        _sparse_values[i] = _sparse_values[i - 1];
+    }
+    _sparse_keys[index] = cv;
+    _sparse_values[index] = value;
+    _sparse_count++;
+    _count++;
+    return true;
+}
+
+bool SusiCVTable::erase(uint16_t cv) {
+    uint16_t index;
+    if (findSparse(cv, index)) {
+        _sparse_count--;
+        for (uint16_t i = index; i < _sparse_count; i++) {
+            _sparse_keys[i] = _sparse_keys[i + 1];
+            _sparse_values[i] = _sparse_values[i + 1];
+        }
+        _count--;
+        return true;
+    }
+
+    if (cv >= SUSI_CV_WINDOW_START && cv < 1024) {
+        uint16_t offset = cv - SUSI_CV_WINDOW_START;
+        uint8_t page = _page_dir[offset / SUSI_CV_PAGE_SIZE];
+        uint16_t bit = 1u << (offset % SUSI_CV_PAGE_SIZE);
+        // The page stays allocated, it is likely to be written again.
+        if (page != SUSI_CV_NO_PAGE && (_page_bits[page] & bit)) {
+            _page_bits[page] &= ~bit;
+            _count--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SusiCVTable::clear() {
+    for (int i = 0; i < SUSI_CV_WINDOW_PAGE_COUNT; i++) {
+        _page_dir[i] = SUSI_CV_NO_PAGE;
+    }
+    _pages_used = 0;
+    _sparse_count = 0;
+    _count = 0;
+}
+
+bool SusiCVTable::next(uint16_t& cv, uint8_t& value) const {
+    uint16_t index;
+    findSparse(cv, index);
+
+    uint16_t window_cv = cv;
+    uint8_t window_value;
+    bool in_window = nextInWindow(window_cv, window_value);
+
+    if (index < _sparse_count && (!in_window || _sparse_keys[index] < window_cv)) {
+        cv = _sparse_keys[index];
+        value = _sparse_values[index];
+        return true;
+    }
+    if (in_window) {
+        cv = window_cv;
+        value = window_value;
+        return true;
+    }
+    return false;
+}
+
+bool SusiCVTable::findSparse(uint16_t cv, uint16_t& index) const {
+    // Binary search for the first entry not below cv.
+    uint16_t low = 0;
+    uint16_t high = _sparse_count;
+    while (low < high) {
+        uint16_t mid = (low + high) / 2;
+        if (_sparse_keys[mid] < cv) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    index = low;
+    return low < _sparse_count && _sparse_keys[low] == cv;
+}
+
+bool SusiCVTable::nextInWindow(uint16_t& cv, uint8_t& value) const {
+    uint16_t offset = cv < SUSI_CV_WINDOW_START ? 0 : cv - SUSI_CV_WINDOW_START;
+    while (offset < SUSI_CV_WINDOW_PAGE_COUNT * SUSI_CV_PAGE_SIZE) {
+        uint8_t page = _page_dir[offset / SUSI_CV_PAGE_SIZE];
+        if (page == SUSI_CV_NO_PAGE) {
+            offset = (offset / SUSI_CV_PAGE_SIZE + 1) * SUSI_CV_PAGE_SIZE;
+            continue;
+        }
+        uint16_t bits = _page_bits[page] >> (offset % SUSI_CV_PAGE_SIZE);
+        if (bits == 0) {
+            offset = (offset / SUSI_CV_PAGE_SIZE + 1) * SUSI_CV_PAGE_SIZE;
+            continue;
+        }
+        while (!(bits & 1)) {
+            bits >>= 1;
+            offset++;
+        }
+        cv = SUSI_CV_WINDOW_START + offset;
+        value = _page_values[page][offset % SUSI_CV_PAGE_SIZE];
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,122 @@
+#ifndef SUSI_CV_TABLE_H
+#define SUSI_CV_TABLE_H
+
+#include <Arduino.h>
+
+/**
+ * @brief The number of 16-CV pages available for the CV window 897–1024.
+ * @details Each page costs 18 bytes of RAM and is allocated on the first write
+ * to one of its CVs. 8 pages cover the whole window. Can be overridden at
+ * compile time.
+ */
+#ifndef SUSI_CV_WINDOW_PAGES
+#define SUSI_CV_WINDOW_PAGES 8
+#endif
+
+/**
+ * @brief The number of CVs that can be stored outside of the window pages.
+ * @details Each entry costs 3 bytes of RAM. Used for CVs below 897 and for
+ * window CVs once all window pages are in use. Can be overridden at compile time.
+ */
+#ifndef SUSI_CV_SPARSE_CAPACITY
+#define SUSI_CV_SPARSE_CAPACITY 32
+#endif
+
+/**
+ * @brief The first CV number (slave key) covered by the window pages.
+ */
+const uint16_t SUSI_CV_WINDOW_START = 896;
+
+/**
+ * @brief The number of CVs in one window page.
+ */
+const uint8_t SUSI_CV_PAGE_SIZE = 16;
+
+/**
+ * @brief The number of pages needed to cover the whole CV window.
+ */
+const uint8_t SUSI_CV_WINDOW_PAGE_COUNT = (1024 - SUSI_CV_WINDOW_START) / SUSI_CV_PAGE_SIZE;
+
+/**
+ * @brief The maximum number of CVs that can be stored by the slave.
+ */
+const uint16_t MAX_CVS = SUSI_CV_WINDOW_PAGES * SUSI_CV_PAGE_SIZE + SUSI_CV_SPARSE_CAPACITY;
+
+/**
+ * @brief The RAM index of the CVs stored by a SUSI slave.
+ * @details CVs of the window 897–1024 are kept in pages of 16 values with a
+ * presence bitmap, found through a page directory in constant time. All other
+ * CVs are kept in a sorted array and found by binary search. The persistent
+ * copy in the EEPROM is maintained separately by SusiCVLog.
+ */
+class SusiCVTable {
+public:
+    /**
+     * @brief Constructs an empty CV table.
+     */
+    SusiCVTable();
+
+    /**
+     * @brief Looks up a CV.
+     * @param cv The CV number.
+     * @param value A reference to a byte to store the value in.
+     * @return bool Whether the CV is stored in the table.
+     */
+    bool get(uint16_t cv, uint8_t& value) const;
+
+    /**
+     * @brief Stores a CV, adding it if it is not in the table yet.
+     * @param cv The CV number (0–1023).
+     * @param value The value to store.
+     * @return bool Whether the CV was stored, false if the table is full.
+     */
+    bool set(uint16_t cv, uint8_t value);
+
+    /**
+     * @brief Removes a CV from the table.
+     * @param cv The CV number.
+     * @return bool Whether the CV was stored in the table.
+     */
+    bool erase(uint16_t cv);
+
+    /**
+     * @brief Removes all CVs from the table.
+     */
+    void clear();
+
+    /**
+     * @brief Gets the number of stored CVs.
+     * @return uint16_t The number of stored CVs.
+     */
+    uint16_t size() const { return _count; }
+
+    /**
+     * @brief Finds the stored CV with the lowest number at or above a given CV.
+     * @details Iterating with next(cv + 1) visits all CVs in ascending order and
+     * is not disturbed by CVs added in between.
+     * @param cv The CV number to start at, updated with the CV found.
+     * @param value A reference to a byte to store the value in.
+     * @return bool Whether a CV was found.
+     */
+    bool next(uint16_t& cv, uint8_t& value) const;
+
+private:
+    bool findSparse(uint16_t cv, uint16_t& index) const;
+    bool nextInWindow(uint16_t& cv, uint8_t& value) const;
+
+    // Window pages, allocated on demand. _page_dir maps a window page to its
+    // slot, or SUSI_CV_NO_PAGE.
+    uint8_t _page_dir[SUSI_CV_WINDOW_PAGE_COUNT];
+    uint16_t _page_bits[SUSI_CV_WINDOW_PAGES];
+    uint8_t _page_values[SUSI_CV_WINDOW_PAGES][SUSI_CV_PAGE_SIZE];
+    uint8_t _pages_used;
+
+    // Sparse CVs, sorted by CV number.
+    uint16_t _sparse_keys[SUSI_CV_SPARSE_CAPACITY];
+    uint8_t _sparse_values[SUSI_CV_SPARSE_CAPACITY];
+    uint16_t _sparse_count;
+
+    uint16_t _count;
+};
+
+#endif // SUSI_CV_TABLE_H
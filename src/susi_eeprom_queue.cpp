@@ -0,0 +1,56 @@
+#include "susi_eeprom_queue.h"
+#include <EEPROM.h>
+
+SusiEepromQueue::SusiEepromQueue() {
+    _head = 0;
+    _count = 0;
+    _written = 0;
+}
+
+void SusiEepromQueue::push(uint16_t address, uint8_t value) {
+    if (_count > 0) {
+        SusiEepromWrite& tail = _entries[(_head + _count - 1) % SUSI_EEPROM_QUEUE_SIZE];
+        if (tail.address == address) {
+            tail.value = value;
+            return;
+        }
+    }
+
+    if (_count == SUSI_EEPROM_QUEUE_SIZE) {
+        // Never drop data: make room by committing the oldest write now.
+        step();
+    }
+
+    SusiEepromWrite& entry = _entries[(_head + _count) % SUSI_EEPROM_QUEUE_SIZE];
+    entry.address = address;
+    entry.value = value;
+    _count++;
+}
+
+bool SusiEepromQueue::step() {
+    if (_count == 0) {
+        return false;
+    }
+    commit(_entries[_head]);
+    _head = (_head + 1) % SUSI_EEPROM_QUEUE_SIZE;
+    _count--;
+    return true;
+}
+
+void SusiEepromQueue::flush() {
+    while (step()) {
+    }
+}
+
+void SusiEepromQueue::clear() {
+    _head = 0;
+    _count = 0;
+}
+
+void SusiEepromQueue::commit(const SusiEepromWrite& write) {
+    // Skip unchanged cells, like EEPROM.update(), to save time and wear.
+    if (EEPROM.read(write.address) != write.value) {
+        EEPROM.write(write.address, write.value);
+        _written++;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef SUSI_EEPROM_QUEUE_H
+#define SUSI_EEPROM_QUEUE_H
+
+#include <Arduino.h>
+
+/**
+ * @brief The number of pending EEPROM byte writes that can be deferred.
+ * @details Can be overridden at compile time. When the queue is full, the oldest
+ * pending write is committed synchronously so that no data is ever dropped.
+ */
+#ifndef SUSI_EEPROM_QUEUE_SIZE
+#define SUSI_EEPROM_QUEUE_SIZE 16
+#endif
+
+/**
+ * @brief Represents a single deferred EEPROM byte write.
+ */
+struct SusiEepromWrite {
+    uint16_t address;
+    uint8_t value;
+};
+
+/**
+ * @brief A bounded FIFO of deferred EEPROM byte writes.
+ * @details An EEPROM byte write takes about 3.3ms on AVR. Deferring the writes
+ * lets the caller acknowledge a command immediately and commit the data later,
+ * one byte at a time, while the bus is idle. Writes are committed strictly in
+ * the order they were pushed, so callers can rely on the ordering for
+ * power-fail safety (e.g. write a value before the count that makes it valid).
+ */
+class SusiEepromQueue {
+public:
+    /**
+     * @brief Constructs an empty queue.
+     */
+    SusiEepromQueue();
+
+    /**
+     * @brief Queues a byte write.
+     * @details A write to the same address as the most recent pending write
+     * replaces it. If the queue is full, the oldest pending write is committed first.
+     * @param address The EEPROM address.
+     * @param value The value to write.
+     */
+    void push(uint16_t address, uint8_t value);
+
+    /**
+     * @brief Commits the oldest pending write, if any.
+     * @return bool Whether a write was committed.
+     */
+    bool step();
+
+    /**
+     * @brief Commits all pending writes.
+     */
+    void flush();
+
+    /**
+     * @brief Gets the number of pending writes.
+     * @return uint8_t The number of pending writes.
+     */
+    uint8_t pending() const { return _count; }
+
+    /**
+     * @brief Gets the number of writes that can be queued without blocking.
+     * @return uint8_t The number of free queue entries.
+     */
+    uint8_t available() const { return SUSI_EEPROM_QUEUE_SIZE - _count; }
+
+    /**
+     * @brief Gets the number of EEPROM cells physically written so far.
+     * @details Writes of an unchanged value are skipped and not counted.
+     * @return uint32_t The number of cell writes.
+     */
+    uint32_t written() const { return _written; }
+
+    /**
+     * @brief Discards all pending writes without committing them.
+     */
+    void clear();
+
+private:
+    void commit(const SusiEepromWrite& write);
+
+    SusiEepromWrite _entries[SUSI_EEPROM_QUEUE_SIZE];
+    uint8_t _head;
+    uint8_t _count;
+    uint32_t _written;
+};
+
+#endif // SUSI_EEPROM_QUEUE_H
@@ -1,9 +1,28 @@
 #include "susi_hal.h"
 #include "susi_response.h"
 
+// Length of the ACK pulse sent by a slave (RCN-600: 1-2ms).
+const uint32_t SUSI_ACK_PULSE_US = 1000;
+
+// Valid length of an ACK pulse as seen by the master.
+const uint32_t SUSI_ACK_MIN_US = 500;
+const uint32_t SUSI_ACK_MAX_US = 7000;
+
+// Time between two samples of the data line while waiting for an ACK.
+const uint32_t SUSI_ACK_POLL_US = 10;
+
+// Half a clock period of the master.
+const uint32_t SUSI_HALF_CLOCK_US = 10;
+
+// Longest wait for the next clock edge of an answer before giving up.
+const uint32_t SUSI_ANSWER_CLOCK_TIMEOUT_US = 2000;
+
 SusiHAL::SusiHAL(uint8_t clock_pin, uint8_t data_pin) {
     _clock_pin = clock_pin;
     _data_pin = data_pin;
+    _clock = &susiDefaultClock();
+    _ack_latency_us = 0;
+    _ack_running = false;
 }
 
 void SusiHAL::begin() {
@@ -21,9 +40,9 @@ void SusiHAL::set_clock_low() {
 
 void SusiHAL::generate_clock_pulse() {
     set_clock_low();
-    delayMicroseconds(10);
+    _clock->delayMicros(SUSI_HALF_CLOCK_US);
     set_clock_high();
-    delayMicroseconds(10);
+    _clock->delayMicros(SUSI_HALF_CLOCK_US);
 }
 
 void SusiHAL::set_data_high() {
@@ -41,38 +60,45 @@ bool SusiHAL::read_data() {
     return value;
 }
 
+bool SusiHAL::read_clock() {
+    return digitalRead(_clock_pin);
+}
+
 bool SusiHAL::read_bit() {
     set_clock_low();
-    delayMicroseconds(10);
+    _clock->delayMicros(SUSI_HALF_CLOCK_US);
     bool value = read_data();
     set_clock_high();
-    delayMicroseconds(10);
+    _clock->delayMicros(SUSI_HALF_CLOCK_US);
     return value;
 }
 
-SusiMasterResult SusiHAL::waitForAck() {
-    unsigned long start_time = millis();
+SusiMasterResult SusiHAL::waitForAck(uint32_t timeout_us) {
+    uint32_t start_time = _clock->nowMicros();
 
     // Wait for the data line to go LOW (start of ACK)
     while (read_data()) {
-        if (millis() - start_time > 20) {
+        if (susiElapsed(start_time, _clock->nowMicros()) > timeout_us) {
             return TIMEOUT;
         }
+        _clock->delayMicros(SUSI_ACK_POLL_US);
     }
 
-    unsigned long pulse_start_time = micros();
+    uint32_t pulse_start_time = _clock->nowMicros();
+    _ack_latency_us = susiElapsed(start_time, pulse_start_time);
 
     // Wait for the data line to go HIGH again (end of ACK)
     while (!read_data()) {
-        if (millis() - start_time > 20) {
+        if (susiElapsed(start_time, _clock->nowMicros()) > SUSI_ACK_TIMEOUT_US) {
             return TIMEOUT;
         }
+        _clock->delayMicros(SUSI_ACK_POLL_US);
     }
 
-    unsigned long pulse_duration = micros() - pulse_start_time;
+    uint32_t pulse_duration = susiElapsed(pulse_start_time, _clock->nowMicros());
 
     // Check if the pulse duration is within the valid range (0.5ms to 7ms)
-    if (pulse_duration >= 500 && pulse_duration <= 7000) {
+    if (pulse_duration >= SUSI_ACK_MIN_US && pulse_duration <= SUSI_ACK_MAX_US) {
         return SUCCESS;
     }
 
@@ -82,18 +108,57 @@ SusiMasterResult SusiHAL::waitForAck() {
 void SusiHAL::sendAck() {
     pinMode(_data_pin, OUTPUT);
     digitalWrite(_data_pin, LOW);
-    delay(1); // 1-2ms ACK pulse
+    _clock->delayMicros(SUSI_ACK_PULSE_US); // 1-2ms ACK pulse
+    digitalWrite(_data_pin, HIGH);
+    pinMode(_data_pin, INPUT);
+}
+
+void SusiHAL::sendAckFromISR() {
+    pinMode(_data_pin, OUTPUT);
+    digitalWrite(_data_pin, LOW);
+    _ack_running = true;
+    if (!startAckTimer(SUSI_ACK_PULSE_US)) {
+        _clock->delayMicros(SUSI_ACK_PULSE_US);
+        finishAck();
+    }
+}
+
+void SusiHAL::finishAck() {
+    if (_ack_running) {
+        _ack_running = false;
+        digitalWrite(_data_pin, HIGH);
+    }
+}
+
+void SusiHAL::release_data() {
     digitalWrite(_data_pin, HIGH);
     pinMode(_data_pin, INPUT);
 }
 
-void SusiHAL::sendByte(uint8_t byte) {
+bool SusiHAL::sendByte(uint8_t byte) {
+    pinMode(_data_pin, OUTPUT);
     for (int i = 0; i < 8; i++) {
+        if (!waitForClock(false)) {
+            return false;
+        }
         if ((byte >> i) & 0x01) {
             set_data_high();
         } else {
             set_data_low();
         }
-        generate_clock_pulse();
+        if (!waitForClock(true)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SusiHAL::waitForClock(bool level) {
+    uint32_t start_time = _clock->nowMicros();
+    while (read_clock() != level) {
+        if (susiElapsed(start_time, _clock->nowMicros()) > SUSI_ANSWER_CLOCK_TIMEOUT_US) {
+            return false;
+        }
     }
+    return true;
 }
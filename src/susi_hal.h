@@ -3,6 +3,13 @@
 
 #include <Arduino.h>
 #include "susi_response.h"
+#include "susi_clock.h"
+
+/**
+ * @brief The longest wait for the start and the end of an ACK.
+ * @see RCN-600
+ */
+const uint32_t SUSI_ACK_TIMEOUT_US = 20000;
 
 /**
  * @brief This class provides a hardware abstraction layer for the SUSI protocol.
@@ -59,6 +66,13 @@ public:
      */
     virtual bool read_data();
 
+    /**
+     * @brief Read the clock pin.
+     * @details Used by the slave's clock interrupt to tell falling from rising edges.
+     * @return true if the pin is high, false otherwise.
+     */
+    virtual bool read_clock();
+
     /**
      * @brief Read a bit from the data pin.
      * @return true if the bit is 1, false otherwise.
@@ -67,9 +81,19 @@ public:
 
     /**
      * @brief Wait for an acknowledgement from the slave.
+     * @details Once the ACK has started, its end is awaited for up to
+     * SUSI_ACK_TIMEOUT_US from the start of the wait, whatever the timeout.
+     * @param timeout_us The longest wait for the ACK to start.
      * @return SusiMasterResult The result of the operation.
      */
-    virtual SusiMasterResult waitForAck();
+    virtual SusiMasterResult waitForAck(uint32_t timeout_us = SUSI_ACK_TIMEOUT_US);
+
+    /**
+     * @brief Gets the time the last ACK took to start.
+     * @return uint32_t The time from the start of waitForAck() to the start of
+     * the ACK pulse, in microseconds.
+     */
+    uint32_t ackLatency() const { return _ack_latency_us; }
 
     /**
      * @brief Send an acknowledgement to the master.
@@ -77,10 +101,42 @@ public:
     virtual void sendAck();
 
     /**
-     * @brief Send a byte to the master.
+     * @brief Send an acknowledgement to the master from an interrupt handler.
+     * @details Pulls the data line LOW and starts the timer of startAckTimer(),
+     * whose interrupt ends the pulse with finishAck(). Without a timer the
+     * handler busy-waits for the whole pulse, which holds off every other
+     * interrupt for 1 ms. The data line stays an output for the response that
+     * follows.
+     */
+    virtual void sendAckFromISR();
+
+    /**
+     * @brief Starts a one-shot timer whose interrupt calls finishAck().
+     * @details The base HAL has no timer. Override it with a hardware timer of
+     * the platform so that an ACK sent from an interrupt handler does not block.
+     * @param us The time until the timer fires, in microseconds.
+     * @return bool Whether the timer was started.
+     */
+    virtual bool startAckTimer(uint32_t us) { (void)us; return false; }
+
+    /**
+     * @brief Ends the ACK pulse started by sendAckFromISR(), if it is still running.
+     */
+    void finishAck();
+
+    /**
+     * @brief Release the data line after a response.
+     */
+    virtual void release_data();
+
+    /**
+     * @brief Send a byte to the master, clocked by the master.
+     * @details Each bit is put on the data line at a falling edge of the clock,
+     * while the master samples it, LSB first.
      * @param byte The byte to send.
+     * @return bool false if the master stopped clocking.
      */
-    virtual void sendByte(uint8_t byte);
+    virtual bool sendByte(uint8_t byte);
 
     /**
      * @brief Get the clock pin number.
@@ -88,9 +144,27 @@ public:
      */
     uint8_t get_clock_pin() const { return _clock_pin; }
 
+    /**
+     * @brief Sets the time base of the pulse widths, the ACK timing and the
+     * slave's packet timeouts.
+     * @param clock The clock, which must outlive the HAL.
+     */
+    void setClock(SusiClock& clock) { _clock = &clock; }
+
+    /**
+     * @brief Gets the time base of the HAL.
+     * @return SusiClock& The clock.
+     */
+    SusiClock& clock() const { return *_clock; }
+
 private:
+    bool waitForClock(bool level);
+
     uint8_t _clock_pin;
     uint8_t _data_pin;
+    SusiClock* _clock;
+    uint32_t _ack_latency_us;
+    volatile bool _ack_running; // An ACK of sendAckFromISR() waits for finishAck()
 };
 
 #endif // SUSI_HAL_H
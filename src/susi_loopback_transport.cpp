@@ -0,0 +1,60 @@
+#include "susi_loopback_transport.h"
+
+SusiLoopbackTransport::SusiLoopbackTransport(SusiPacketHandler handler, void* context) {
+    _handler = handler;
+    _context = context;
+    _head = 0;
+    _count = 0;
+}
+
+void SusiLoopbackTransport::begin() {
+    _head = 0;
+    _count = 0;
+}
+
+SusiMasterResult SusiLoopbackTransport::sendPacket(const SUSI_Packet& packet, bool expectAck) {
+    waitForSyncGap(packet);
+
+    SUSI_Packet received;
+    bool valid = susiDecodeFrame(susiEncodeFrame(packet), received);
+    packetSent();
+    if (!valid) {
+        return INVALID_ACK;
+    }
+
+    SusiMasterResult result = SUCCESS;
+    if (_handler != nullptr) {
+        result = _handler(received, expectAck, _context);
+    } else if (expectAck) {
+        result = TIMEOUT;
+    }
+
+    // The handler answers at once; a missing ACK costs the whole timeout.
+    _ack_latency_us = 0;
+    if (expectAck && result == TIMEOUT) {
+        _clock->delayMicros(_ack_timeout_us);
+    }
+    return result;
+}
+
+uint8_t SusiLoopbackTransport::readByte() {
+    busClocked();
+    if (_count == 0) {
+        return 0xFF;
+    }
+    uint8_t value = _buffer[_head];
+    _head = (_head + 1) % SUSI_LOOPBACK_BUFFER_SIZE;
+    _count--;
+    return value;
+}
+
+bool SusiLoopbackTransport::queueResponse(const uint8_t* data, uint8_t length) {
+    if (length > SUSI_LOOPBACK_BUFFER_SIZE - _count) {
+        return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        _buffer[(_head + _count) % SUSI_LOOPBACK_BUFFER_SIZE] = data[i];
+        _count++;
+    }
+    return true;
+}
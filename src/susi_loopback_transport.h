@@ -0,0 +1,83 @@
+#ifndef SUSI_LOOPBACK_TRANSPORT_H
+#define SUSI_LOOPBACK_TRANSPORT_H
+
+#include "susi_transport.h"
+
+/**
+ * @brief The number of response bytes a SusiLoopbackTransport can hold.
+ * @details Can be overridden at compile time.
+ */
+#ifndef SUSI_LOOPBACK_BUFFER_SIZE
+#define SUSI_LOOPBACK_BUFFER_SIZE 64
+#endif
+
+/**
+ * @brief A callback function that receives the packets sent over a loopback transport.
+ * @param packet The packet as decoded from its frame.
+ * @param expectAck Whether the master waits for an acknowledge.
+ * @param context The context pointer given to the transport.
+ * @return SusiMasterResult The result the master sees, SUCCESS for an acknowledged packet.
+ */
+typedef SusiMasterResult (*SusiPacketHandler)(const SUSI_Packet& packet, bool expectAck, void* context);
+
+/**
+ * @brief A transport that hands every packet to a handler in the same program.
+ * @details Packets go through the same frame encoding and decoding as on the
+ * wire, so the master's framing can be tested and benchmarked without pins.
+ * Responses of the simulated slave are queued with queueResponse().
+ *
+ * The sync gaps are kept on the transport's clock like on a real bus, so with
+ * a virtual clock set by setClock() the timing of the master can be tested.
+ * The packets themselves take no time: the handler acknowledges at once, so
+ * ackLatency() is 0, and a packet that times out waits out the ACK timeout.
+ */
+class SusiLoopbackTransport : public SusiTransport {
+public:
+    /**
+     * @brief Constructs a new SusiLoopbackTransport object.
+     * @param handler The callback that receives the packets, or nullptr.
+     * @param context A pointer that is passed to the handler.
+     */
+    SusiLoopbackTransport(SusiPacketHandler handler = nullptr, void* context = nullptr);
+
+    void begin() override;
+
+    /**
+     * @brief Waits for the sync gap, frames the packet and hands the decoded
+     * packet to the handler.
+     * @details Without a handler nobody acknowledges, so packets that expect an
+     * acknowledge time out.
+     */
+    SusiMasterResult sendPacket(const SUSI_Packet& packet, bool expectAck) override;
+
+    /**
+     * @brief Reads the next queued response byte.
+     * @return uint8_t The byte, or 0xFF (idle data line) if none is queued.
+     */
+    uint8_t readByte() override;
+
+    void clockPulse() override {}
+
+    /**
+     * @brief Queues bytes to be read by the master.
+     * @param data The bytes.
+     * @param length The number of bytes.
+     * @return bool Whether the bytes were queued, false if there is not enough room.
+     */
+    bool queueResponse(const uint8_t* data, uint8_t length);
+
+    /**
+     * @brief Gets the number of queued response bytes.
+     * @return uint8_t The number of bytes.
+     */
+    uint8_t pendingResponse() const { return _count; }
+
+private:
+    SusiPacketHandler _handler;
+    void* _context;
+    uint8_t _buffer[SUSI_LOOPBACK_BUFFER_SIZE];
+    uint8_t _head;
+    uint8_t _count;
+};
+
+#endif // SUSI_LOOPBACK_TRANSPORT_H
@@ -1,69 +1,21 @@
 #include "susi_master.h"
 #include "susi_commands.h"
 #include "susi_crc.h"
-
-// Timing constants from the SUSI specification
-const unsigned long SUSI_INTER_BYTE_TIMEOUT_MS = 7;
-const unsigned long SUSI_SYNC_GAP_MS = 9;
-const uint8_t SUSI_PACKETS_PER_SYNC = 20;
+#include "susi_binary_states.h"
 
 // SUSI_Master implementation
-SUSI_Master::SUSI_Master(SusiHAL& hal) : _hal(hal) {
-    _last_packet_time_ms = 0;
-    _packets_since_sync = 0;
+SUSI_Master::SUSI_Master(SusiHAL& hal) : _bit_bang(hal), _transport(_bit_bang) {
 }
 
-void SUSI_Master::begin() {
-    _hal.begin();
-    _hal.set_clock_high(); // Clock idle is HIGH
-    _hal.set_data_high();  // Data idle is HIGH
+SUSI_Master::SUSI_Master(SusiTransport& transport) : _transport(transport) {
 }
 
-#ifdef TESTING
-#include "mock_susi_hal.h"
-#endif
+void SUSI_Master::begin() {
+    _transport.begin();
+}
 
 SusiMasterResult SUSI_Master::sendPacket(const SUSI_Packet& packet, bool expectAck) {
-#ifdef TESTING
-    MockSusiHAL* mock_hal = dynamic_cast<MockSusiHAL*>(&_hal);
-    if (mock_hal) {
-        if (mock_hal->onSendPacket) {
-            mock_hal->onSendPacket(packet, expectAck);
-        }
-        if (mock_hal->afterSendPacket) {
-            mock_hal->afterSendPacket();
-        }
-        return mock_hal->ack_result;
-    }
-#endif
-    unsigned long current_time_ms = millis();
-    if (current_time_ms - _last_packet_time_ms > SUSI_INTER_BYTE_TIMEOUT_MS) {
-        delay(SUSI_SYNC_GAP_MS);
-    }
-
-    if (_packets_since_sync >= SUSI_PACKETS_PER_SYNC) {
-        delay(SUSI_SYNC_GAP_MS);
-        _packets_since_sync = 0;
-    }
-
-    _hal.set_data_low();
-    _hal.generate_clock_pulse();
-
-    sendByte(packet.address);
-    sendByte(packet.command);
-    sendByte(packet.data);
-
-    _hal.set_data_high();
-    _hal.generate_clock_pulse();
-
-    _last_packet_time_ms = millis();
-    _packets_since_sync++;
-
-    if (expectAck) {
-        return _hal.waitForAck();
-    }
-
-    return SUCCESS;
+    return _transport.sendPacket(packet, expectAck);
 }
 
 SusiMasterResult SUSI_Master_API::registerBiDiSlave(uint8_t address) {
@@ -72,53 +24,110 @@ SusiMasterResult SUSI_Master_API::registerBiDiSlave(uint8_t address) {
 
 void SUSI_Master_API::pollSlaves() {
     for (int i = 0; i < _bidi_slave_count; i++) {
+        if (_bidi_slaves[i].link.quarantined) {
+            if (_bidi_slaves[i].probe_countdown > 0) {
+                _bidi_slaves[i].probe_countdown--;
+                continue;
+            }
+            _bidi_slaves[i].probe_countdown = SUSI_LINK_PROBE_INTERVAL - 1;
+        }
+
         SUSI_Packet packet;
         packet.address = 0;
         packet.command = SUSI_CMD_BIDI_HOST_CALL;
         packet.data = _bidi_slaves[i].address;
 
         SusiMasterResult result = _master.sendPacket(packet, true);
+        recordLinkResult(_bidi_slaves[i].address, result);
         if (result == SUCCESS) {
+            // The slave sends its response on exactly 32 clocks.
             uint8_t data[4];
             for (int j = 0; j < 4; j++) {
-                data[j] = _master.readByteAfterRequest();
+                data[j] = _master.readByteFromSlave();
             }
             if (_bidi_callback != nullptr) {
                 _bidi_callback(_bidi_slaves[i].address, data);
             }
+            if (_bidi_event_callback != nullptr) {
+                for (int j = 0; j < 4; j += 2) {
+                    if (data[j] != SUSI_MSG_BIDI_EMPTY || data[j + 1] != 0) {
+                        _bidi_event_callback(_bidi_slaves[i].address, data[j], data[j + 1]);
+                    }
+                }
+            }
         }
     }
 }
 
-void SUSI_Master_API::onBidiResponse(BidiResponseCallback callback) {
-    _bidi_callback = callback;
+void SUSI_Master_API::recordLinkResult(uint8_t address, SusiMasterResult result) {
+    for (int i = 0; i < _bidi_slave_count; i++) {
+        if (_bidi_slaves[i].address != address) {
+            continue;
+        }
+        SusiLinkStats& link = _bidi_slaves[i].link;
+        if (result == SUCCESS) {
+            link.consecutive_errors = 0;
+            link.quarantined = false;
+            return;
+        }
+        if (result == TIMEOUT) {
+            link.timeouts++;
+        } else if (result == INVALID_ACK) {
+            link.invalid_acks++;
+        } else if (result == INVALID_CRC) {
+            link.crc_errors++;
+        }
+        if (link.consecutive_errors < 255) {
+            link.consecutive_errors++;
+        }
+        if (!link.quarantined && link.consecutive_errors >= SUSI_LINK_QUARANTINE_ERRORS) {
+            link.quarantined = true;
+            _bidi_slaves[i].probe_countdown = SUSI_LINK_PROBE_INTERVAL - 1;
+        }
+        return;
+    }
 }
 
-void SUSI_Master::sendByte(uint8_t byte) {
-    for (int i = 0; i < 8; i++) {
-        if ((byte >> i) & 0x01) {
-            _hal.set_data_high();
-        } else {
-            _hal.set_data_low();
+bool SUSI_Master_API::getLinkStats(uint8_t address, SusiLinkStats& stats) const {
+    for (int i = 0; i < _bidi_slave_count; i++) {
+        if (_bidi_slaves[i].address == address) {
+            stats = _bidi_slaves[i].link;
+            return true;
         }
-        _hal.generate_clock_pulse();
     }
+    return false;
+}
+
+void SUSI_Master_API::onBidiResponse(BidiResponseCallback callback) {
+    _bidi_callback = callback;
+}
+
+void SUSI_Master_API::onBidiEvent(BidiEventCallback callback) {
+    _bidi_event_callback = callback;
+}
+
+uint32_t SUSI_Master::syncGapRemaining(const SUSI_Packet& packet) const {
+    return _transport.syncGapRemaining(packet);
+}
+
+void SUSI_Master::onIdle(SusiIdleHook hook, void* context) {
+    _transport.onIdle(hook, context);
+}
+
+void SUSI_Master::setClock(SusiClock& clock) {
+    _transport.setClock(clock);
 }
 
-uint8_t SUSI_Master::readByteAfterRequest() {
-    uint8_t value = readByteFromSlave();
-    _hal.generate_clock_pulse();
-    return value;
+void SUSI_Master::setAckTimeout(uint32_t timeout_us) {
+    _transport.setAckTimeout(timeout_us);
+}
+
+uint32_t SUSI_Master::ackLatency() const {
+    return _transport.ackLatency();
 }
 
 uint8_t SUSI_Master::readByteFromSlave() {
-    uint8_t value = 0;
-    for (int i = 0; i < 8; i++) {
-        if (_hal.read_bit()) {
-            value |= (1 << i);
-        }
-    }
-    return value;
+    return _transport.readByte();
 }
 
 // SUSI_Master_API implementation
@@ -126,6 +135,7 @@ SUSI_Master_API::SUSI_Master_API(SUSI_Master& master) : _master(master) {
     _slave_count = 0;
     _bidi_slave_count = 0;
     _bidi_callback = nullptr;
+    _bidi_event_callback = nullptr;
 }
 
 void SUSI_Master_API::begin() {
@@ -138,12 +148,87 @@ void SUSI_Master_API::reset() {
 }
 
 bool SUSI_Master_API::getFunction(uint8_t address, uint8_t function) {
+    SUSI_Slave_State* state = findSlaveState(address, false);
+    return state != nullptr && ((state->functions >> function) & 1);
+}
+
+SUSI_Slave_State* SUSI_Master_API::findSlaveState(uint8_t address, bool create) {
     for (int i = 0; i < _slave_count; i++) {
         if (_slave_states[i].address == address) {
-            return (_slave_states[i].functions >> function) & 1;
+            return &_slave_states[i];
         }
     }
-    return false;
+    if (!create || _slave_count >= MAX_SLAVES) {
+        return nullptr;
+    }
+    SUSI_Slave_State* state = &_slave_states[_slave_count++];
+    state->address = address;
+    state->functions = 0;
+    state->outputs = 0;
+    state->outputs_sent = 0;
+    state->ack_latency_avg_us = 0;
+    state->ack_latency_max_us = 0;
+    state->ack_samples = 0;
+    return state;
+}
+
+// RCN-600 lets all modules of a decoder answer the CVs 897–899 and 1020–1024,
+// so one module's ACK latency says nothing about them.
+static bool isSharedCV(uint16_t cv) {
+    return (cv >= 897 && cv <= 899) || (cv >= 1020 && cv <= 1024);
+}
+
+SusiMasterResult SUSI_Master_API::sendWithAck(const SUSI_Packet& packet, bool full_timeout) {
+    SUSI_Slave_State* state = packet.address != 0 ? findSlaveState(packet.address, true) : nullptr;
+    if (state != nullptr && !full_timeout) {
+        _master.setAckTimeout(ackTimeout(*state));
+    }
+    SusiMasterResult result = _master.sendPacket(packet, true);
+    _master.setAckTimeout(SUSI_ACK_TIMEOUT_US);
+
+    if (result == SUCCESS && state != nullptr) {
+        uint32_t latency = _master.ackLatency();
+        uint16_t sample = latency > 0xFFFF ? 0xFFFF : latency;
+        if (state->ack_samples == 0) {
+            state->ack_latency_avg_us = sample;
+        } else {
+            state->ack_latency_avg_us += ((int32_t)sample - state->ack_latency_avg_us) / 8;
+        }
+        if (sample > state->ack_latency_max_us) {
+            state->ack_latency_max_us = sample;
+        }
+        if (state->ack_samples < 255) {
+            state->ack_samples++;
+        }
+    }
+    return result;
+}
+
+uint32_t SUSI_Master_API::ackTimeout(const SUSI_Slave_State& state) {
+    if (state.ack_samples < SUSI_ACK_LEARN_SAMPLES) {
+        return SUSI_ACK_TIMEOUT_US;
+    }
+    uint32_t latency = 2 * (uint32_t)state.ack_latency_avg_us;
+    if (state.ack_latency_max_us > latency) {
+        latency = state.ack_latency_max_us;
+    }
+    uint32_t timeout = latency + SUSI_ACK_TIMEOUT_MARGIN_US;
+    if (timeout < SUSI_ACK_TIMEOUT_MIN_US) {
+        return SUSI_ACK_TIMEOUT_MIN_US;
+    }
+    return timeout > SUSI_ACK_TIMEOUT_US ? SUSI_ACK_TIMEOUT_US : timeout;
+}
+
+bool SUSI_Master_API::getAckStats(uint8_t address, SusiAckStats& stats) {
+    SUSI_Slave_State* state = findSlaveState(address, false);
+    if (state == nullptr) {
+        return false;
+    }
+    stats.average_us = state->ack_latency_avg_us;
+    stats.max_us = state->ack_latency_max_us;
+    stats.samples = state->ack_samples;
+    stats.timeout_us = ackTimeout(*state);
+    return true;
 }
 
 SusiMasterResult SUSI_Master_API::setFunction(uint8_t address, uint8_t function, bool on) {
@@ -151,32 +236,16 @@ SusiMasterResult SUSI_Master_API::setFunction(uint8_t address, uint8_t function,
     packet.address = address;
     packet.command = SUSI_CMD_SET_FUNCTION;
     packet.data = (function & 0x1F) | (on ? 0x80 : 0x00);
-    SusiMasterResult result = _master.sendPacket(packet, true);
+    SusiMasterResult result = sendWithAck(packet);
 
     if (result != SUCCESS) {
         return result;
     }
 
-    // Find existing slave state
-    SUSI_Slave_State* state = nullptr;
-    for (int i = 0; i < _slave_count; i++) {
-        if (_slave_states[i].address == address) {
-            state = &_slave_states[i];
-            break;
-        }
-    }
-
-    // Or create a new one
+    SUSI_Slave_State* state = findSlaveState(address, true);
     if (state == nullptr) {
-        if (_slave_count < MAX_SLAVES) {
-            state = &_slave_states[_slave_count];
-            state->address = address;
-            state->functions = 0; // Initialize functions
-            _slave_count++;
-        } else {
-            // Cannot store state for new slave, but command was successful
-            return SUCCESS;
-        }
+        // Cannot store state for new slave, but command was successful
+        return SUCCESS;
     }
 
     // Update the state
@@ -189,12 +258,83 @@ SusiMasterResult SUSI_Master_API::setFunction(uint8_t address, uint8_t function,
     return SUCCESS;
 }
 
+SusiMasterResult SUSI_Master_API::setOutputs(uint8_t address, uint32_t outputs) {
+    // Without room for the state, every byte is sent each time
+    SUSI_Slave_State* state = findSlaveState(address, true);
+    for (uint8_t i = 0; i < SUSI_DIRECT_OUTPUT_BYTES; i++) {
+        uint8_t value = (outputs >> (8 * i)) & 0xFF;
+        if (state != nullptr && (state->outputs_sent & (1 << i)) &&
+            ((state->outputs >> (8 * i)) & 0xFF) == value) {
+            continue;
+        }
+
+        SUSI_Packet packet;
+        packet.address = address;
+        packet.command = SUSI_CMD_DIRECT_OUTPUTS + i;
+        packet.data = value;
+        SusiMasterResult result = sendWithAck(packet);
+        if (result != SUCCESS) {
+            return result;
+        }
+
+        if (state != nullptr) {
+            state->outputs = (state->outputs & ~(0xFFUL << (8 * i))) | ((uint32_t)value << (8 * i));
+            state->outputs_sent |= 1 << i;
+        }
+    }
+    return SUCCESS;
+}
+
+uint32_t SUSI_Master_API::getOutputs(uint8_t address) {
+    SUSI_Slave_State* state = findSlaveState(address, false);
+    return state != nullptr ? state->outputs : 0;
+}
+
+SusiMasterResult SUSI_Master_API::setBinaryState(uint8_t address, uint16_t number, bool on) {
+    if (number == 0 || number > SUSI_BINARY_STATE_MAX) {
+        return INVALID_ACK;
+    }
+
+    SUSI_Packet packet;
+    packet.address = address;
+    packet.data = (number & 0x7F) | (on ? 0x80 : 0x00);
+    if (number < 128) {
+        packet.command = SUSI_CMD_BINARY_STATE_SHORT;
+        return sendWithAck(packet);
+    }
+
+    packet.command = SUSI_CMD_BINARY_STATE_LONG_L;
+    SusiMasterResult result = sendWithAck(packet);
+    if (result != SUCCESS) {
+        return result;
+    }
+    packet.command = SUSI_CMD_BINARY_STATE_LONG_H;
+    packet.data = number >> 7;
+    return sendWithAck(packet);
+}
+
+SusiMasterResult SUSI_Master_API::setAllBinaryStates(uint8_t address, bool on) {
+    // Only the long form with state 0 reaches all states, the short form
+    // stops at 127.
+    SUSI_Packet packet;
+    packet.address = address;
+    packet.command = SUSI_CMD_BINARY_STATE_LONG_L;
+    packet.data = on ? 0x80 : 0x00;
+    SusiMasterResult result = sendWithAck(packet);
+    if (result != SUCCESS) {
+        return result;
+    }
+    packet.command = SUSI_CMD_BINARY_STATE_LONG_H;
+    packet.data = 0;
+    return sendWithAck(packet);
+}
+
 SusiMasterResult SUSI_Master_API::setSpeed(uint8_t address, uint8_t speed, bool forward) {
     SUSI_Packet packet;
     packet.address = address;
     packet.command = SUSI_CMD_SET_SPEED;
     packet.data = (speed & 0x7F) | (forward ? 0x80 : 0x00);
-    return _master.sendPacket(packet, true);
+    return sendWithAck(packet);
 }
 
 SusiMasterResult SUSI_Master_API::performHandshake() {
@@ -212,7 +352,7 @@ SusiMasterResult SUSI_Master_API::performHandshake() {
             // We read the 4-byte response to confirm.
             uint8_t response[4];
             for (int j = 0; j < 4; j++) {
-                response[j] = _master.readByteAfterRequest();
+                response[j] = _master.readByteFromSlave();
             }
 
             // A valid handshake response is two STATUS messages (usually 0x8A, 0x00).
@@ -233,7 +373,14 @@ SusiMasterResult SUSI_Master_API::_add_bidi_slave(uint8_t address) {
     }
 
     if (_bidi_slave_count < MAX_SLAVES) {
-        _bidi_slaves[_bidi_slave_count].address = address;
+        SUSI_Bidi_Slave& slave = _bidi_slaves[_bidi_slave_count];
+        slave.address = address;
+        slave.link.timeouts = 0;
+        slave.link.invalid_acks = 0;
+        slave.link.crc_errors = 0;
+        slave.link.consecutive_errors = 0;
+        slave.link.quarantined = false;
+        slave.probe_countdown = 0;
         _bidi_slave_count++;
         return SUCCESS;
     } else {
@@ -247,7 +394,7 @@ SusiMasterResult SUSI_Master_API::writeCV(uint8_t address, uint16_t cv, uint8_t
     packet1.address = address;
     packet1.command = SUSI_CMD_WRITE_CV;
     packet1.data = (cv_addr >> 8) & 0x03;
-    SusiMasterResult result = _master.sendPacket(packet1, true);
+    SusiMasterResult result = sendWithAck(packet1, isSharedCV(cv));
     if (result != SUCCESS) {
         return result;
     }
@@ -256,16 +403,30 @@ SusiMasterResult SUSI_Master_API::writeCV(uint8_t address, uint16_t cv, uint8_t
     packet2.address = address;
     packet2.command = cv_addr & 0xFF;
     packet2.data = value;
-    return _master.sendPacket(packet2, true);
+    return sendWithAck(packet2, isSharedCV(cv));
 }
 
 SusiMasterResult SUSI_Master_API::readCV(uint8_t address, uint16_t cv, uint8_t& value) {
+    // RCN-601: CVs from 769 on are read with one BiDi command
+    if (cv >= SUSI_BIDI_READ_CV_OFFSET) {
+        SUSI_Packet packet;
+        packet.address = address;
+        packet.command = SUSI_CMD_BIDI_READ_CV;
+        packet.data = cv - SUSI_BIDI_READ_CV_OFFSET;
+        SusiMasterResult result = sendWithAck(packet, isSharedCV(cv));
+        if (result != SUCCESS) {
+            value = 0;
+            return result;
+        }
+        return readCVResponse(value);
+    }
+
     uint16_t cv_addr = cv - 1;
     SUSI_Packet packet1;
     packet1.address = address;
     packet1.command = SUSI_CMD_READ_CV;
     packet1.data = (cv_addr >> 8) & 0x03;
-    SusiMasterResult result = _master.sendPacket(packet1, true);
+    SusiMasterResult result = sendWithAck(packet1, isSharedCV(cv));
     if (result != SUCCESS) {
         value = 0;
         return result;
@@ -275,17 +436,20 @@ SusiMasterResult SUSI_Master_API::readCV(uint8_t address, uint16_t cv, uint8_t&
     packet2.address = address;
     packet2.command = cv_addr & 0xFF;
     packet2.data = 0;
-    result = _master.sendPacket(packet2, true);
+    result = sendWithAck(packet2, isSharedCV(cv));
     if (result != SUCCESS) {
         value = 0;
         return result;
     }
+    return readCVResponse(value);
+}
 
-    uint8_t header1 = _master.readByteAfterRequest();
+SusiMasterResult SUSI_Master_API::readCVResponse(uint8_t& value) {
+    uint8_t header1 = _master.readByteFromSlave();
     if (header1 == SUSI_MSG_BIDI_CV_RESPONSE) {
-        value = _master.readByteAfterRequest();
-        _master.readByteAfterRequest(); // header2
-        _master.readByteAfterRequest(); // value2
+        value = _master.readByteFromSlave();
+        _master.readByteFromSlave(); // header2
+        _master.readByteFromSlave(); // value2
         return SUCCESS;
     } else {
         value = header1;
@@ -293,6 +457,65 @@ SusiMasterResult SUSI_Master_API::readCV(uint8_t address, uint16_t cv, uint8_t&
     }
 }
 
+SusiMasterResult SUSI_Master_API::verifyCV(uint8_t address, uint16_t cv, uint8_t value) {
+    if (cv < SUSI_CV_MANIPULATION_FIRST || cv > 1024) {
+        uint8_t current;
+        SusiMasterResult result = readCV(address, cv, current);
+        if (result != SUCCESS) {
+            return result;
+        }
+        return current == value ? SUCCESS : VERIFY_FAILED;
+    }
+
+    return sendCVManipulation(address, SUSI_CMD_VERIFY_CV_BYTE, cv, value);
+}
+
+SusiMasterResult SUSI_Master_API::writeCVIfDifferent(uint8_t address, uint16_t cv, uint8_t value) {
+    SusiMasterResult result = verifyCV(address, cv, value);
+    if (result != VERIFY_FAILED) {
+        return result;
+    }
+    return writeCV(address, cv, value);
+}
+
+SusiMasterResult SUSI_Master_API::setCVBit(uint8_t address, uint16_t cv, uint8_t bit, bool on) {
+    if (cv < SUSI_CV_MANIPULATION_FIRST || cv > 1024) {
+        uint8_t value;
+        SusiMasterResult result = readCV(address, cv, value);
+        if (result != SUCCESS) {
+            return result;
+        }
+        uint8_t changed = on ? value | (1 << bit) : value & ~(1 << bit);
+        return changed == value ? SUCCESS : writeCV(address, cv, changed);
+    }
+
+    // 111KDBBB: verify first (K = 0), write only on a mismatch (K = 1)
+    uint8_t data = 0xE0 | (on ? 0x08 : 0) | (bit & 0x07);
+    SusiMasterResult result = sendCVManipulation(address, SUSI_CMD_CV_BIT, cv, data);
+    if (result != VERIFY_FAILED) {
+        return result;
+    }
+    return sendCVManipulation(address, SUSI_CMD_CV_BIT, cv, data | 0x10);
+}
+
+SusiMasterResult SUSI_Master_API::sendCVManipulation(uint8_t address, uint8_t command, uint16_t cv,
+                                                     uint8_t data) {
+    // The 3-byte command of RCN-600 in two packets: the CV, then the value.
+    // A verification is only acknowledged on a match.
+    SUSI_Packet packet;
+    packet.address = address;
+    packet.command = command;
+    packet.data = 0x80 | (cv - SUSI_CV_MANIPULATION_FIRST);
+    SusiMasterResult result = sendWithAck(packet, isSharedCV(cv));
+    if (result != SUCCESS) {
+        return result;
+    }
+    packet.data = data;
+    result = sendWithAck(packet, isSharedCV(cv));
+    bool verifying = command == SUSI_CMD_VERIFY_CV_BYTE || (data & 0x10) == 0;
+    return result == TIMEOUT && verifying ? VERIFY_FAILED : result;
+}
+
 SusiMasterResult SUSI_Master_API::readCVBank(uint8_t address, uint8_t bank, uint8_t* data) {
     SUSI_Packet packet;
     packet.address = address;
@@ -313,24 +536,23 @@ SusiMasterResult SUSI_Master_API::readCVBank(uint8_t address, uint8_t bank, uint
 
     packet.data = 0;
 
-    SusiMasterResult result = _master.sendPacket(packet, true);
+    SusiMasterResult result = sendWithAck(packet);
     if (result != SUCCESS) {
+        recordLinkResult(address, result);
         return result;
     }
 
+    // The CRC-8 is folded in as the bytes arrive. Over the data and the CRC
+    // byte it is 0; a 0 byte follows to complete the last byte pair.
+    SusiCRC8 crc;
     for (int i = 0; i < 40; i++) {
-        data[i] = _master.readByteAfterRequest();
+        data[i] = _master.readByteFromSlave();
+        crc.update(data[i]);
     }
+    crc.update(_master.readByteFromSlave());
+    uint8_t padding = _master.readByteFromSlave();
 
-    uint16_t received_crc = 0;
-    received_crc |= (uint16_t)_master.readByteAfterRequest() << 8;
-    received_crc |= _master.readByteAfterRequest();
-
-    uint16_t calculated_crc = crc16_ccitt(data, 40);
-
-    if (received_crc != calculated_crc) {
-        return INVALID_CRC;
-    }
-
-    return SUCCESS;
+    result = crc.value() != 0 || padding != 0 ? INVALID_CRC : SUCCESS;
+    recordLinkResult(address, result);
+    return result;
 }
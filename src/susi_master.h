@@ -5,6 +5,8 @@
 #include "susi_hal.h"
 #include "susi_packet.h"
 #include "susi_response.h"
+#include "susi_transport.h"
+#include "susi_bitbang_transport.h"
 
 /**
  * @brief Represents a SUSI Master device.
@@ -15,11 +17,17 @@
 class SUSI_Master {
 public:
     /**
-     * @brief Constructs a new SUSI_Master object.
+     * @brief Constructs a new SUSI_Master object that bit-bangs the bus.
      * @param hal A reference to a SusiHAL object that provides the hardware abstraction.
      */
     SUSI_Master(SusiHAL& hal);
 
+    /**
+     * @brief Constructs a new SUSI_Master object on a packet-level transport.
+     * @param transport The transport that puts the packets onto the bus.
+     */
+    SUSI_Master(SusiTransport& transport);
+
     /**
      * @brief Initializes the SUSI master.
      */
@@ -34,23 +42,54 @@ public:
     SusiMasterResult sendPacket(const SUSI_Packet& packet, bool expectAck = false);
 
     /**
-     * @brief Reads a byte from the SUSI bus after sending a request.
-     * @return uint8_t The byte read from the bus.
+     * @brief Gets the time until a packet can be sent without waiting for a
+     * sync gap.
+     * @details Lets the application do other work and call sendPacket() once
+     * this returns 0, instead of waiting in sendPacket().
+     * @param packet The packet to send next.
+     * @return uint32_t The time in microseconds, 0 if it can be sent now.
+     * @see SusiTransport::syncGapRemaining()
+     */
+    uint32_t syncGapRemaining(const SUSI_Packet& packet) const;
+
+    /**
+     * @brief Sets a function that is called repeatedly while the master waits
+     * for a sync gap, instead of sleeping.
+     * @param hook The function, or nullptr to sleep.
+     * @param context A pointer that is passed to the hook.
+     */
+    void onIdle(SusiIdleHook hook, void* context = nullptr);
+
+    /**
+     * @brief Sets the time base of the master's bus timing.
+     * @details Sets the clock of the transport, and of its HAL.
+     * @param clock The clock, which must outlive the master.
+     * @see SusiClock
+     */
+    void setClock(SusiClock& clock);
+
+    /**
+     * @brief Sets how long the following packets wait for their ACK to start.
+     * @param timeout_us The timeout in microseconds, at most SUSI_ACK_TIMEOUT_US.
+     * @see SusiTransport::setAckTimeout()
      */
-    uint8_t readByteAfterRequest();
+    void setAckTimeout(uint32_t timeout_us);
 
     /**
-     * @brief Reads a byte from the SUSI bus, without generating a clock pulse.
+     * @brief Gets the time the last acknowledged packet waited for its ACK to start.
+     * @return uint32_t The time in microseconds.
+     */
+    uint32_t ackLatency() const;
+
+    /**
+     * @brief Reads a byte the slave sends after a request, on 8 clocks.
      * @return uint8_t The byte read from the bus.
      */
     uint8_t readByteFromSlave();
 
 private:
-    SusiHAL& _hal;
-    unsigned long _last_packet_time_ms;
-    uint8_t _packets_since_sync;
-
-    void sendByte(uint8_t byte);
+    SusiBitBangTransport _bit_bang;
+    SusiTransport& _transport;
 };
 
 /**
@@ -58,12 +97,65 @@ private:
  */
 const uint8_t MAX_SLAVES = 16;
 
+/**
+ * @brief The number of ACKs a module must have given before its ACK timeout
+ * is shortened.
+ */
+const uint8_t SUSI_ACK_LEARN_SAMPLES = 4;
+
+/**
+ * @brief The shortest ACK timeout learned for a module.
+ */
+const uint32_t SUSI_ACK_TIMEOUT_MIN_US = 2000;
+
+/**
+ * @brief The time added to the ACK latency of a module for its timeout.
+ */
+const uint32_t SUSI_ACK_TIMEOUT_MARGIN_US = 1000;
+
 /**
  * @brief Represents the state of a SUSI slave device.
  */
 struct SUSI_Slave_State {
     uint8_t address;
     uint32_t functions;
+    uint32_t outputs;
+    uint8_t outputs_sent; // Bit n: byte n of the outputs was sent
+    uint16_t ack_latency_avg_us; // Moving average of the ACK latency, weight 1/8
+    uint16_t ack_latency_max_us;
+    uint8_t ack_samples;
+};
+
+/**
+ * @brief The ACK latency a master has learned for a module.
+ */
+struct SusiAckStats {
+    uint16_t average_us; // Moving average of the time to the start of the ACK
+    uint16_t max_us;     // Longest time to the start of the ACK
+    uint8_t samples;     // ACKs measured, up to 255
+    uint32_t timeout_us; // ACK timeout of the module's commands
+};
+
+/**
+ * @brief The failed transfers in a row after which pollSlaves() only probes a
+ * bidirectional slave.
+ */
+const uint8_t SUSI_LINK_QUARANTINE_ERRORS = 3;
+
+/**
+ * @brief The pollSlaves() cycles from one probe of a quarantined slave to the next.
+ */
+const uint8_t SUSI_LINK_PROBE_INTERVAL = 16;
+
+/**
+ * @brief The health of the link to a bidirectional slave.
+ */
+struct SusiLinkStats {
+    uint16_t timeouts;          // Host calls and bank reads without an ACK
+    uint16_t invalid_acks;      // ACK pulses of a wrong length
+    uint16_t crc_errors;        // Bank reads with a wrong CRC
+    uint8_t consecutive_errors; // Failed transfers since the last good one
+    bool quarantined;           // Only polled every SUSI_LINK_PROBE_INTERVAL cycles
 };
 
 /**
@@ -72,6 +164,8 @@ struct SUSI_Slave_State {
  */
 struct SUSI_Bidi_Slave {
     uint8_t address;
+    SusiLinkStats link;
+    uint8_t probe_countdown; // Cycles until a quarantined slave is polled
 };
 
 /**
@@ -115,6 +209,47 @@ public:
      */
     bool getFunction(uint8_t address, uint8_t function);
 
+    /**
+     * @brief Sets all 32 direct outputs of a SUSI slave device.
+     * @details Uses the direct commands 0x40–0x43, 8 outputs per packet, and
+     * only sends the bytes that changed since the last call for the slave.
+     * @param address The address of the slave.
+     * @param outputs Bit n is the state of output n + 1.
+     * @return SusiMasterResult A result code indicating the status of the operation.
+     * @see RCN-600
+     */
+    SusiMasterResult setOutputs(uint8_t address, uint32_t outputs);
+
+    /**
+     * @brief Gets the direct outputs last sent to a SUSI slave device.
+     * @param address The address of the slave.
+     * @return uint32_t Bit n is the state of output n + 1.
+     */
+    uint32_t getOutputs(uint8_t address);
+
+    /**
+     * @brief Sets a binary state on a SUSI slave device.
+     * @details States 1–127 take one packet with the short form 0x6D, higher
+     * states two packets with the long form 0x6E/0x6F.
+     * @param address The address of the slave.
+     * @param number The state number (1–32767).
+     * @param on The state.
+     * @return SusiMasterResult A result code indicating the status of the operation.
+     * @see RCN-600
+     */
+    SusiMasterResult setBinaryState(uint8_t address, uint16_t number, bool on);
+
+    /**
+     * @brief Sets all binary states of a SUSI slave device at once.
+     * @details Sends the long form 0x6E/0x6F with state number 0; the short
+     * form with state 0 would only reach the states 1–127.
+     * @param address The address of the slave.
+     * @param on The state.
+     * @return SusiMasterResult A result code indicating the status of the operation.
+     * @see RCN-600
+     */
+    SusiMasterResult setAllBinaryStates(uint8_t address, bool on);
+
     /**
      * @brief Sets the speed of a SUSI slave device.
      * @param address The address of the slave.
@@ -137,6 +272,8 @@ public:
 
     /**
      * @brief Reads a value from a Configuration Variable (CV) on a SUSI slave device.
+     * @details CVs from 769 on, which include the SUSI range 897–1024, are read
+     * with the single BiDi command 0x0F (RCN-601); lower CVs take two packets.
      * @param address The address of the slave.
      * @param cv The CV to read from (1-1024).
      * @param value A reference to a byte to store the value in.
@@ -150,11 +287,66 @@ public:
      * @param address The address of the slave.
      * @param bank The CV bank to read (0-2).
      * @param data A pointer to a 40-byte array to store the data in.
-     * @return SusiMasterResult A result code indicating the status of the operation.
+     * @return SusiMasterResult A result code indicating the status of the operation,
+     * INVALID_CRC if the RCN-218 CRC-8 after the data does not match.
      * @see RCN-601
      */
     SusiMasterResult readCVBank(uint8_t address, uint8_t bank, uint8_t* data);
 
+    /**
+     * @brief Checks whether a CV on a SUSI slave device holds a value.
+     * @details CVs 897–1024 are checked with the verify command 0x77, which the
+     * slave only acknowledges on a match, so a mismatch costs the ACK timeout.
+     * Other CVs are read.
+     * @param address The address of the slave.
+     * @param cv The CV to check (1-1024).
+     * @param value The expected value.
+     * @return SusiMasterResult SUCCESS if the CV holds the value, VERIFY_FAILED if
+     * not, or the error of the transfer.
+     * @see RCN-600
+     */
+    SusiMasterResult verifyCV(uint8_t address, uint16_t cv, uint8_t value);
+
+    /**
+     * @brief Writes a CV unless it already holds the value.
+     * @details Verifies the CV first, which saves the write and the slave's
+     * EEPROM wear when a whole configuration is applied again.
+     * @param address The address of the slave.
+     * @param cv The CV to write to (1-1024).
+     * @param value The value to write (0-255).
+     * @return SusiMasterResult A result code indicating the status of the operation.
+     * @see RCN-600
+     */
+    SusiMasterResult writeCVIfDifferent(uint8_t address, uint16_t cv, uint8_t value);
+
+    /**
+     * @brief Sets or clears one bit of a CV unless it already has that state.
+     * @details CVs 897–1024 use the bit verify and bit write of command 0x7B,
+     * without reading the CV. Other CVs are read and written as a whole byte.
+     * @param address The address of the slave.
+     * @param cv The CV (1-1024).
+     * @param bit The bit number (0-7).
+     * @param on The state of the bit.
+     * @return SusiMasterResult A result code indicating the status of the operation.
+     * @see RCN-600
+     */
+    SusiMasterResult setCVBit(uint8_t address, uint16_t cv, uint8_t bit, bool on);
+
+    /**
+     * @brief Gets the ACK latency learned for a SUSI slave device.
+     * @details Every acknowledged command measures the time until the ACK
+     * starts. Once a module has given SUSI_ACK_LEARN_SAMPLES ACKs, its commands
+     * wait twice the average or the longest latency, whichever is longer, plus
+     * SUSI_ACK_TIMEOUT_MARGIN_US, but at least SUSI_ACK_TIMEOUT_MIN_US, instead
+     * of the full SUSI_ACK_TIMEOUT_US. A module that stops answering then costs
+     * far less bus time per command. The CVs 897–899 and 1020–1024, which all
+     * modules of a decoder share, and broadcasts always get the full timeout.
+     * @param address The address of the slave.
+     * @param stats Receives the statistics.
+     * @return bool false if nothing was sent to the slave yet.
+     */
+    bool getAckStats(uint8_t address, SusiAckStats& stats);
+
     /**
      * @brief Performs the handshake to detect and register bidirectional slaves.
      * @return SusiMasterResult A result code indicating the status of the operation.
@@ -164,10 +356,23 @@ public:
 
     /**
      * @brief Polls all registered bidirectional slaves.
+     * @details A slave whose host calls and bank reads fail
+     * SUSI_LINK_QUARANTINE_ERRORS times in a row is quarantined: it is only
+     * polled every SUSI_LINK_PROBE_INTERVAL calls, so that a module that went
+     * away does not cost an ACK timeout in every cycle. It is polled in every
+     * cycle again as soon as it answers.
      * @see RCN-601
      */
     void pollSlaves();
 
+    /**
+     * @brief Gets the health of the link to a bidirectional slave.
+     * @param address The address of the slave.
+     * @param stats Receives the error counters and the quarantine state.
+     * @return bool false if the slave is not registered.
+     */
+    bool getLinkStats(uint8_t address, SusiLinkStats& stats) const;
+
     /**
      * @brief A callback function that is called when a bidirectional response is received.
      * @param address The address of the slave that sent the response.
@@ -175,6 +380,14 @@ public:
      */
     typedef void (*BidiResponseCallback)(uint8_t address, uint8_t* data);
 
+    /**
+     * @brief A callback function that is called for each 2-byte message of a bidirectional response.
+     * @param address The address of the slave that sent the message.
+     * @param header The message header.
+     * @param data The message data.
+     */
+    typedef void (*BidiEventCallback)(uint8_t address, uint8_t header, uint8_t data);
+
     /**
      * @brief Registers a bidirectional slave.
      * @param address The address of the slave.
@@ -189,6 +402,15 @@ public:
      */
     void onBidiResponse(BidiResponseCallback callback);
 
+    /**
+     * @brief Sets the callback function for bidirectional events.
+     * @details Each 4-byte response holds two independent messages. The callback
+     * is called once for each half that is not an empty message.
+     * @param callback The callback function.
+     * @see RCN-601
+     */
+    void onBidiEvent(BidiEventCallback callback);
+
 #ifdef TESTING
     /**
      * @brief Gets the number of registered bidirectional slaves.
@@ -199,6 +421,12 @@ public:
 
 private:
     SusiMasterResult _add_bidi_slave(uint8_t address);
+    void recordLinkResult(uint8_t address, SusiMasterResult result);
+    SUSI_Slave_State* findSlaveState(uint8_t address, bool create);
+    SusiMasterResult sendWithAck(const SUSI_Packet& packet, bool full_timeout = false);
+    static uint32_t ackTimeout(const SUSI_Slave_State& state);
+    SusiMasterResult readCVResponse(uint8_t& value);
+    SusiMasterResult sendCVManipulation(uint8_t address, uint8_t command, uint16_t cv, uint8_t data);
 
     SUSI_Master& _master;
     SUSI_Slave_State _slave_states[MAX_SLAVES];
@@ -206,6 +434,7 @@ private:
     SUSI_Bidi_Slave _bidi_slaves[MAX_SLAVES];
     uint8_t _bidi_slave_count;
     BidiResponseCallback _bidi_callback;
+    BidiEventCallback _bidi_event_callback;
 };
 
 #endif // SUSI_MASTER_H
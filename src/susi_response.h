@@ -28,7 +28,11 @@ enum SusiMasterResult {
     /**
      * @brief An invalid CRC was received.
      */
-    INVALID_CRC
+    INVALID_CRC,
+    /**
+     * @brief The slave did not confirm the value that was verified.
+     */
+    VERIFY_FAILED
 };
 
 #endif // SUSI_RESPONSE_H
\ No newline at end of file
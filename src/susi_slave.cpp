@@ -1,85 +1,157 @@
 #include "susi_slave.h"
 #include "susi_commands.h"
 #include "susi_crc.h"
-#include <EEPROM.h>
-
-// --- EEPROM Layout ---
-// This defines the structure of the data stored in the EEPROM to ensure that
-// the CVs (Configuration Variables) are persistent across device restarts.
-//
-// Address | Size | Description
-//---------|------|-----------------------------------------------------------
-// 0       | 1    | EEPROM_MAGIC_BYTE: A fixed value (0x55) to check if the
-//         |      | EEPROM has been initialized by this library.
-// 1       | 1    | CV Count: The number of CVs currently stored.
-// 2...    | 3/CV | Start of CV data. Each entry consists of:
-//         |      | - 2 bytes: CV address/key (uint16_t)
-//         |      | - 1 byte:  CV value (uint8_t)
-//----------------------------------------------------------------------------
-const uint8_t EEPROM_MAGIC_BYTE = 0x55;
-const int EEPROM_ADDR_MAGIC = 0;
-const int EEPROM_ADDR_CV_COUNT = 1;
-const int EEPROM_ADDR_CV_DATA_START = 2;
-
-
-SUSI_Slave* _susi_slave_instance = nullptr;
-
-SUSI_Slave::SUSI_Slave(SusiHAL& hal) : _hal(hal) {
+
+#if SUSI_MAX_SLAVE_INSTANCES < 1 || SUSI_MAX_SLAVE_INSTANCES > 4
+#error "SUSI_MAX_SLAVE_INSTANCES must be between 1 and 4"
+#endif
+
+// RCN600-S1: a packet that stalls for longer is dropped.
+const uint32_t SUSI_BIT_TIMEOUT_US = 8000;
+
+SUSI_Slave* SUSI_Slave::_instances[SUSI_MAX_SLAVE_INSTANCES] = {};
+uint8_t SUSI_Slave::_instance_pins[SUSI_MAX_SLAVE_INSTANCES] = {};
+
+// Arduino ISRs take no argument, so every slot gets its own trampoline.
+void (* const SUSI_Slave::_clock_isrs[SUSI_MAX_SLAVE_INSTANCES])() = {
+    &SUSI_Slave::onClockChange<0>,
+#if SUSI_MAX_SLAVE_INSTANCES > 1
+    &SUSI_Slave::onClockChange<1>,
+#endif
+#if SUSI_MAX_SLAVE_INSTANCES > 2
+    &SUSI_Slave::onClockChange<2>,
+#endif
+#if SUSI_MAX_SLAVE_INSTANCES > 3
+    &SUSI_Slave::onClockChange<3>,
+#endif
+};
+
+SUSI_Slave::SUSI_Slave(SusiHAL& hal) : _hal(hal), _cv_log(_cv_table, _cv_defaults) {
+    for (int i = 0; i < SUSI_SLAVE_MAX_ADDRESSES; i++) {
+        _addresses[i] = 0;
+    }
+    _address_count = 1;
     _packetReady = false;
     _bitCount = 0;
     _last_bit_time_us = 0;
-    _buffer[0] = 0;
-    _buffer[1] = 0;
-    _buffer[2] = 0;
+    for (int i = 0; i < 3; i++) {
+        _buffer[i] = 0;
+        _rx_buffer[i] = 0;
+    }
     _speed = 0;
     _forward = false;
     _functions = 0;
+    _outputs = 0;
+    _binary_state_low = 0;
+    _binary_state_pending = false;
     _cv_bank = 0;
     _cv_bank_select = 0;
-    _cv_count = 0;
     _cv_address = 0;
-    _cv_read_mode = false;
+    _cv_op_command = 0;
     _cv_op_in_progress = false;
     _bidirectional_mode = false;
-    _bidi_data_available = false;
     _status_bits = 0;
     _function_callback = nullptr;
-    _manufacturer_id = 0;
-    _hardware_id = 0;
-    _version_number = 0;
+    _output_callback = nullptr;
+    _binary_state_callback = nullptr;
     for (int i = 0; i < 4; i++) {
-        _bidi_response_buffer[i] = 0;
+        _id_cvs_bank_0[i] = 0;
+        _id_cvs_bank_1[i] = 0;
+    }
+#ifdef TESTING
+    _cv_lookups = 0;
+#endif
+
+    // Special CVs, bound at their keys on the bus (the CV number minus 1) like
+    // all slave CVs. Manufacturer and hardware ID are mirrored at 940 and 980;
+    // the version number is only available at 902 in bank 0.
+    _cv_registry.bindMemory(CV_SUSI_MODULE_NUM - 1, 1, &_addresses[0], false);
+    _cv_registry.bindMemory(CV_MANUFACTURER_ID - 1, 4, _id_cvs_bank_0, false, 0);
+    _cv_registry.bindMemory(CV_MANUFACTURER_ID - 1, 4, _id_cvs_bank_1, false, 1);
+    _cv_registry.bindMemory(CV_MANUFACTURER_ID_BANK_1 - 1, 2, _id_cvs_bank_0, false, 0);
+    _cv_registry.bindMemory(CV_MANUFACTURER_ID_BANK_1 - 1, 2, _id_cvs_bank_1, false, 1);
+    _cv_registry.bindMemory(CV_MANUFACTURER_ID_BANK_2 - 1, 2, _id_cvs_bank_0, false, 0);
+    _cv_registry.bindMemory(CV_MANUFACTURER_ID_BANK_2 - 1, 2, _id_cvs_bank_1, false, 1);
+    _cv_registry.bindMemory(CV_STATUS_BITS - 1, 1, &_status_bits, false);
+    _cv_registry.bindMemory(CV_SUSI_CV_BANKING - 1, 1, &_cv_bank_select, true);
+    for (uint8_t bank = 0; bank < SUSI_CV_BANK_COUNT; bank++) {
+        _cv_bank_bound[bank] = 0;
     }
+    rebuildCVBanks();
+    _bidi_tx_active = false;
+    _bidi_tx_bit = 0;
+    _skip_clocks = 0;
+    _foreign_cv_address = 0;
+    _foreign_cv_read = false;
+    _answering = false;
+    prepareBidiFrame();
 }
 
-void SUSI_Slave::begin(uint8_t address) {
-    _address = address;
-    _susi_slave_instance = this;
+SUSI_Slave::~SUSI_Slave() {
+    for (int i = 0; i < SUSI_MAX_SLAVE_INSTANCES; i++) {
+        if (_instances[i] == this) {
+            detachInterrupt(digitalPinToInterrupt(_instance_pins[i]));
+            _instances[i] = nullptr;
+        }
+    }
+}
+
+bool SUSI_Slave::begin(uint8_t address) {
+    _addresses[0] = address;
     _hal.begin();
 
-    // Check if the EEPROM has been initialized with our data structure.
-    if (EEPROM.read(EEPROM_ADDR_MAGIC) == EEPROM_MAGIC_BYTE) {
-        // EEPROM is initialized, load CVs.
-        _cv_count = EEPROM.read(EEPROM_ADDR_CV_COUNT);
-        if (_cv_count > MAX_CVS) {
-            _cv_count = 0; // Data corruption, reset CVs.
-        }
+    // Rebuild the RAM CV index from the EEPROM log.
+    _cv_log.begin();
+    rebuildCVBanks();
 
-        int address = EEPROM_ADDR_CV_DATA_START;
-        for (int i = 0; i < _cv_count; i++) {
-            EEPROM.get(address, _cv_keys[i]);
-            address += sizeof(uint16_t);
-            _cv_values[i] = EEPROM.read(address);
-            address += sizeof(uint8_t);
+    // Reuse the slot of this slave or of its clock pin, else take a free one.
+    uint8_t pin = _hal.get_clock_pin();
+    int slot = -1;
+    for (int i = 0; i < SUSI_MAX_SLAVE_INSTANCES && slot < 0; i++) {
+        if (_instances[i] == this || (_instances[i] != nullptr && _instance_pins[i] == pin)) {
+            slot = i;
         }
-    } else {
-        // EEPROM is not initialized. Write the magic byte and set CV count to 0.
-        EEPROM.write(EEPROM_ADDR_MAGIC, EEPROM_MAGIC_BYTE);
-        EEPROM.write(EEPROM_ADDR_CV_COUNT, 0);
-        _cv_count = 0;
     }
+    for (int i = 0; i < SUSI_MAX_SLAVE_INSTANCES && slot < 0; i++) {
+        if (_instances[i] == nullptr) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return false;
+    }
+
+    noInterrupts();
+    _instances[slot] = this;
+    _instance_pins[slot] = pin;
+    interrupts();
+    attachInterrupt(digitalPinToInterrupt(pin), _clock_isrs[slot], CHANGE);
+    return true;
+}
+
+bool SUSI_Slave::addAddress(uint8_t address) {
+    if (address == 0) {
+        return false;
+    }
+    if (hasAddress(address)) {
+        return true;
+    }
+    if (_address_count >= SUSI_SLAVE_MAX_ADDRESSES) {
+        return false;
+    }
+    // The ISR only reads entries below the count, so the entry is set first.
+    _addresses[_address_count] = address;
+    _address_count++;
+    return true;
+}
 
-    attachInterrupt(digitalPinToInterrupt(_hal.get_clock_pin()), onClockFall, FALLING);
+bool SUSI_Slave::hasAddress(uint8_t address) const {
+    for (uint8_t i = 0; i < _address_count; i++) {
+        if (_addresses[i] == address) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void SUSI_Slave::enableBidirectionalMode() {
@@ -90,42 +162,47 @@ void SUSI_Slave::onFunctionChange(FunctionCallback callback) {
     _function_callback = callback;
 }
 
+void SUSI_Slave::onOutputsChange(OutputCallback callback) {
+    _output_callback = callback;
+}
+
+void SUSI_Slave::onBinaryStateChange(BinaryStateCallback callback) {
+    _binary_state_callback = callback;
+}
+
 void SUSI_Slave::queueBidirectionalData(const uint8_t* data) {
     if (data != nullptr) {
-        for (int i = 0; i < 4; i++) {
-            _bidi_response_buffer[i] = data[i];
+        if (data[2] == SUSI_MSG_BIDI_EMPTY) {
+            queueBidiMessage(data[0], data[1], SUSI_BIDI_PRIORITY_NORMAL);
+        } else {
+            queueBidiPair(data[0], data[1], data[2], data[3], SUSI_BIDI_PRIORITY_NORMAL);
         }
-        _bidi_data_available = true;
     }
 }
 
+void SUSI_Slave::getBidiQueueStats(SusiBidiQueueStats& stats) const {
+    _bidi_queue.getStats(stats);
+}
+
 void SUSI_Slave::sendPositionResponse(uint16_t address) {
-    uint8_t data[4];
-    data[0] = SUSI_MSG_BIDI_POSITION_HIGH;
-    data[1] = (address >> 8) & 0xFF;
-    data[2] = SUSI_MSG_BIDI_POSITION_LOW;
-    data[3] = address & 0xFF;
-    queueBidirectionalData(data);
+    queueBidiPair(SUSI_MSG_BIDI_POSITION_HIGH, (address >> 8) & 0xFF,
+                  SUSI_MSG_BIDI_POSITION_LOW, address & 0xFF, SUSI_BIDI_PRIORITY_URGENT);
 }
 
 void SUSI_Slave::sendSignalState(uint8_t state) {
-    uint8_t data[4] = {SUSI_MSG_BIDI_SIGNAL_STATE, state, SUSI_MSG_BIDI_EMPTY, 0};
-    queueBidirectionalData(data);
+    queueBidiMessage(SUSI_MSG_BIDI_SIGNAL_STATE, state, SUSI_BIDI_PRIORITY_NORMAL);
 }
 
 void SUSI_Slave::sendDirectFunction(uint8_t function, uint8_t action) {
-    uint8_t data[4] = {SUSI_MSG_BIDI_DIRECT_FUNCTION, (uint8_t)(function | action), SUSI_MSG_BIDI_EMPTY, 0};
-    queueBidirectionalData(data);
+    queueBidiMessage(SUSI_MSG_BIDI_DIRECT_FUNCTION, function | action, SUSI_BIDI_PRIORITY_NORMAL);
 }
 
 void SUSI_Slave::sendDCCFunction(uint8_t function, uint8_t action) {
-    uint8_t data[4] = {SUSI_MSG_BIDI_FUNCTION_VALUE_DCC, (uint8_t)(function | action), SUSI_MSG_BIDI_EMPTY, 0};
-    queueBidirectionalData(data);
+    queueBidiMessage(SUSI_MSG_BIDI_FUNCTION_VALUE_DCC, function | action, SUSI_BIDI_PRIORITY_NORMAL);
 }
 
 void SUSI_Slave::sendShortBinaryState(uint8_t state) {
-    uint8_t data[4] = {SUSI_MSG_BIDI_SHORT_BINARY_STATES, state, SUSI_MSG_BIDI_EMPTY, 0};
-    queueBidirectionalData(data);
+    queueBidiMessage(SUSI_MSG_BIDI_SHORT_BINARY_STATES, state, SUSI_BIDI_PRIORITY_NORMAL);
 }
 
 void SUSI_Slave::sendAutoSpeed(uint8_t speed, bool forward) {
@@ -133,55 +210,173 @@ void SUSI_Slave::sendAutoSpeed(uint8_t speed, bool forward) {
     if (forward) {
         data_byte |= 0x80;
     }
-    uint8_t data[4] = {SUSI_MSG_BIDI_AUTO_SPEED, data_byte, SUSI_MSG_BIDI_EMPTY, 0};
-    queueBidirectionalData(data);
+    queueBidiMessage(SUSI_MSG_BIDI_AUTO_SPEED, data_byte, SUSI_BIDI_PRIORITY_NORMAL);
 }
 
 void SUSI_Slave::sendAutoOperation(uint8_t operation) {
-    uint8_t data[4] = {SUSI_MSG_BIDI_AUTO_OPERATION, operation, SUSI_MSG_BIDI_EMPTY, 0};
-    queueBidirectionalData(data);
+    queueBidiMessage(SUSI_MSG_BIDI_AUTO_OPERATION, operation, SUSI_BIDI_PRIORITY_NORMAL);
 }
 
 void SUSI_Slave::sendAnalogValue(uint8_t channel, uint8_t value) {
     uint8_t header = (channel < 2) ? SUSI_MSG_BIDI_ANALOG_A : SUSI_MSG_BIDI_ANALOG_B;
-    uint8_t data[4] = {header, value, SUSI_MSG_BIDI_EMPTY, 0};
-    queueBidirectionalData(data);
+    queueBidiMessage(header, value, SUSI_BIDI_PRIORITY_ANALOG);
 }
 
 void SUSI_Slave::sendError(uint8_t error) {
-    uint8_t data[4] = {SUSI_MSG_BIDI_ERROR, error, SUSI_MSG_BIDI_EMPTY, 0};
-    queueBidirectionalData(data);
+    queueBidiMessage(SUSI_MSG_BIDI_ERROR, error, SUSI_BIDI_PRIORITY_URGENT);
+}
+
+void SUSI_Slave::queueBidiMessage(uint8_t header, uint8_t data, uint8_t priority) {
+    // The clock ISR may take the precomputed frame at any time.
+    noInterrupts();
+    if (priority == SUSI_BIDI_PRIORITY_ANALOG) {
+        _bidi_queue.pushAnalog(header, data);
+    } else {
+        _bidi_queue.push(header, data, priority);
+    }
+    prepareBidiFrame();
+    interrupts();
+}
+
+void SUSI_Slave::queueBidiPair(uint8_t header1, uint8_t data1, uint8_t header2, uint8_t data2, uint8_t priority) {
+    noInterrupts();
+    _bidi_queue.pushPair(header1, data1, header2, data2, priority);
+    prepareBidiFrame();
+    interrupts();
+}
+
+void SUSI_Slave::prepareBidiFrame() {
+    if (_bidi_queue.peekResponse(_bidi_frame)) {
+        _bidi_frame_source = BIDI_FRAME_QUEUE;
+    } else if (_status_bits != 0) {
+        _bidi_frame[0] = SUSI_MSG_BIDI_STATUS;
+        _bidi_frame[1] = _status_bits;
+        _bidi_frame[2] = SUSI_MSG_BIDI_STATUS;
+        _bidi_frame[3] = _status_bits;
+        _bidi_frame_source = BIDI_FRAME_STATUS;
+    } else {
+        // Send EMPTY message if no data is queued
+        _bidi_frame[0] = SUSI_MSG_BIDI_EMPTY;
+        _bidi_frame[1] = 0;
+        _bidi_frame[2] = SUSI_MSG_BIDI_EMPTY;
+        _bidi_frame[3] = 0;
+        _bidi_frame_source = BIDI_FRAME_EMPTY;
+    }
+}
+
+void SUSI_Slave::takeBidiFrame(bool handshake, uint8_t* frame) {
+    if (handshake) {
+        // Respond with status messages as per RCN-601
+        _bidirectional_mode = true; // Enable BiDi on handshake
+        frame[0] = SUSI_MSG_BIDI_STATUS;
+        frame[1] = 0;
+        frame[2] = SUSI_MSG_BIDI_STATUS;
+        frame[3] = 0;
+        return;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        frame[i] = _bidi_frame[i];
+    }
+    if (_bidi_frame_source == BIDI_FRAME_QUEUE) {
+        uint8_t sent[4];
+        _bidi_queue.popResponse(sent);
+    } else if (_bidi_frame_source == BIDI_FRAME_STATUS) {
+        _status_bits = 0; // Reset after sending
+    }
+    prepareBidiFrame();
 }
 
 void SUSI_Slave::_send_bidi_response(uint8_t header1, uint8_t data1, uint8_t header2, uint8_t data2) {
-    _hal.sendByte(header1);
-    _hal.sendByte(data1);
-    _hal.sendByte(header2);
-    _hal.sendByte(data2);
+    uint8_t frame[4] = {header1, data1, header2, data2};
+    beginAnswer();
+    sendAnswerBytes(frame, 4);
+    endAnswer();
+}
+
+void SUSI_Slave::beginAnswer() {
+    // The master clocks the answer while the main loop puts it on the line, so
+    // the clock interrupt must not decode these clocks as a packet.
+    _answering = true;
+}
+
+bool SUSI_Slave::sendAnswerBytes(const uint8_t* data, uint8_t length) {
+    for (uint8_t i = 0; i < length; i++) {
+        if (!_hal.sendByte(data[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SUSI_Slave::endAnswer() {
+    _hal.release_data();
+    noInterrupts();
+    _bitCount = 0;
+    _answering = false;
+    interrupts();
 }
 
 bool SUSI_Slave::available() {
+    if (!_packetReady) {
+        // The bus is idle, commit at most one deferred EEPROM byte.
+        _cv_log.step();
+    }
     return _packetReady;
 }
 
+void SUSI_Slave::flushCVs() {
+    _cv_log.flush();
+}
+
+uint16_t SUSI_Slave::pendingCVWrites() const {
+    return _cv_log.pending();
+}
+
+void SUSI_Slave::getCVStorageStats(SusiCVLogStats& stats) const {
+    _cv_log.getStats(stats);
+}
+
+bool SUSI_Slave::setCVDefaults(const SusiCVDefault* defaults, uint16_t count) {
+    if (!_cv_defaults.set(defaults, count)) {
+        return false;
+    }
+    rebuildCVBanks();
+    return true;
+}
+
+void SUSI_Slave::resetCVs() {
+    _cv_log.reset();
+    rebuildCVBanks();
+}
+
 void SUSI_Slave::setManufacturerID(uint16_t id) {
-    _manufacturer_id = id;
+    _id_cvs_bank_0[0] = (id >> 8) & 0xFF;
+    _id_cvs_bank_0[1] = id & 0xFF;
 }
 
 void SUSI_Slave::setHardwareID(uint16_t id) {
-    _hardware_id = id;
+    _id_cvs_bank_1[0] = (id >> 8) & 0xFF;
+    _id_cvs_bank_1[1] = id & 0xFF;
 }
 
 void SUSI_Slave::setVersionNumber(uint16_t version) {
-    _version_number = version;
+    _id_cvs_bank_0[2] = (version >> 8) & 0xFF;
+    _id_cvs_bank_0[3] = version & 0xFF;
 }
 
 void SUSI_Slave::setStatusBits(uint8_t bits) {
+    noInterrupts();
     _status_bits |= bits;
+    prepareBidiFrame();
+    interrupts();
 }
 
 void SUSI_Slave::clearStatusBits(uint8_t bits) {
+    noInterrupts();
     _status_bits &= ~bits;
+    prepareBidiFrame();
+    interrupts();
 }
 
 SUSI_Packet SUSI_Slave::read() {
@@ -197,23 +392,34 @@ SUSI_Packet SUSI_Slave::read() {
         _packetReady = false;
         interrupts();
 
+        // The two packets of a long-form binary state must follow each other
+        if (packet.command != SUSI_CMD_BINARY_STATE_LONG_H) {
+            _binary_state_pending = false;
+        }
+
+        if (_cv_op_in_progress && hasAddress(packet.address)) {
+            // The second packet of a CV operation carries the low address byte in
+            // its command field, which may collide with a real command code.
+            handleCVOperation(packet);
+            return packet;
+        }
+
         switch (packet.command) {
             case SUSI_CMD_READ_CV_BANK_0:
             case SUSI_CMD_READ_CV_BANK_1:
             case SUSI_CMD_READ_CV_BANK_2:
                 {
-                    _hal.sendAck();
                     uint8_t bank = packet.command - SUSI_CMD_READ_CV_BANK_0;
-                    uint8_t bank_data[40];
-                    getCVBank(bank, bank_data);
+                    refreshCVBank(bank);
+                    _hal.sendAck();
+                    // RCN-601: the CRC-8 and a 0 byte, to keep the byte pairs of BiDi
+                    uint8_t crc_bytes[2] = {_cv_bank_crcs[bank], 0};
 
-                    for (int i = 0; i < 40; i++) {
-                        _hal.sendByte(bank_data[i]);
+                    beginAnswer();
+                    if (sendAnswerBytes(_cv_bank_images[bank], SUSI_CV_BANK_SIZE)) {
+                        sendAnswerBytes(crc_bytes, 2);
                     }
-
-                    uint16_t crc = crc16_ccitt(bank_data, 40);
-                    _hal.sendByte((crc >> 8) & 0xFF);
-                    _hal.sendByte(crc & 0xFF);
+                    endAnswer();
                 }
                 break;
             case SUSI_CMD_SET_SPEED:
@@ -236,173 +442,358 @@ SUSI_Packet SUSI_Slave::read() {
                     _hal.sendAck();
                 }
                 break;
+            case SUSI_CMD_DIRECT_OUTPUTS:
+            case SUSI_CMD_DIRECT_OUTPUTS + 1:
+            case SUSI_CMD_DIRECT_OUTPUTS + 2:
+            case SUSI_CMD_DIRECT_OUTPUTS + 3:
+                {
+                    uint8_t shift = 8 * (packet.command - SUSI_CMD_DIRECT_OUTPUTS);
+                    uint32_t outputs = (_outputs & ~(0xFFUL << shift)) | ((uint32_t)packet.data << shift);
+                    uint32_t changed = outputs ^ _outputs;
+                    _outputs = outputs;
+                    if (changed != 0 && _output_callback != nullptr) {
+                        _output_callback(_outputs, changed);
+                    }
+                    _hal.sendAck();
+                }
+                break;
+            case SUSI_CMD_BINARY_STATE_SHORT:
+                if ((packet.data & 0x7F) == 0) {
+                    setShortBinaryStates((packet.data & 0x80) != 0);
+                    _hal.sendAck();
+                } else if (setBinaryState(packet.data & 0x7F, (packet.data & 0x80) != 0)) {
+                    _hal.sendAck();
+                }
+                break;
+            case SUSI_CMD_BINARY_STATE_LONG_L:
+                _binary_state_low = packet.data;
+                _binary_state_pending = true;
+                _hal.sendAck();
+                break;
+            case SUSI_CMD_BINARY_STATE_LONG_H:
+                if (_binary_state_pending) {
+                    _binary_state_pending = false;
+                    uint16_t number = ((uint16_t)packet.data << 7) | (_binary_state_low & 0x7F);
+                    if (setBinaryState(number, (_binary_state_low & 0x80) != 0)) {
+                        _hal.sendAck();
+                    }
+                }
+                break;
             case SUSI_CMD_WRITE_CV:
                 _cv_bank = packet.data;
-                _cv_read_mode = false;
+                _cv_op_command = SUSI_CMD_WRITE_CV;
                 _cv_op_in_progress = true;
                 _hal.sendAck();
                 break;
             case SUSI_CMD_READ_CV:
                 _cv_bank = packet.data;
-                _cv_read_mode = true;
+                _cv_op_command = SUSI_CMD_READ_CV;
                 _cv_op_in_progress = true;
                 _hal.sendAck();
                 break;
+            case SUSI_CMD_VERIFY_CV_BYTE:
+            case SUSI_CMD_CV_BIT:
+                // RCN-600: 1VVVVVVV selects CV 897 + V, the value follows
+                if (packet.data & 0x80) {
+                    _cv_address = SUSI_CV_MANIPULATION_FIRST - 1 + (packet.data & 0x7F);
+                    _cv_op_command = packet.command;
+                    _cv_op_in_progress = true;
+                    _hal.sendAck();
+                }
+                break;
+            case SUSI_CMD_BIDI_READ_CV:
+                {
+                    // RCN-601: the CV and the next one, or an error past CV 1024
+                    uint16_t cv = packet.data + SUSI_BIDI_READ_CV_OFFSET - 1;
+                    uint8_t value1 = readCV(cv);
+                    uint8_t header2 = SUSI_MSG_BIDI_CV_RESPONSE;
+                    uint8_t value2 = SUSI_BIDI_ERROR_CV_NOT_AVAILABLE;
+                    if (cv + 1 < 1024) {
+                        value2 = readCV(cv + 1);
+                    } else {
+                        header2 = SUSI_MSG_BIDI_ERROR;
+                    }
+                    _hal.sendAck();
+                    _send_bidi_response(SUSI_MSG_BIDI_CV_RESPONSE, value1, header2, value2);
+                }
+                break;
             case SUSI_CMD_BIDI_HOST_CALL:
                 {
                     uint8_t module_number = packet.data & 0x03;
                     bool forced_response = (packet.data & 0x04) != 0;
 
-                    if (forced_response && module_number == _address) {
-                        _bidirectional_mode = true; // Enable BiDi on handshake
-                        _hal.sendAck();
-                        // Respond with status messages as per RCN-601
-                        _send_bidi_response(SUSI_MSG_BIDI_STATUS, 0, SUSI_MSG_BIDI_STATUS, 0);
-                    } else if (_bidirectional_mode && module_number == _address) {
-                        // This is a regular poll, not a handshake
+                    if (hasAddress(module_number) && (forced_response || _bidirectional_mode)) {
                         _hal.sendAck();
-
-                        if (_bidi_data_available) {
-                            _send_bidi_response(
-                                _bidi_response_buffer[0],
-                                _bidi_response_buffer[1],
-                                _bidi_response_buffer[2],
-                                _bidi_response_buffer[3]
-                            );
-                            _bidi_data_available = false; // Reset after sending
-                        } else if (_status_bits != 0) {
-                            _send_bidi_response(SUSI_MSG_BIDI_STATUS, _status_bits, SUSI_MSG_BIDI_STATUS, _status_bits);
-                            _status_bits = 0; // Reset after sending
-                        }
-                        else {
-                            // Send EMPTY message if no data is queued
-                            _send_bidi_response(SUSI_MSG_BIDI_EMPTY, 0, SUSI_MSG_BIDI_EMPTY, 0);
-                        }
+                        uint8_t frame[4];
+                        takeBidiFrame(forced_response, frame);
+                        _send_bidi_response(frame[0], frame[1], frame[2], frame[3]);
                     }
                 }
                 break;
             default:
-                if (_cv_op_in_progress) {
-                    _cv_address = ((_cv_bank) << 8) | packet.command;
-                    if (_cv_read_mode) {
-                        uint8_t value1 = readCV(_cv_address);
-                        uint8_t value2 = readCV(_cv_address + 1);
-                        _send_bidi_response(SUSI_MSG_BIDI_CV_RESPONSE, value1, SUSI_MSG_BIDI_CV_RESPONSE, value2);
-                    } else {
-                        if (_cv_address == CV_SUSI_CV_BANKING) {
-                            _cv_bank_select = packet.data;
-                        } else {
-                            // --- Update existing CV or add a new one ---
-                            bool found = false;
-                            for (int i = 0; i < _cv_count; i++) {
-                                if (_cv_keys[i] == _cv_address) {
-                                    // Found the CV, update its value in RAM and EEPROM.
-                                    _cv_values[i] = packet.data;
-                                    int value_address = EEPROM_ADDR_CV_DATA_START + i * (sizeof(uint16_t) + sizeof(uint8_t)) + sizeof(uint16_t);
-                                    EEPROM.write(value_address, packet.data);
-                                    found = true;
-                                    break;
-                                }
-                            }
-
-                            if (!found && _cv_count < MAX_CVS) {
-                                // CV not found, add it as a new entry if there's space.
-                                _cv_keys[_cv_count] = _cv_address;
-                                _cv_values[_cv_count] = packet.data;
-
-                                // Write the new CV key-value pair to the EEPROM.
-                                int entry_address = EEPROM_ADDR_CV_DATA_START + _cv_count * (sizeof(uint16_t) + sizeof(uint8_t));
-                                EEPROM.put(entry_address, _cv_address);
-                                EEPROM.write(entry_address + sizeof(uint16_t), packet.data);
-
-                                // Increment the CV count in RAM and update it in the EEPROM.
-                                _cv_count++;
-                                EEPROM.write(EEPROM_ADDR_CV_COUNT, _cv_count);
-                            }
-                        }
-                    }
-                    _cv_op_in_progress = false;
-                    _cv_bank = 0;
-                }
+                break;
         }
     }
     return packet;
 }
 
-uint8_t SUSI_Slave::readCV(uint16_t cv) {
-    switch (cv) {
-        case CV_SUSI_MODULE_NUM:
-            return _address;
-        case CV_MANUFACTURER_ID:
-        case CV_MANUFACTURER_ID_BANK_1:
-        case CV_MANUFACTURER_ID_BANK_2:
-            if (_cv_bank_select == 0) return (_manufacturer_id >> 8) & 0xFF;
-            if (_cv_bank_select == 1) return (_hardware_id >> 8) & 0xFF;
-            return 0;
-        case CV_MANUFACTURER_ID + 1:
-        case CV_MANUFACTURER_ID_BANK_1 + 1:
-        case CV_MANUFACTURER_ID_BANK_2 + 1:
-            if (_cv_bank_select == 0) return _manufacturer_id & 0xFF;
-            if (_cv_bank_select == 1) return _hardware_id & 0xFF;
-            return 0;
-        case CV_VERSION_NUM:
-            if (_cv_bank_select == 0) return (_version_number >> 8) & 0xFF;
-            return 0;
-        case CV_VERSION_NUM + 1:
-            if (_cv_bank_select == 0) return _version_number & 0xFF;
-            return 0;
-        case CV_VERSION_NUM_BANK_1:
-        case CV_VERSION_NUM_BANK_2:
-            return 0;
-        case CV_VERSION_NUM_BANK_1 + 1:
-        case CV_VERSION_NUM_BANK_2 + 1:
-            return 0;
-        case CV_STATUS_BITS:
-            return _status_bits;
-        case CV_SUSI_CV_BANKING:
-            return _cv_bank_select;
-        default:
-            for (int i = 0; i < _cv_count; i++) {
-                if (_cv_keys[i] == cv) {
-                    return _cv_values[i];
+void SUSI_Slave::handleCVOperation(const SUSI_Packet& packet) {
+    switch (_cv_op_command) {
+        case SUSI_CMD_READ_CV:
+            {
+                _cv_address = ((_cv_bank & 0x03) << 8) | packet.command;
+                uint8_t value1 = readCV(_cv_address);
+                uint8_t value2 = readCV(_cv_address + 1);
+                _hal.sendAck();
+                _send_bidi_response(SUSI_MSG_BIDI_CV_RESPONSE, value1, SUSI_MSG_BIDI_CV_RESPONSE, value2);
+            }
+            break;
+        case SUSI_CMD_WRITE_CV:
+            _cv_address = ((_cv_bank & 0x03) << 8) | packet.command;
+            // No ACK for a value that cannot be stored, so the master learns of it
+            if (writeCVFromBus(_cv_address, packet.data)) {
+                _hal.sendAck();
+            }
+            break;
+        case SUSI_CMD_VERIFY_CV_BYTE:
+            // The second packet repeats the command; no ACK means no match
+            if (packet.command == SUSI_CMD_VERIFY_CV_BYTE && readCV(_cv_address) == packet.data) {
+                _hal.sendAck();
+            }
+            break;
+        case SUSI_CMD_CV_BIT:
+            if (packet.command == SUSI_CMD_CV_BIT && (packet.data & 0xE0) == 0xE0) {
+                uint8_t mask = 1 << (packet.data & 0x07);
+                bool bit = (packet.data & 0x08) != 0;
+                uint8_t value = readCV(_cv_address);
+                if (packet.data & 0x10) {
+                    if (writeCVFromBus(_cv_address, bit ? value | mask : value & ~mask)) {
+                        _hal.sendAck();
+                    }
+                } else if (((value & mask) != 0) == bit) {
+                    _hal.sendAck();
                 }
             }
-            return 0;
+            break;
+        default:
+            break;
+    }
+    _cv_op_in_progress = false;
+    _cv_bank = 0;
+}
+
+void SUSI_Slave::setShortBinaryStates(bool on) {
+    // The short form with L = 0 only reaches the states it can address
+    _binary_states.setAllShort(on);
+    if (_binary_state_callback != nullptr) {
+        for (uint16_t number = 1; number <= SUSI_BINARY_STATE_SHORT_MAX; number++) {
+            _binary_state_callback(number, on);
+        }
+    }
+}
+
+bool SUSI_Slave::setBinaryState(uint16_t number, bool on) {
+    // State 0 of the long form is the broadcast to all states; no ACK if the
+    // store is full
+    if (number == 0) {
+        _binary_states.setAll(on);
+    } else if (!_binary_states.set(number, on)) {
+        return false;
+    }
+    if (_binary_state_callback != nullptr) {
+        _binary_state_callback(number, on);
+    }
+    return true;
+}
+
+bool SUSI_Slave::writeCVFromBus(uint16_t cv, uint8_t value) {
+    return _cv_registry.write(cv, _cv_bank_select, value) || storeCV(cv, value);
+}
+
+bool SUSI_Slave::storeCV(uint16_t cv, uint8_t value) {
+    // RAM is updated right away, the EEPROM record is appended in idle time.
+    // Only CVs that differ from their default are kept in the table.
+    uint8_t default_value;
+    if (_cv_defaults.get(cv, default_value) && default_value == value) {
+        if (!_cv_table.erase(cv)) {
+            return true; // Already at its default
+        }
+    } else if (!_cv_table.set(cv, value)) {
+        return false;
+    }
+
+    if (cv < SUSI_CV_BANK_COUNT * SUSI_CV_BANK_SIZE) {
+        uint8_t bank = cv / SUSI_CV_BANK_SIZE;
+        uint8_t* image = _cv_bank_images[bank];
+        if (image[cv % SUSI_CV_BANK_SIZE] != value) {
+            image[cv % SUSI_CV_BANK_SIZE] = value;
+            _cv_bank_crcs[bank] = crc8_rcn218(image, SUSI_CV_BANK_SIZE);
+        }
+    }
+    return _cv_log.markDirty(cv);
+}
+
+uint8_t SUSI_Slave::readCV(uint16_t cv) {
+#ifdef TESTING
+    _cv_lookups++;
+#endif
+    uint8_t value = 0;
+    if (!_cv_registry.read(cv, _cv_bank_select, value) && !_cv_table.get(cv, value)) {
+        _cv_defaults.get(cv, value);
+    }
+    return value;
+}
+
+bool SUSI_Slave::bindCVs(uint16_t first, uint16_t count, CVReadCallback read, CVWriteCallback write,
+                         void* context, uint8_t bank) {
+    if (!_cv_registry.bind(first, count, read, write, context, bank)) {
+        return false;
     }
+    markBoundCVs(first, count);
+    return true;
+}
+
+bool SUSI_Slave::bindCVMemory(uint16_t first, uint16_t count, uint8_t* memory, bool writable,
+                              uint8_t bank) {
+    if (!_cv_registry.bindMemory(first, count, memory, writable, bank)) {
+        return false;
+    }
+    markBoundCVs(first, count);
+    return true;
 }
 
 void SUSI_Slave::getCVBank(uint8_t bank, uint8_t* data) {
-    for (int i = 0; i < 40; i++) {
-        data[i] = 0;
+    // The same lookup as readCV(), so a bank read and CV reads agree
+    uint16_t start_cv = bank * SUSI_CV_BANK_SIZE;
+    for (int i = 0; i < SUSI_CV_BANK_SIZE; i++) {
+        data[i] = readCV(start_cv + i);
     }
+}
 
-    uint16_t start_cv = bank * 40;
-    for (int i = 0; i < _cv_count; i++) {
-        if (_cv_keys[i] >= start_cv && _cv_keys[i] < start_cv + 40) {
-            data[_cv_keys[i] - start_cv] = _cv_values[i];
+void SUSI_Slave::refreshCVBank(uint8_t bank) {
+    uint64_t bound = _cv_bank_bound[bank];
+    if (bound == 0) {
+        return;
+    }
+    uint8_t* image = _cv_bank_images[bank];
+    bool changed = false;
+    for (uint8_t i = 0; i < SUSI_CV_BANK_SIZE; i++) {
+        if ((bound >> i) & 1) {
+            uint8_t value = readCV(bank * SUSI_CV_BANK_SIZE + i);
+            changed = changed || image[i] != value;
+            image[i] = value;
         }
     }
+    if (changed) {
+        _cv_bank_crcs[bank] = crc8_rcn218(image, SUSI_CV_BANK_SIZE);
+    }
 }
 
-void SUSI_Slave::onClockFall() {
-    if (_susi_slave_instance) {
-        _susi_slave_instance->handleClockFall();
+void SUSI_Slave::markBoundCVs(uint16_t first, uint16_t count) {
+    for (uint16_t cv = first; cv < first + count && cv < SUSI_CV_BANK_COUNT * SUSI_CV_BANK_SIZE; cv++) {
+        _cv_bank_bound[cv / SUSI_CV_BANK_SIZE] |= (uint64_t)1 << (cv % SUSI_CV_BANK_SIZE);
     }
+    rebuildCVBanks();
 }
 
-void SUSI_Slave::handleClockFall() {
-    if (_packetReady) {
+void SUSI_Slave::rebuildCVBanks() {
+    for (uint8_t bank = 0; bank < SUSI_CV_BANK_COUNT; bank++) {
+        getCVBank(bank, _cv_bank_images[bank]);
+        _cv_bank_crcs[bank] = crc8_rcn218(_cv_bank_images[bank], SUSI_CV_BANK_SIZE);
+    }
+}
+
+template <uint8_t SLOT>
+void SUSI_Slave::onClockChange() {
+    SUSI_Slave* slave = _instances[SLOT];
+    if (slave != nullptr) {
+        slave->handleClockChange();
+    }
+}
+
+void SUSI_Slave::handleClockChange() {
+    if (_answering) {
         return;
     }
+    bool clock = _hal.read_clock();
+
+    if (!_bidi_tx_active) {
+        if (!clock) {
+            handleClockFall();
+        }
+        return;
+    }
+
+    // A BiDi response is clocked out by the master: 32 clocks, LSB first. The
+    // master samples while the clock is low, so the first bit is put on the line
+    // at the first falling edge after the ACK and the following bits at the
+    // rising edges.
+    if (!clock) {
+        if (_bidi_tx_bit == 0) {
+            putBidiBit();
+        }
+        return;
+    }
+
+    if (_bidi_tx_bit == 0) {
+        return; // Rising edge of the host call's stop bit
+    }
+    if (_bidi_tx_bit < 32) {
+        putBidiBit();
+    } else {
+        _hal.release_data();
+        _bidi_tx_active = false;
+    }
+}
 
-    unsigned long current_time_us = micros();
+void SUSI_Slave::putBidiBit() {
+    uint8_t bit = _bidi_tx_bit;
+    if ((_bidi_tx_frame[bit / 8] >> (bit % 8)) & 0x01) {
+        _hal.set_data_high();
+    } else {
+        _hal.set_data_low();
+    }
+    _bidi_tx_bit++;
+}
+
+bool SUSI_Slave::startBidiResponse(uint8_t data) {
+    uint8_t module_number = data & 0x03;
+    bool forced_response = (data & 0x04) != 0;
+    if (!hasAddress(module_number) || !(forced_response || _bidirectional_mode)) {
+        return false;
+    }
+
+    // RCN-601: the ACK has to start within 2ms of the host call, independent of
+    // the main loop. The frame is ready, so only the bits remain to be clocked out.
+    _hal.sendAckFromISR();
+    takeBidiFrame(forced_response, _bidi_tx_frame);
+    _bidi_tx_bit = 0;
+    _bidi_tx_active = true;
+    return true;
+}
+
+void SUSI_Slave::handleClockFall() {
+    // Decoding goes on while a packet waits for read(), so host calls are
+    // answered however busy the main loop is.
+    uint32_t current_time_us = _hal.clock().nowMicros();
+
+    // Skip the answer of another module. If nobody answered, the next packet
+    // follows after a gap and is decoded normally.
+    if (_skip_clocks > 0) {
+        if (susiElapsed(_last_bit_time_us, current_time_us) <= SUSI_BIT_TIMEOUT_US) {
+            _skip_clocks--;
+            _last_bit_time_us = current_time_us;
+            return;
+        }
+        _skip_clocks = 0;
+    }
 
     // RCN600-S1: 8ms timeout to reset buffer
-    if (_bitCount > 0 && (current_time_us - _last_bit_time_us > 8000)) {
+    if (_bitCount > 0 && susiElapsed(_last_bit_time_us, current_time_us) > SUSI_BIT_TIMEOUT_US) {
         _bitCount = 0;
-        _buffer[0] = 0;
-        _buffer[1] = 0;
-        _buffer[2] = 0;
+        _rx_buffer[0] = 0;
+        _rx_buffer[1] = 0;
+        _rx_buffer[2] = 0;
     }
 
     _last_bit_time_us = current_time_us;
@@ -420,9 +811,17 @@ void SUSI_Slave::handleClockFall() {
     // The 25th bit must be a HIGH stop bit
     if (_bitCount == 25) {
         if (data) { // Stop bit is HIGH
-            if (_buffer[0] == _address || _buffer[0] == 0) {
+            if (_rx_buffer[0] == 0 && _rx_buffer[1] == SUSI_CMD_BIDI_HOST_CALL) {
+                // Answered from the ISR or not at all, nothing for read()
+                startBidiResponse(_rx_buffer[2]);
+            } else if ((_rx_buffer[0] == 0 || hasAddress(_rx_buffer[0])) && !_packetReady) {
+                // A packet that arrives before read() took the last one is lost
+                _buffer[0] = _rx_buffer[0];
+                _buffer[1] = _rx_buffer[1];
+                _buffer[2] = _rx_buffer[2];
                 _packetReady = true;
             }
+            skipForeignAnswer();
         }
         // Reset for next packet
         _bitCount = 0;
@@ -435,18 +834,47 @@ void SUSI_Slave::handleClockFall() {
 
     if (byteIndex < 3) {
         if (data) {
-            _buffer[byteIndex] |= (1 << bitIndex);
+            _rx_buffer[byteIndex] |= (1 << bitIndex);
         } else {
-            _buffer[byteIndex] &= ~(1 << bitIndex);
+            _rx_buffer[byteIndex] &= ~(1 << bitIndex);
         }
     }
 
     _bitCount++;
 }
 
+void SUSI_Slave::skipForeignAnswer() {
+    uint8_t address = _rx_buffer[0];
+    uint8_t command = _rx_buffer[1];
+    if (address == 0) {
+        if (command == SUSI_CMD_BIDI_HOST_CALL && !hasAddress(_rx_buffer[2] & 0x03)) {
+            _skip_clocks = 32;
+        }
+        return;
+    }
+    if (hasAddress(address)) {
+        return;
+    }
+
+    // The second packet of a CV operation carries an address byte as command.
+    if (address == _foreign_cv_address) {
+        if (_foreign_cv_read) {
+            _skip_clocks = 32;
+        }
+        _foreign_cv_address = 0;
+    } else if (command == SUSI_CMD_READ_CV || command == SUSI_CMD_WRITE_CV) {
+        _foreign_cv_address = address;
+        _foreign_cv_read = command == SUSI_CMD_READ_CV;
+    } else if (command >= SUSI_CMD_READ_CV_BANK_0 && command <= SUSI_CMD_READ_CV_BANK_2) {
+        _skip_clocks = (SUSI_CV_BANK_SIZE + 2) * 8;
+    } else if (command == SUSI_CMD_BIDI_READ_CV) {
+        _skip_clocks = 32;
+    }
+}
+
 #ifdef TESTING
 void SUSI_Slave::_test_receive_packet(const SUSI_Packet& packet) {
-    if (packet.address == _address || packet.address == 0) {
+    if (packet.address == 0 || hasAddress(packet.address)) {
         _buffer[0] = packet.address;
         _buffer[1] = packet.command;
         _buffer[2] = packet.data;
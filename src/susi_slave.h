@@ -4,14 +4,46 @@
 #include <Arduino.h>
 #include "susi_hal.h"
 #include "susi_packet.h"
+#include "susi_cv_table.h"
+#include "susi_cv_defaults.h"
+#include "susi_cv_log.h"
+#include "susi_cv_registry.h"
+#include "susi_bidi_queue.h"
+#include "susi_binary_states.h"
 
-class SUSI_Slave;
-extern SUSI_Slave* _susi_slave_instance;
+/**
+ * @brief The number of CV banks that can be read with a bank read command.
+ */
+const uint8_t SUSI_CV_BANK_COUNT = 3;
+
+/**
+ * @brief The number of CVs in one CV bank.
+ */
+const uint8_t SUSI_CV_BANK_SIZE = 40;
 
 /**
- * @brief The maximum number of CVs that can be stored by the slave.
+ * @brief Sources of the precomputed BiDi response frame.
  */
-const uint8_t MAX_CVS = 32;
+enum SusiBidiFrameSource {
+    BIDI_FRAME_EMPTY,
+    BIDI_FRAME_STATUS,
+    BIDI_FRAME_QUEUE
+};
+
+/**
+ * @brief The maximum number of slaves with their own clock pin on one MCU.
+ * @details Every slave needs its own clock interrupt; at most 4 are supported.
+ */
+#ifndef SUSI_MAX_SLAVE_INSTANCES
+#define SUSI_MAX_SLAVE_INSTANCES 2
+#endif
+
+/**
+ * @brief The maximum number of module numbers one slave answers for.
+ */
+#ifndef SUSI_SLAVE_MAX_ADDRESSES
+#define SUSI_SLAVE_MAX_ADDRESSES 4
+#endif
 
 /**
  * @brief A callback function that is called when a function is changed.
@@ -20,6 +52,24 @@ const uint8_t MAX_CVS = 32;
  */
 typedef void (*FunctionCallback)(uint8_t, bool);
 
+/**
+ * @brief A callback function that is called when direct outputs are changed.
+ * @details Called once per direct command with all outputs, so that a whole
+ * port can be written at once.
+ * @param outputs Bit n is the state of output n + 1.
+ * @param changed Bit n is set if output n + 1 changed.
+ */
+typedef void (*OutputCallback)(uint32_t outputs, uint32_t changed);
+
+/**
+ * @brief A callback function that is called when a binary state is set.
+ * @details The broadcast of the short form calls it for each of the states
+ * 1–127.
+ * @param number The state number (1–32767), or 0 when all states were set.
+ * @param on The state.
+ */
+typedef void (*BinaryStateCallback)(uint16_t number, bool on);
+
 /**
  * @brief Represents a SUSI Slave device.
  * @details This class provides the functionality for a SUSI slave device to receive and process SUSI packets from a master.
@@ -33,11 +83,37 @@ public:
      */
     SUSI_Slave(SusiHAL& hal);
 
+    /**
+     * @brief Destroys the SUSI_Slave object and releases its clock interrupt.
+     */
+    ~SUSI_Slave();
+
     /**
      * @brief Initializes the SUSI slave.
+     * @details Each slave attaches the interrupt of its own clock pin, so up to
+     * SUSI_MAX_SLAVE_INSTANCES slaves on different pins can run side by side. A
+     * slave started on a clock pin that is already in use takes it over.
      * @param address The address of the slave.
+     * @return bool Whether the clock interrupt was attached, false if all slots are in use.
+     */
+    bool begin(uint8_t address);
+
+    /**
+     * @brief Adds a further module number the slave answers for.
+     * @details Packets, CV operations and BiDi host calls for any of the
+     * addresses are handled by this slave; CV 897 reports the address passed
+     * to begin(). Call this after begin().
+     * @param address The additional address (1-255).
+     * @return bool Whether the address was added, false if the set is full or the address is 0.
+     */
+    bool addAddress(uint8_t address);
+
+    /**
+     * @brief Checks if the slave answers for an address.
+     * @param address The address to check.
+     * @return bool Whether the address is one of the slave's addresses.
      */
-    void begin(uint8_t address);
+    bool hasAddress(uint8_t address) const;
 
     /**
      * @brief Checks if a SUSI packet is available to be read.
@@ -51,12 +127,62 @@ public:
      */
     SUSI_Packet read();
 
+    /**
+     * @brief Commits all deferred CV writes to the EEPROM.
+     * @details CV writes update RAM immediately and are committed to the EEPROM one
+     * byte per idle `available()` call. Call this before powering down or resetting.
+     */
+    void flushCVs();
+
+    /**
+     * @brief Gets the amount of CV persistence work that is still pending.
+     * @return uint16_t The number of waiting CVs plus queued EEPROM bytes; 0 when idle.
+     */
+    uint16_t pendingCVWrites() const;
+
+    /**
+     * @brief Gets the wear statistics of the EEPROM CV log.
+     * @param stats A reference to a structure to store the statistics in.
+     */
+    void getCVStorageStats(SusiCVLogStats& stats) const;
+
+    /**
+     * @brief Sets the factory defaults of the CVs.
+     * @details Only CVs that differ from their default take space in RAM and in
+     * the EEPROM. Call this before begin().
+     * @param defaults The defaults in program memory (PROGMEM), sorted by CV number.
+     * @param count The number of entries.
+     * @return bool Whether the defaults were accepted, false if they are not sorted.
+     */
+    bool setCVDefaults(const SusiCVDefault* defaults, uint16_t count);
+
+    /**
+     * @brief Returns all stored CVs to their factory defaults.
+     * @details Drops the overrides in RAM at once; the EEPROM only needs a new
+     * log header, which is written in idle time like any other CV change.
+     */
+    void resetCVs();
+
     /**
      * @brief Sets a callback function that is called when a function is changed.
      * @param callback The callback function.
      */
     void onFunctionChange(FunctionCallback callback);
 
+    /**
+     * @brief Sets a callback function that is called when direct outputs are changed.
+     * @param callback The callback function.
+     * @see RCN-600
+     */
+    void onOutputsChange(OutputCallback callback);
+
+    /**
+     * @brief Sets a callback function that is called when a binary state is set.
+     * @param callback The callback function.
+     * @see RCN-600
+     */
+    void onBinaryStateChange(BinaryStateCallback callback);
+
     /**
      * @brief Enables bidirectional communication mode.
      * @see RCN-601
@@ -84,12 +210,33 @@ public:
     bool getFunction(uint8_t function) const { return (_functions >> function) & 1; }
 
     /**
-     * @brief Queues data to be sent in the next bidirectional response.
+     * @brief Gets the state of the direct outputs.
+     * @return uint32_t Bit n is the state of output n + 1.
+     */
+    uint32_t getOutputs() const { return _outputs; }
+
+    /**
+     * @brief Gets a binary state.
+     * @param number The state number (1–32767).
+     * @return bool The state.
+     */
+    bool getBinaryState(uint16_t number) const { return _binary_states.get(number); }
+
+    /**
+     * @brief Queues data to be sent in a bidirectional response.
+     * @details Both halves are sent together in one response. Messages are sent
+     * one per host call by priority, see SusiBidiQueue.
      * @param data A pointer to a 4-byte array containing the data to send.
      * @see RCN-601
      */
     void queueBidirectionalData(const uint8_t* data);
 
+    /**
+     * @brief Gets the counters of the BiDi transmit queue.
+     * @param stats A reference to a structure to store the counters in.
+     */
+    void getBidiQueueStats(SusiBidiQueueStats& stats) const;
+
     /**
      * @brief Sends a position response in the next bidirectional poll.
      * @param address The position address to send.
@@ -151,11 +298,41 @@ public:
 
     /**
      * @brief Reads the value of a CV.
-     * @param cv The CV to read.
+     * @param cv The CV to read, its number minus 1 as in the bus packets.
      * @return uint8_t The value of the CV.
      */
     uint8_t readCV(uint16_t cv);
 
+    /**
+     * @brief Binds a range of virtual CVs to callbacks.
+     * @details Reads and writes of the CVs are handled by the callbacks instead of
+     * the CV storage, e.g. to expose live values as CVs. Bound CVs in the range
+     * of the CV banks are read again on every bank read, so it returns the same
+     * values as readCV().
+     * @param first The first CV of the range.
+     * @param count The number of CVs in the range.
+     * @param read The callback that provides the values.
+     * @param write The callback for writes, or nullptr for read-only CVs.
+     * @param context A pointer that is passed to the callbacks.
+     * @param bank The CV bank (CV 1021) the range is valid in, or SUSI_CV_ANY_BANK.
+     * @return bool Whether the range was bound, false if no registry entry is free.
+     */
+    bool bindCVs(uint16_t first, uint16_t count, CVReadCallback read, CVWriteCallback write,
+                 void* context = nullptr, uint8_t bank = SUSI_CV_ANY_BANK);
+
+    /**
+     * @brief Binds a range of virtual CVs directly to memory.
+     * @details Like bindCVs(), bank reads see the current memory contents.
+     * @param first The first CV of the range.
+     * @param count The number of CVs in the range.
+     * @param memory The memory location of the first CV, one byte per CV.
+     * @param writable Whether writes to the CVs change the memory.
+     * @param bank The CV bank (CV 1021) the range is valid in, or SUSI_CV_ANY_BANK.
+     * @return bool Whether the range was bound, false if no registry entry is free.
+     */
+    bool bindCVMemory(uint16_t first, uint16_t count, uint8_t* memory, bool writable,
+                      uint8_t bank = SUSI_CV_ANY_BANK);
+
     /**
      * @brief Sets the manufacturer ID of the slave.
      * @param id The manufacturer ID.
@@ -198,40 +375,114 @@ public:
      * @param packet The packet to inject.
      */
     void _test_receive_packet(const SUSI_Packet& packet);
+
+    /**
+     * @brief Test-only access to the CV bank image builder.
+     * @param bank The bank number.
+     * @param data Buffer of SUSI_CV_BANK_SIZE bytes for the bank image.
+     */
+    void _test_get_cv_bank(uint8_t bank, uint8_t* data) { getCVBank(bank, data); }
+
+    /**
+     * @brief Test-only count of CV lookups through readCV(), including those
+     * that build and refresh the CV bank images.
+     * @return uint32_t The number of lookups since construction.
+     */
+    uint32_t _test_cv_lookups() const { return _cv_lookups; }
 #endif
 
 private:
     void _send_bidi_response(uint8_t header1, uint8_t data1, uint8_t header2, uint8_t data2);
+    void beginAnswer();
+    bool sendAnswerBytes(const uint8_t* data, uint8_t length);
+    void endAnswer();
+    void skipForeignAnswer();
     void getCVBank(uint8_t bank, uint8_t* data);
-    static void onClockFall();
+    void rebuildCVBanks();
+    void refreshCVBank(uint8_t bank);
+    void markBoundCVs(uint16_t first, uint16_t count);
+    void handleCVOperation(const SUSI_Packet& packet);
+    bool storeCV(uint16_t cv, uint8_t value);
+    bool writeCVFromBus(uint16_t cv, uint8_t value);
+    bool setBinaryState(uint16_t number, bool on);
+    void setShortBinaryStates(bool on);
+    void queueBidiMessage(uint8_t header, uint8_t data, uint8_t priority);
+    void queueBidiPair(uint8_t header1, uint8_t data1, uint8_t header2, uint8_t data2, uint8_t priority);
+    void prepareBidiFrame();
+    void takeBidiFrame(bool handshake, uint8_t* frame);
+    bool startBidiResponse(uint8_t data);
+    void putBidiBit();
+    template <uint8_t SLOT>
+    static void onClockChange();
+    void handleClockChange();
     void handleClockFall();
 
+    // Slaves by clock interrupt slot, each slot has its own ISR trampoline.
+    static SUSI_Slave* _instances[SUSI_MAX_SLAVE_INSTANCES];
+    static uint8_t _instance_pins[SUSI_MAX_SLAVE_INSTANCES];
+    static void (* const _clock_isrs[SUSI_MAX_SLAVE_INSTANCES])();
+
     SusiHAL& _hal;
-    uint8_t _address;
+    // The first address is the one passed to begin().
+    uint8_t _addresses[SUSI_SLAVE_MAX_ADDRESSES];
+    uint8_t _address_count;
     volatile bool _packetReady;
-    volatile uint8_t _buffer[3];
+    volatile uint8_t _buffer[3];    // The packet waiting for read()
+    volatile uint8_t _rx_buffer[3]; // The packet being decoded
     volatile uint8_t _bitCount;
-    volatile unsigned long _last_bit_time_us;
+    volatile uint32_t _last_bit_time_us;
     uint8_t _speed;
     bool _forward;
     uint32_t _functions;
+    uint32_t _outputs;
+    SusiBinaryStates _binary_states;
+    uint8_t _binary_state_low; // DLLLLLLL of a pending long form
+    bool _binary_state_pending;
     uint8_t _cv_bank;
     uint8_t _cv_bank_select;
     uint16_t _cv_address;
-    bool _cv_read_mode;
+    // The command that started the CV operation
+    uint8_t _cv_op_command;
     bool _cv_op_in_progress;
-    uint16_t _cv_keys[MAX_CVS];
-    uint8_t _cv_values[MAX_CVS];
-    uint8_t _cv_count;
+    // CVs that differ from their default, see SusiCVDefaults.
+    SusiCVTable _cv_table;
+    SusiCVDefaults _cv_defaults;
+    SusiCVLog _cv_log;
+    SusiCVRegistry _cv_registry;
+    // Ready-to-send images of the CV banks, kept up to date by storeCV() so a
+    // bank read can start streaming right after the ACK.
+    uint8_t _cv_bank_images[SUSI_CV_BANK_COUNT][SUSI_CV_BANK_SIZE];
+    uint8_t _cv_bank_crcs[SUSI_CV_BANK_COUNT];
+    // Bit i: byte i of the bank is a bound CV, which is read again for every
+    // bank read since its value can change without a write.
+    uint64_t _cv_bank_bound[SUSI_CV_BANK_COUNT];
     bool _bidirectional_mode;
-    uint8_t _bidi_response_buffer[4];
-    bool _bidi_data_available;
+    SusiBidiQueue _bidi_queue;
+    // The response to the next host call, rebuilt whenever the queued data changes.
+    uint8_t _bidi_frame[4];
+    uint8_t _bidi_frame_source;
+    // The response being clocked out by the master.
+    uint8_t _bidi_tx_frame[4];
+    volatile uint8_t _bidi_tx_bit;
+    volatile bool _bidi_tx_active;
+    // Clocks of another module's answer, which are not a packet.
+    volatile uint16_t _skip_clocks;
+    // Another module in the middle of a CV operation, and whether it reads.
+    uint8_t _foreign_cv_address;
+    bool _foreign_cv_read;
+    // Set while the main loop sends an answer clocked by the master.
+    volatile bool _answering;
     uint8_t _status_bits;
     FunctionCallback _function_callback;
+    OutputCallback _output_callback;
+    BinaryStateCallback _binary_state_callback;
 
-    uint16_t _manufacturer_id;
-    uint16_t _hardware_id;
-    uint16_t _version_number;
+    // RCN-602 identification CVs 900-903 per bank, bound in the CV registry.
+    uint8_t _id_cvs_bank_0[4];
+    uint8_t _id_cvs_bank_1[4];
+#ifdef TESTING
+    uint32_t _cv_lookups;
+#endif
 };
 
 #endif // SUSI_SLAVE_H
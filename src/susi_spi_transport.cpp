@@ -0,0 +1,56 @@
+#include "susi_spi_transport.h"
+
+// Idle HIGH bits sent in front of the start bit to fill 4 bytes.
+const uint8_t SUSI_SPI_PAD_BITS = 32 - SUSI_FRAME_BITS;
+
+SusiSPITransport::SusiSPITransport(SusiHAL& hal, SPIClass& spi) : _hal(hal), _spi(spi) {
+    _clock = &hal.clock();
+}
+
+void SusiSPITransport::setClock(SusiClock& clock) {
+    SusiTransport::setClock(clock);
+    _hal.setClock(clock);
+}
+
+void SusiSPITransport::begin() {
+    _spi.begin();
+}
+
+SusiMasterResult SusiSPITransport::sendPacket(const SUSI_Packet& packet, bool expectAck) {
+    waitForSyncGap(packet);
+
+    // The packet ends with the last clock, so a host call's stop bit is not
+    // followed by clocks the slave would take for its response.
+    uint32_t frame = (susiEncodeFrame(packet) << SUSI_SPI_PAD_BITS) | ((1u << SUSI_SPI_PAD_BITS) - 1);
+    _spi.beginTransaction(SPISettings(SUSI_SPI_CLOCK_HZ, LSBFIRST, SPI_MODE2));
+    for (uint8_t i = 0; i < 4; i++) {
+        _spi.transfer((frame >> (8 * i)) & 0xFF);
+    }
+    _spi.endTransaction();
+
+    packetSent();
+
+    if (expectAck) {
+        SusiMasterResult result = _hal.waitForAck(_ack_timeout_us);
+        _ack_latency_us = _hal.ackLatency();
+        return result;
+    }
+
+    return SUCCESS;
+}
+
+uint8_t SusiSPITransport::readByte() {
+    // MOSI stays HIGH, so only the slave drives the data line.
+    _spi.beginTransaction(SPISettings(SUSI_SPI_CLOCK_HZ, LSBFIRST, SPI_MODE2));
+    uint8_t value = _spi.transfer(0xFF);
+    _spi.endTransaction();
+    busClocked();
+    return value;
+}
+
+void SusiSPITransport::clockPulse() {
+    _spi.end();
+    _hal.generate_clock_pulse();
+    _spi.begin();
+    busClocked();
+}
@@ -0,0 +1,49 @@
+#ifndef SUSI_SPI_TRANSPORT_H
+#define SUSI_SPI_TRANSPORT_H
+
+#include <SPI.h>
+#include "susi_transport.h"
+#include "susi_hal.h"
+
+/**
+ * @brief The SPI clock of the SUSI bus, matching the 10us half clock of the bit-banged transport.
+ */
+const uint32_t SUSI_SPI_CLOCK_HZ = 50000;
+
+/**
+ * @brief A transport that shifts the packets out with the SPI peripheral.
+ * @details The SUSI clock line is SCK, which idles HIGH; the slaves sample on the
+ * falling edge, so SPI mode 2 is used, LSB first. MOSI drives the data line
+ * through a resistor and MISO reads it, so slaves can still pull it LOW.
+ *
+ * A packet is 26 clocks, SPI shifts whole bytes. Each packet is therefore sent
+ * as 4 bytes with 6 idle HIGH bits in front of the start bit, which slaves
+ * ignore while they wait for a start bit. The ACK is awaited through the HAL.
+ */
+class SusiSPITransport : public SusiTransport {
+public:
+    /**
+     * @brief Constructs a new SusiSPITransport object.
+     * @param hal The HAL of the bus; its clock pin is SCK and its data pin is MISO.
+     * @param spi The SPI peripheral.
+     */
+    SusiSPITransport(SusiHAL& hal, SPIClass& spi = SPI);
+
+    void begin() override;
+    SusiMasterResult sendPacket(const SUSI_Packet& packet, bool expectAck) override;
+    uint8_t readByte() override;
+
+    /**
+     * @brief Generates a single clock pulse.
+     * @details SPI only clocks whole bytes, so SCK is briefly handed back to the HAL.
+     */
+    void clockPulse() override;
+
+    void setClock(SusiClock& clock) override;
+
+private:
+    SusiHAL& _hal;
+    SPIClass& _spi;
+};
+
+#endif // SUSI_SPI_TRANSPORT_H
@@ -0,0 +1,88 @@
+#include "susi_transport.h"
+#include "susi_commands.h"
+#include "susi_hal.h"
+
+// Timing constants from the SUSI specification
+const uint32_t SUSI_INTER_BYTE_TIMEOUT_US = 7000;
+const uint32_t SUSI_SYNC_GAP_US = 9000;
+const uint8_t SUSI_PACKETS_PER_SYNC = 20;
+const uint8_t SUSI_BANK_READS_PER_SYNC = 50;
+
+uint32_t susiEncodeFrame(const SUSI_Packet& packet) {
+    // The start bit (bit 0) is LOW, the stop bit (bit 25) HIGH.
+    return ((uint32_t)packet.address << 1) |
+           ((uint32_t)packet.command << 9) |
+           ((uint32_t)packet.data << 17) |
+           ((uint32_t)1 << (SUSI_FRAME_BITS - 1));
+}
+
+bool susiDecodeFrame(uint32_t frame, SUSI_Packet& packet) {
+    if ((frame & 0x01) || !((frame >> (SUSI_FRAME_BITS - 1)) & 0x01)) {
+        return false;
+    }
+    packet.address = (frame >> 1) & 0xFF;
+    packet.command = (frame >> 9) & 0xFF;
+    packet.data = (frame >> 17) & 0xFF;
+    return true;
+}
+
+SusiTransport::SusiTransport() {
+    _clock = &susiDefaultClock();
+    _ack_timeout_us = SUSI_ACK_TIMEOUT_US;
+    _ack_latency_us = 0;
+    _last_clock_time_us = 0;
+    _packets_since_sync = 0;
+    _bank_reads_only = false;
+    _idle_hook = nullptr;
+    _idle_context = nullptr;
+}
+
+void SusiTransport::onIdle(SusiIdleHook hook, void* context) {
+    _idle_hook = hook;
+    _idle_context = context;
+}
+
+uint32_t SusiTransport::syncGapRemaining(const SUSI_Packet& packet) const {
+    // Idle time longer than 7 ms resynchronizes the slaves and counts toward
+    // the 9 ms sync gap, so only the rest of it is left to wait.
+    uint32_t idle_us = susiElapsed(_last_clock_time_us, _clock->nowMicros());
+    bool resync = idle_us > SUSI_INTER_BYTE_TIMEOUT_US;
+    uint8_t limit = SUSI_PACKETS_PER_SYNC;
+    if (isBankRead(packet) && (resync || _bank_reads_only)) {
+        limit = SUSI_BANK_READS_PER_SYNC;
+    }
+    if (!resync && _packets_since_sync < limit) {
+        return 0;
+    }
+    return idle_us >= SUSI_SYNC_GAP_US ? 0 : SUSI_SYNC_GAP_US - idle_us;
+}
+
+void SusiTransport::waitForSyncGap(const SUSI_Packet& packet) {
+    uint32_t remaining;
+    while ((remaining = syncGapRemaining(packet)) > 0) {
+        if (_idle_hook != nullptr) {
+            _idle_hook(_idle_context);
+        } else {
+            _clock->delayMicros(remaining);
+        }
+    }
+
+    if (susiElapsed(_last_clock_time_us, _clock->nowMicros()) > SUSI_INTER_BYTE_TIMEOUT_US) {
+        _packets_since_sync = 0;
+        _bank_reads_only = true;
+    }
+    _bank_reads_only = _bank_reads_only && isBankRead(packet);
+}
+
+void SusiTransport::packetSent() {
+    _last_clock_time_us = _clock->nowMicros();
+    _packets_since_sync++;
+}
+
+void SusiTransport::busClocked() {
+    _last_clock_time_us = _clock->nowMicros();
+}
+
+bool SusiTransport::isBankRead(const SUSI_Packet& packet) {
+    return packet.command >= SUSI_CMD_READ_CV_BANK_0 && packet.command <= SUSI_CMD_READ_CV_BANK_2;
+}
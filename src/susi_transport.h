@@ -0,0 +1,165 @@
+#ifndef SUSI_TRANSPORT_H
+#define SUSI_TRANSPORT_H
+
+#include <Arduino.h>
+#include "susi_packet.h"
+#include "susi_response.h"
+#include "susi_clock.h"
+
+/**
+ * @brief The number of clocks of a packet on the wire: start bit, 3 bytes and stop bit.
+ */
+const uint8_t SUSI_FRAME_BITS = 26;
+
+/**
+ * @brief Encodes a packet into the levels of the data line, one bit per clock.
+ * @details Bit 0 is the LOW start bit, bits 1-24 are the address, command and
+ * data bytes LSB first and bit 25 is the HIGH stop bit.
+ * @param packet The packet to encode.
+ * @return uint32_t The frame, bit i is the data level at the i-th clock.
+ */
+uint32_t susiEncodeFrame(const SUSI_Packet& packet);
+
+/**
+ * @brief Decodes a frame produced by susiEncodeFrame().
+ * @param frame The frame, bit i is the data level at the i-th clock.
+ * @param packet A reference to a packet to store the result in.
+ * @return bool Whether the start and stop bits are valid.
+ */
+bool susiDecodeFrame(uint32_t frame, SUSI_Packet& packet);
+
+/**
+ * @brief A function that is called repeatedly while the master waits for a
+ * sync gap, to do useful work instead of a busy delay.
+ * @details It should return within a fraction of a millisecond, so that the
+ * next packet is not held back much past the end of the gap.
+ * @param context The context given to SusiTransport::onIdle().
+ */
+typedef void (*SusiIdleHook)(void* context);
+
+/**
+ * @brief The packet-level link between the SUSI master and the bus.
+ * @details SUSI_Master only deals in packets and response bytes; how they get
+ * onto the bus is up to the transport. The library provides a bit-banged
+ * transport on top of a SusiHAL, an SPI transport and a loopback transport.
+ */
+class SusiTransport {
+public:
+    /**
+     * @brief Destroy the SusiTransport object
+     */
+    virtual ~SusiTransport() = default;
+
+    /**
+     * @brief Initializes the transport and puts the bus into its idle state.
+     */
+    virtual void begin() = 0;
+
+    /**
+     * @brief Sends a packet, including the sync gaps required by RCN-600.
+     * @param packet The packet to send.
+     * @param expectAck Whether to wait for the acknowledge of the slave.
+     * @return SusiMasterResult A result code indicating the status of the operation.
+     */
+    virtual SusiMasterResult sendPacket(const SUSI_Packet& packet, bool expectAck) = 0;
+
+    /**
+     * @brief Gets the time until a packet can be sent without waiting for a
+     * sync gap.
+     * @details RCN-600 requires a gap of 9 ms after 20 commands, or after 50
+     * when all commands since the last gap read a CV bank, and before a packet
+     * that follows more than 7 ms of idle bus. The gap is measured from the last
+     * clock of the master, the end of a packet or of a response byte, so idle
+     * time counts toward it. An application can
+     * call this instead of blocking in sendPacket().
+     * @param packet The packet to send next.
+     * @return uint32_t The time in microseconds, 0 if it can be sent now.
+     */
+    uint32_t syncGapRemaining(const SUSI_Packet& packet) const;
+
+    /**
+     * @brief Sets a function to call while waiting for a sync gap.
+     * @details Without a hook the transport sleeps on its clock.
+     * @param hook The function, or nullptr.
+     * @param context A pointer that is passed to the hook.
+     */
+    void onIdle(SusiIdleHook hook, void* context = nullptr);
+
+    /**
+     * @brief Sets the time base of the sync gaps and of the ACK timing.
+     * @details Transports on a SusiHAL set the clock of the HAL too.
+     * @param clock The clock, which must outlive the transport.
+     */
+    virtual void setClock(SusiClock& clock) { _clock = &clock; }
+
+    /**
+     * @brief Sets how long the following packets wait for their ACK to start.
+     * @param timeout_us The timeout in microseconds, at most SUSI_ACK_TIMEOUT_US.
+     */
+    void setAckTimeout(uint32_t timeout_us) { _ack_timeout_us = timeout_us; }
+
+    /**
+     * @brief Gets the time the last acknowledged packet waited for its ACK to start.
+     * @return uint32_t The time in microseconds, 0 if the transport does not
+     * measure it.
+     */
+    uint32_t ackLatency() const { return _ack_latency_us; }
+
+    /**
+     * @brief Reads a byte the slave puts on the data line, clocking it LSB first.
+     * @return uint8_t The byte read from the bus.
+     */
+    virtual uint8_t readByte() = 0;
+
+    /**
+     * @brief Generates a single clock pulse.
+     */
+    virtual void clockPulse() = 0;
+
+protected:
+    SusiTransport();
+
+    /**
+     * @brief Waits for the sync gap before a packet where RCN-600 requires one,
+     * calling the idle hook in the meantime.
+     * @param packet The packet to send next.
+     */
+    void waitForSyncGap(const SUSI_Packet& packet);
+
+    /**
+     * @brief Records that a packet was sent, for the sync gap timing.
+     */
+    void packetSent();
+
+    /**
+     * @brief Records that the master clocked the bus outside a packet, e.g. for
+     * a response byte, so that the time does not count as idle bus.
+     */
+    void busClocked();
+
+    /**
+     * @brief The time base of the transport.
+     */
+    SusiClock* _clock;
+
+    /**
+     * @brief The ACK timeout set with setAckTimeout().
+     */
+    uint32_t _ack_timeout_us;
+
+    /**
+     * @brief The latency of the last ACK, for ackLatency().
+     */
+    uint32_t _ack_latency_us;
+
+private:
+    static bool isBankRead(const SUSI_Packet& packet);
+
+    uint32_t _last_clock_time_us; // End of the last packet or response byte
+    uint8_t _packets_since_sync;
+    bool _bank_reads_only; // All commands since the last sync gap read a CV bank
+    SusiIdleHook _idle_hook;
+    void* _idle_context;
+};
+
+#endif // SUSI_TRANSPORT_H
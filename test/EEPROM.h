@@ -4,17 +4,28 @@
 #include <cstdint>
 #include <vector>
 #include <cstring> // For memcpy
+#include <algorithm>
+#include "mock_hal.h"
 
 class EEPROMClass {
 public:
-    EEPROMClass() : _data(512, 0xFF) {} // Simulate 512 bytes of EEPROM, initialized to 0xFF
+    EEPROMClass() : _data(512, 0xFF), _write_counts(512, 0) {} // Simulate 512 bytes of EEPROM, initialized to 0xFF
+
+    uint16_t length() const {
+        return _data.size();
+    }
 
     uint8_t read(int address) {
+        mock_micros_time += read_latency_us;
+        _reads++;
         return _data[address];
     }
 
     void write(int address, uint8_t value) {
+        // A real EEPROM cell write blocks the CPU (about 3.3ms on AVR).
+        mock_micros_time += write_latency_us;
         _data[address] = value;
+        _write_counts[address]++;
     }
 
     // Overload for different data types
@@ -22,13 +33,16 @@ public:
     const T& put(int address, const T& value) {
         const uint8_t* ptr = (const uint8_t*)&value;
         for (size_t i = 0; i < sizeof(T); ++i) {
-            _data[address + i] = ptr[i];
+            write(address + i, ptr[i]);
         }
         return value;
     }
 
     template<typename T>
     T& get(int address, T& value) {
+        // A block read pays the access setup once.
+        mock_micros_time += read_latency_us;
+        _reads++;
         uint8_t* ptr = (uint8_t*)&value;
         for (size_t i = 0; i < sizeof(T); ++i) {
             ptr[i] = _data[address + i];
@@ -36,8 +50,40 @@ public:
         return value;
     }
 
+    // Simulated duration of a single byte write, in microseconds.
+    unsigned long write_latency_us = 0;
+
+    // Simulated setup time of a single read() or get() call, in microseconds.
+    unsigned long read_latency_us = 0;
+
+    // --- Test helpers ---
+
+    // Erase all cells and reset the wear counters.
+    void clear() {
+        std::fill(_data.begin(), _data.end(), 0xFF);
+        std::fill(_write_counts.begin(), _write_counts.end(), 0);
+        _reads = 0;
+    }
+
+    // Number of times a cell has been written.
+    uint32_t writeCount(int address) const {
+        return _write_counts[address];
+    }
+
+    // Number of read() and get() calls since the last clear().
+    uint32_t readCount() const {
+        return _reads;
+    }
+
+    // Highest write count of any cell.
+    uint32_t maxWriteCount() const {
+        return *std::max_element(_write_counts.begin(), _write_counts.end());
+    }
+
 private:
     std::vector<uint8_t> _data;
+    std::vector<uint32_t> _write_counts;
+    uint32_t _reads = 0;
 };
 
 extern EEPROMClass EEPROM;
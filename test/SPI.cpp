@@ -0,0 +1,56 @@
+#include "SPI.h"
+
+SPIClass SPI;
+
+void SPIClass::begin() {
+    enabled = true;
+}
+
+void SPIClass::end() {
+    enabled = false;
+}
+
+void SPIClass::beginTransaction(SPISettings new_settings) {
+    settings = new_settings;
+}
+
+void SPIClass::endTransaction() {
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    transferred.push_back(data);
+    if (!_attached) {
+        return 0xFF;
+    }
+
+    // Half a clock period in microseconds
+    unsigned int half_clock_us = 500000 / settings.clock;
+    uint8_t received = 0;
+    for (int i = 0; i < 8; i++) {
+        int bit = settings.bitOrder == LSBFIRST ? i : 7 - i;
+        digitalWrite(_mosi, (data >> bit) & 0x01 ? HIGH : LOW);
+        // Mode 2: sample on the falling (leading) edge, shift on the rising edge
+        digitalWrite(_sck, LOW);
+        if (pin_states.count(_miso) == 0 || pin_states[_miso] == HIGH) {
+            received |= 1 << bit;
+        }
+        delayMicroseconds(half_clock_us);
+        digitalWrite(_sck, HIGH);
+        delayMicroseconds(half_clock_us);
+    }
+    return received;
+}
+
+void SPIClass::attachPins(uint8_t sck, uint8_t mosi, uint8_t miso) {
+    _sck = sck;
+    _mosi = mosi;
+    _miso = miso;
+    _attached = true;
+}
+
+void SPIClass::reset() {
+    transferred.clear();
+    settings = SPISettings();
+    enabled = false;
+    _attached = false;
+}
@@ -0,0 +1,58 @@
+#ifndef MOCK_SPI_H
+#define MOCK_SPI_H
+
+#include <cstdint>
+#include <vector>
+#include "mock_hal.h"
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings {
+public:
+    SPISettings() : clock(4000000), bitOrder(MSBFIRST), dataMode(SPI_MODE0) {}
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+        : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+};
+
+// Shifts the bytes out on mock pins, so the clock interrupts of slaves fire.
+// Only the CPOL=1 modes are clocked, which is what the SUSI bus uses.
+class SPIClass {
+public:
+    void begin();
+    void end();
+    void beginTransaction(SPISettings settings);
+    void endTransaction();
+    uint8_t transfer(uint8_t data);
+
+    // --- Test helpers ---
+
+    // Route SCK, MOSI and MISO to mock pins.
+    void attachPins(uint8_t sck, uint8_t mosi, uint8_t miso);
+
+    // Bytes sent since the last reset().
+    std::vector<uint8_t> transferred;
+    SPISettings settings;
+    bool enabled = false;
+
+    void reset();
+
+private:
+    uint8_t _sck = 0;
+    uint8_t _mosi = 0;
+    uint8_t _miso = 0;
+    bool _attached = false;
+};
+
+extern SPIClass SPI;
+
+#endif // MOCK_SPI_H
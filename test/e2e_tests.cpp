@@ -3,6 +3,7 @@
 #include "susi_slave.h"
 #include "mock_hal.h"
 #include "mock_susi_hal.h"
+#include "mock_susi_transport.h"
 #include "susi_commands.h"
 
 // Test fixture for End-to-End tests
@@ -21,7 +22,6 @@ protected:
 
     void SetUp() override {
         mock_hal_reset();
-        _susi_slave_instance = &slave;
         api.begin();
         slave.begin(SLAVE_ADDRESS);
         // Set initial clock state to HIGH
@@ -48,14 +48,14 @@ TEST_F(EndToEndTest, TrueEndToEnd_SendAndReceiveSetSpeedPacket) {
 class HandshakeE2ETest : public ::testing::Test {
 protected:
     MockSusiHAL hal;
+    MockSusiTransport transport;
     SUSI_Master master;
     SUSI_Master_API api;
     SUSI_Slave slave;
 
-    HandshakeE2ETest() : master(hal), api(master), slave(hal) {}
+    HandshakeE2ETest() : transport(hal), master(transport), api(master), slave(hal) {}
 
     void SetUp() override {
-        _susi_slave_instance = &slave;
         api.begin();
         slave.begin(1);
         api.reset();
@@ -63,15 +63,15 @@ protected:
 };
 
 TEST_F(HandshakeE2ETest, MockedEndToEnd_PerformHandshake) {
-    hal.onSendPacket = [&](const SUSI_Packet& packet, bool expectAck) {
+    transport.onSendPacket = [&](const SUSI_Packet& packet, bool expectAck) {
         slave._test_receive_packet(packet);
     };
 
-    hal.afterSendPacket = [&]() {
+    transport.afterSendPacket = [&]() {
         if (slave.available()) {
             slave.read();
         }
-        hal.ack_result = SUCCESS;
+        transport.ack_result = SUCCESS;
     };
 
     api.performHandshake();
@@ -0,0 +1,23 @@
+#ifndef MOCK_CLOCK_H
+#define MOCK_CLOCK_H
+
+#include "susi_clock.h"
+
+// A clock in virtual time: it only moves when the code under test waits or
+// the test advances it, independent of mock_hal's time.
+class MockClock : public SusiClock {
+public:
+    explicit MockClock(uint32_t start_us = 0) : now_us(start_us) {}
+
+    uint32_t now_us;
+    uint32_t delayed_us = 0;
+
+    uint32_t nowMicros() override { return now_us; }
+
+    void delayMicros(uint32_t us) override {
+        now_us += us;
+        delayed_us += us;
+    }
+};
+
+#endif // MOCK_CLOCK_H
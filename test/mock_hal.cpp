@@ -11,7 +11,8 @@ std::map<uint8_t, int> isr_mode_map;
 unsigned long mock_micros_time = 0;
 unsigned long ack_pulse_start_time = 0;
 unsigned long ack_pulse_duration = 0;
-std::vector<int> digitalRead_return_sequence;
+std::deque<int> digitalRead_return_sequence;
+MockHalBackend* mock_hal_backend = nullptr;
 
 void noInterrupts() {
     // Not implemented for mock
@@ -22,35 +23,50 @@ void interrupts() {
 }
 
 void pinMode(uint8_t pin, uint8_t mode) {
+    if (mock_hal_backend) {
+        mock_hal_backend->pinMode(pin, mode);
+        return;
+    }
     pin_modes[pin] = mode;
 }
 
 void digitalWrite(uint8_t pin, uint8_t val) {
-    // Log the call
-    digitalWrite_calls.push_back({pin, val});
-
-    // Check for a falling edge to trigger an ISR
-    if (pin_states.count(pin) && pin_states[pin] == HIGH && val == LOW) {
-        if (isr_map.count(pin) && isr_mode_map[pin] == FALLING) {
-            if (isr_map[pin] != nullptr) {
-                isr_map[pin]();
-            }
-        }
+    if (mock_hal_backend) {
+        mock_hal_backend->digitalWrite(pin, val);
+        return;
     }
 
+    // Log the call
+    digitalWrite_calls.push_back({pin, val, mock_micros_time});
+
+    bool was_high = pin_states.count(pin) && pin_states[pin] == HIGH;
+    bool was_low = pin_states.count(pin) && pin_states[pin] == LOW;
+    // The new level is visible to the ISR, like on real hardware
     pin_states[pin] = val;
+
+    // Check for an edge to trigger an ISR
+    if (isr_map.count(pin) && isr_map[pin] != nullptr) {
+        int mode = isr_mode_map[pin];
+        bool falling = was_high && val == LOW;
+        bool rising = was_low && val == HIGH;
+        if ((falling && (mode == FALLING || mode == CHANGE)) ||
+            (rising && (mode == RISING || mode == CHANGE))) {
+            isr_map[pin]();
+        }
+    }
 }
 
 int digitalRead(uint8_t pin) {
+    if (mock_hal_backend) {
+        return mock_hal_backend->digitalRead(pin);
+    }
+
     if (!digitalRead_return_sequence.empty()) {
         int val = digitalRead_return_sequence.front();
-        digitalRead_return_sequence.erase(digitalRead_return_sequence.begin());
+        digitalRead_return_sequence.pop_front();
         return val;
     }
 
-    // Simulate the passage of time for polling loops
-    mock_micros_time += 10; // Advance time by 10us on each read
-
     // Simulate an ACK pulse
     if (pin == 3 && ack_pulse_duration > 0) {
         if (mock_micros_time >= ack_pulse_start_time &&
@@ -62,18 +78,28 @@ int digitalRead(uint8_t pin) {
 }
 
 void delayMicroseconds(unsigned int us) {
+    if (mock_hal_backend) {
+        mock_hal_backend->delayMicroseconds(us);
+        return;
+    }
     mock_micros_time += us;
 }
 
 void delay(unsigned long ms) {
-    // No-op for now
+    // Only a backend lets time pass, the plain mock keeps delay() a no-op
+    if (mock_hal_backend) {
+        mock_hal_backend->delayMicroseconds(ms * 1000);
+    }
 }
 
 unsigned long millis() {
-    return mock_micros_time / 1000;
+    return micros() / 1000;
 }
 
 unsigned long micros() {
+    if (mock_hal_backend) {
+        return mock_hal_backend->micros();
+    }
     return mock_micros_time;
 }
 
@@ -82,11 +108,24 @@ uint8_t digitalPinToInterrupt(uint8_t pin) {
 }
 
 void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+    if (mock_hal_backend) {
+        mock_hal_backend->attachInterrupt(interrupt, isr, mode);
+        return;
+    }
     // The interrupt number is the same as the pin number in our mock
     isr_map[interrupt] = isr;
     isr_mode_map[interrupt] = mode;
 }
 
+void detachInterrupt(uint8_t interrupt) {
+    if (mock_hal_backend) {
+        mock_hal_backend->detachInterrupt(interrupt);
+        return;
+    }
+    isr_map.erase(interrupt);
+    isr_mode_map.erase(interrupt);
+}
+
 void MockSerial::print(const char* s) {
     std::cout << s;
 }
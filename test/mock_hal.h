@@ -16,10 +16,17 @@ using uint32_t = std::uint32_t;
 #define OUTPUT 0x1
 #define INPUT_PULLUP 0x2
 
+#define CHANGE 1
 #define FALLING 2
+#define RISING 3
 
 #define IRAM_ATTR
 
+// Program memory is ordinary memory on the host
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+
 // Mock Arduino functions
 void noInterrupts();
 void interrupts();
@@ -32,6 +39,7 @@ unsigned long millis();
 unsigned long micros();
 uint8_t digitalPinToInterrupt(uint8_t pin);
 void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
 
 // Mock Serial object
 class MockSerial {
@@ -57,6 +65,7 @@ extern std::map<uint8_t, uint8_t> pin_states;
 struct Call {
     uint8_t pin;
     uint8_t value;
+    unsigned long time_us;
 };
 
 extern std::vector<Call> digitalWrite_calls;
@@ -75,7 +84,25 @@ extern unsigned long ack_pulse_start_time;
 extern unsigned long ack_pulse_duration;
 
 // --- Value sequencing ---
-extern std::vector<int> digitalRead_return_sequence;
+#include <deque>
+extern std::deque<int> digitalRead_return_sequence;
+
+// --- Backend ---
+// When a backend is installed, pin I/O, time and interrupts go to it instead of
+// the maps above. The bus simulator uses this to run several nodes on one bus.
+class MockHalBackend {
+public:
+    virtual ~MockHalBackend() = default;
+    virtual void pinMode(uint8_t pin, uint8_t mode) = 0;
+    virtual void digitalWrite(uint8_t pin, uint8_t val) = 0;
+    virtual int digitalRead(uint8_t pin) = 0;
+    virtual void delayMicroseconds(unsigned long us) = 0;
+    virtual unsigned long micros() = 0;
+    virtual void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) = 0;
+    virtual void detachInterrupt(uint8_t interrupt) = 0;
+};
+
+extern MockHalBackend* mock_hal_backend;
 
 
 #endif // MOCK_HAL_H
@@ -11,19 +11,18 @@ class MockSusiHAL : public SusiHAL {
 public:
     MockSusiHAL() : SusiHAL(0, 0) {}
 
-    std::function<void(const SUSI_Packet&, bool)> onSendPacket;
-    std::function<void()> afterSendPacket;
     std::function<void(uint8_t)> onSendByte;
-    SusiMasterResult ack_result = SUCCESS;
     std::queue<bool> read_bits;
+    int ack_count = 0;
 
-    void sendByte(uint8_t byte) override {
+    bool sendByte(uint8_t byte) override {
         if (onSendByte) {
             onSendByte(byte);
         }
         for (int i = 0; i < 8; i++) {
             read_bits.push((byte >> i) & 0x01);
         }
+        return true;
     }
     void begin() override {}
     void set_clock_high() override {}
@@ -32,6 +31,9 @@ public:
     void set_data_high() override {}
     void set_data_low() override {}
     bool read_data() override { return false; }
+    bool read_clock() override { return false; }
+    void sendAckFromISR() override {}
+    void release_data() override {}
     bool read_bit() override {
         if (read_bits.empty()) {
             return false;
@@ -40,8 +42,8 @@ public:
         read_bits.pop();
         return bit;
     }
-    SusiMasterResult waitForAck() override { return ack_result; }
-    void sendAck() override {}
+    SusiMasterResult waitForAck(uint32_t) override { return SUCCESS; }
+    void sendAck() override { ack_count++; }
 };
 
 #endif // MOCK_SUSI_HAL_H
@@ -0,0 +1,50 @@
+#ifndef MOCK_SUSI_TRANSPORT_H
+#define MOCK_SUSI_TRANSPORT_H
+
+#include "susi_transport.h"
+#include "mock_susi_hal.h"
+#include <functional>
+
+// Packet-level test double for the master. Response bytes are read from the
+// bits a slave sent through the MockSusiHAL.
+class MockSusiTransport : public SusiTransport {
+public:
+    MockSusiTransport(MockSusiHAL& hal) : _hal(hal) {}
+
+    std::function<void(const SUSI_Packet&, bool)> onSendPacket;
+    std::function<void()> afterSendPacket;
+    SusiMasterResult ack_result = SUCCESS;
+    uint32_t ack_latency_us = 0;
+    uint32_t ack_timeout_us = 0; // The ACK timeout of the last packet
+
+    void begin() override {}
+
+    SusiMasterResult sendPacket(const SUSI_Packet& packet, bool expectAck) override {
+        if (onSendPacket) {
+            onSendPacket(packet, expectAck);
+        }
+        if (afterSendPacket) {
+            afterSendPacket();
+        }
+        ack_timeout_us = _ack_timeout_us;
+        _ack_latency_us = ack_latency_us;
+        return ack_result;
+    }
+
+    uint8_t readByte() override {
+        uint8_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            if (_hal.read_bit()) {
+                value |= (1 << i);
+            }
+        }
+        return value;
+    }
+
+    void clockPulse() override {}
+
+private:
+    MockSusiHAL& _hal;
+};
+
+#endif // MOCK_SUSI_TRANSPORT_H
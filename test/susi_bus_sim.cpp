@@ -0,0 +1,488 @@
+#include "susi_bus_sim.h"
+#include <algorithm>
+#include <cstdlib>
+
+// Pins are handed out in pairs from here, clear of the pins the other tests use
+const uint8_t SIM_FIRST_PIN = 40;
+
+// Transitions are pruned from the driver histories every this many events
+const uint32_t SIM_PRUNE_INTERVAL = 1024;
+
+// Stack of the fiber that runs a node's main loop
+const size_t SIM_FIBER_STACK_SIZE = 256 * 1024;
+
+SusiSimNode::SusiSimNode(uint8_t index, uint8_t clock_pin, uint8_t data_pin) {
+    _index = index;
+    _clock_pin = clock_pin;
+    _data_pin = data_pin;
+    _now_ns = 0;
+    _drift_ppm = 0;
+    for (int line = 0; line < 2; line++) {
+        _output[line] = false;
+        _latch_low[line] = false;
+    }
+    _isr = nullptr;
+    _isr_line = -1;
+    _isr_mode = 0;
+    _in_isr = false;
+    _isr_busy_until_ns = 0;
+    _pending_interrupt_taken = false;
+    _fiber_started = false;
+    _in_loop = false;
+    _wake_pending = false;
+    _wake_scheduled = false;
+}
+
+void SusiSimNode::setLoop(std::function<void()> loop, std::function<bool()> ready) {
+    _loop = loop;
+    _loop_ready = ready;
+}
+
+SusiBusSim::SusiBusSim(const SusiBusSimConfig& config) : _config(config) {
+    _current = nullptr;
+    _running_fiber = nullptr;
+    _root_node = nullptr;
+    _seq = 0;
+    _rng = config.seed != 0 ? config.seed : 1;
+    _prune_countdown = SIM_PRUNE_INTERVAL;
+    mock_hal_backend = this;
+}
+
+SusiBusSim::~SusiBusSim() {
+    // Main loops still waiting in their fibers are dropped without unwinding.
+    if (mock_hal_backend == this) {
+        mock_hal_backend = nullptr;
+    }
+}
+
+SusiSimNode& SusiBusSim::addNode() {
+    uint8_t index = _nodes.size();
+    uint8_t clock_pin = SIM_FIRST_PIN + 2 * index;
+    _nodes.emplace_back(new SusiSimNode(index, clock_pin, clock_pin + 1));
+    SusiSimNode& node = *_nodes.back();
+    if (_current == nullptr) {
+        _current = &node;
+        _root_node = &node;
+    } else {
+        node._now_ns = _current->_now_ns;
+    }
+    return node;
+}
+
+void SusiBusSim::runOn(SusiSimNode& node, const std::function<void()>& fn) {
+    SusiSimNode* previous = _root_node;
+    if (node._now_ns < previous->_now_ns) {
+        node._now_ns = previous->_now_ns;
+    }
+    _root_node = &node;
+    _current = &node;
+    fn();
+    _root_node = previous;
+    _current = previous;
+    advance(node._now_ns);
+}
+
+void SusiBusSim::runFor(unsigned long us) {
+    advance(_current->_now_ns + (uint64_t)us * 1000);
+}
+
+void SusiBusSim::startTimer(SusiSimNode& node, unsigned long us, std::function<void()> fn) {
+    _timers[_seq] = fn;
+    schedule(node._now_ns + (uint64_t)us * 1000, TIMER, node._index, false, false);
+}
+
+bool SusiBusSim::clockLevel() const {
+    return !lineLow(CLOCK_LINE, _current->_now_ns);
+}
+
+bool SusiBusSim::dataLevel() const {
+    return !lineLow(DATA_LINE, _current->_now_ns);
+}
+
+uint64_t SusiBusSim::now() const {
+    return _current != nullptr ? _current->_now_ns : 0;
+}
+
+void SusiBusSim::pinMode(uint8_t pin, uint8_t mode) {
+    SusiSimNode* node;
+    Line line;
+    if (!findPin(pin, node, line)) {
+        return;
+    }
+    node->_output[line] = mode == OUTPUT;
+    drive(*node, line, node->_output[line] && node->_latch_low[line]);
+}
+
+void SusiBusSim::digitalWrite(uint8_t pin, uint8_t val) {
+    SusiSimNode* node;
+    Line line;
+    if (!findPin(pin, node, line)) {
+        return;
+    }
+    node->_latch_low[line] = val == LOW;
+    drive(*node, line, node->_output[line] && node->_latch_low[line]);
+}
+
+int SusiBusSim::digitalRead(uint8_t pin) {
+    SusiSimNode* node;
+    Line line;
+    bool high = true;
+    if (findPin(pin, node, line)) {
+        high = !lineLow(line, _current->_now_ns);
+        if (_config.read_error_rate > 0.0 &&
+            random() < _config.read_error_rate * 4294967296.0) {
+            high = !high;
+            _stats.corrupted_reads++;
+        }
+    }
+    advance(_current->_now_ns + _config.read_cost_ns);
+    return high ? HIGH : LOW;
+}
+
+void SusiBusSim::delayMicroseconds(unsigned long us) {
+    // A fast crystal makes the node's delays shorter in bus time
+    uint64_t ns = (uint64_t)us * 1000 * 1000000 / (1000000 + _current->_drift_ppm);
+    advance(_current->_now_ns + ns);
+}
+
+unsigned long SusiBusSim::micros() {
+    uint64_t now = _current->_now_ns;
+    int64_t drift = (int64_t)now / 1000000 * _current->_drift_ppm;
+    return (unsigned long)((now + drift) / 1000);
+}
+
+void SusiBusSim::attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+    SusiSimNode* node;
+    Line line;
+    // The interrupt number is the pin number, like in mock_hal
+    if (findPin(interrupt, node, line)) {
+        node->_isr = isr;
+        node->_isr_line = line;
+        node->_isr_mode = mode;
+    }
+}
+
+void SusiBusSim::detachInterrupt(uint8_t interrupt) {
+    SusiSimNode* node;
+    Line line;
+    if (findPin(interrupt, node, line) && node->_isr_line == line) {
+        node->_isr = nullptr;
+        node->_isr_line = -1;
+    }
+}
+
+bool SusiBusSim::findPin(uint8_t pin, SusiSimNode*& node, Line& line) const {
+    if (pin < SIM_FIRST_PIN || (size_t)(pin - SIM_FIRST_PIN) / 2 >= _nodes.size()) {
+        return false;
+    }
+    node = _nodes[(pin - SIM_FIRST_PIN) / 2].get();
+    line = (pin - SIM_FIRST_PIN) % 2 == 0 ? CLOCK_LINE : DATA_LINE;
+    return true;
+}
+
+void SusiBusSim::drive(SusiSimNode& node, Line line, bool low) {
+    std::deque<SusiSimNode::Transition>& history = node._drive[line];
+    uint64_t last_ns = history.empty() ? 0 : history.back().time_ns;
+    bool was_low = !history.empty() && history.back().low;
+    if (low == was_low) {
+        return;
+    }
+
+    uint64_t time_ns = node._now_ns + _config.propagation_ns;
+    if (_config.jitter_ns > 0) {
+        time_ns += random() % (_config.jitter_ns + 1);
+    }
+    if (time_ns < last_ns) {
+        time_ns = last_ns; // Jitter must not reorder the node's own changes
+    }
+
+    bool line_was_low = lineLow(line, time_ns);
+    history.push_back({time_ns, low});
+    bool line_low = lineLow(line, time_ns);
+    if (line_low == line_was_low) {
+        return; // Another node holds the line LOW
+    }
+    if (_config.record_activity) {
+        _activity.push_back({time_ns, (uint8_t)line, line_low});
+    }
+
+    for (size_t i = 0; i < _nodes.size(); i++) {
+        if (_nodes[i]->_isr != nullptr && _nodes[i]->_isr_line == line) {
+            schedule(time_ns, EDGE, i, !line_low, false);
+        }
+    }
+}
+
+bool SusiBusSim::lineLow(Line line, uint64_t time_ns) const {
+    for (size_t i = 0; i < _nodes.size(); i++) {
+        if (drivenLow(*_nodes[i], line, time_ns)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SusiBusSim::drivenLow(const SusiSimNode& node, Line line, uint64_t time_ns) {
+    // Reads are mostly at the end of the history, so search from the back
+    const std::deque<SusiSimNode::Transition>& history = node._drive[line];
+    for (size_t i = history.size(); i > 0; i--) {
+        if (history[i - 1].time_ns <= time_ns) {
+            return history[i - 1].low;
+        }
+    }
+    return false;
+}
+
+void SusiBusSim::advance(uint64_t target_ns) {
+    SusiSimNode& node = *_current;
+
+    // Interrupts are disabled in an interrupt handler, it only burns its own
+    // time. Without events before the target, nothing else has to run.
+    if (node._in_isr || _queue.empty() || _queue.top().time_ns > target_ns) {
+        if (node._now_ns < target_ns) {
+            node._now_ns = target_ns;
+        }
+        return;
+    }
+
+    schedule(target_ns, RESUME, node._index, false, _running_fiber == nullptr);
+    runEvents(false);
+}
+
+void SusiBusSim::runEvents(bool idle) {
+    // Runs events until the waiting code may go on, or until another fiber takes
+    // over. A fiber only gets control back through its RESUME or, when idle,
+    // its WAKE event.
+    SusiSimNode* self = _running_fiber;
+    for (;;) {
+        if (_queue.empty()) {
+            abort(); // The test code always waits for a RESUME
+        }
+        Event event = _queue.top();
+        _queue.pop();
+        _stats.events++;
+        if (--_prune_countdown == 0) {
+            _prune_countdown = SIM_PRUNE_INTERVAL;
+            prune();
+        }
+
+        SusiSimNode& node = *_nodes[event.node];
+        switch (event.type) {
+            case EDGE:
+                runInterrupt(event);
+                break;
+            case TIMER:
+                runTimer(event);
+                break;
+            case WAKE:
+                node._wake_scheduled = false;
+                if (node._in_loop) {
+                    node._wake_pending = true;
+                    break;
+                }
+                if (node._now_ns < event.time_ns) {
+                    node._now_ns = event.time_ns;
+                }
+                if (&node == self) {
+                    _current = &node;
+                    return;
+                }
+                switchTo(&node, node);
+                return;
+            case RESUME:
+                if (node._now_ns > event.time_ns) {
+                    // An interrupt ran past the end of the wait
+                    schedule(node._now_ns, RESUME, event.node, false, event.root);
+                    break;
+                }
+                node._now_ns = event.time_ns;
+                if (!idle && (event.root ? self == nullptr : self == &node)) {
+                    _current = &node;
+                    return;
+                }
+                switchTo(event.root ? nullptr : &node, node);
+                return;
+        }
+    }
+}
+
+void SusiBusSim::runInterrupt(const Event& event) {
+    SusiSimNode& node = *_nodes[event.node];
+    if (node._isr == nullptr) {
+        return;
+    }
+    int mode = node._isr_mode;
+    if (!(mode == CHANGE || (mode == RISING && event.rising) || (mode == FALLING && !event.rising))) {
+        return;
+    }
+
+    // Edges while the last handler was busy set a single pending flag
+    bool late = event.time_ns < node._isr_busy_until_ns;
+    if (late) {
+        if (node._pending_interrupt_taken) {
+            _stats.missed_edges++;
+            return;
+        }
+        node._pending_interrupt_taken = true;
+    }
+
+    if (node._now_ns < event.time_ns) {
+        node._now_ns = event.time_ns;
+    }
+    uint64_t start_ns = node._now_ns;
+    SusiSimNode* previous = _current;
+    _current = &node;
+    node._in_isr = true;
+    node._isr();
+    node._in_isr = false;
+    _stats.interrupts++;
+
+    if (late) {
+        node._isr_busy_until_ns = node._now_ns;
+    } else if (node._now_ns > start_ns) {
+        node._isr_busy_until_ns = node._now_ns;
+        node._pending_interrupt_taken = false;
+    }
+
+    if (node._loop && !node._wake_scheduled && (!node._loop_ready || node._loop_ready())) {
+        node._wake_scheduled = true;
+        schedule(node._now_ns + _config.loop_latency_ns, WAKE, event.node, false, false);
+    }
+    _current = previous;
+}
+
+void SusiBusSim::runTimer(const Event& event) {
+    std::function<void()> fn = _timers[event.seq];
+    _timers.erase(event.seq);
+
+    SusiSimNode& node = *_nodes[event.node];
+    if (node._now_ns < event.time_ns) {
+        node._now_ns = event.time_ns;
+    }
+    SusiSimNode* previous = _current;
+    _current = &node;
+    bool in_isr = node._in_isr;
+    node._in_isr = true;
+    fn();
+    node._in_isr = in_isr;
+    _current = previous;
+}
+
+void SusiBusSim::switchTo(SusiSimNode* fiber, SusiSimNode& node) {
+    ucontext_t* from = _running_fiber != nullptr ? &_running_fiber->_context : &_root_context;
+    _running_fiber = fiber;
+    _current = &node;
+
+    if (fiber != nullptr && !fiber->_fiber_started) {
+        uintptr_t sim = (uintptr_t)this;
+        fiber->_stack.resize(SIM_FIBER_STACK_SIZE);
+        getcontext(&fiber->_context);
+        fiber->_context.uc_stack.ss_sp = fiber->_stack.data();
+        fiber->_context.uc_stack.ss_size = fiber->_stack.size();
+        fiber->_context.uc_link = nullptr;
+        makecontext(&fiber->_context, (void (*)())fiberEntry, 3, (unsigned int)(sim >> 32),
+                    (unsigned int)(sim & 0xFFFFFFFF), (unsigned int)fiber->_index);
+        fiber->_fiber_started = true;
+    }
+
+    _stats.switches++;
+    swapcontext(from, fiber != nullptr ? &fiber->_context : &_root_context);
+}
+
+void SusiBusSim::fiberEntry(unsigned int sim_high, unsigned int sim_low, unsigned int index) {
+    SusiBusSim* sim = (SusiBusSim*)(((uintptr_t)sim_high << 32) | sim_low);
+    sim->fiberMain(*sim->_nodes[index]);
+}
+
+void SusiBusSim::fiberMain(SusiSimNode& node) {
+    // The fiber never returns; it is dropped with the simulator.
+    for (;;) {
+        node._in_loop = true;
+        do {
+            node._wake_pending = false;
+            node._loop();
+            _stats.loop_runs++;
+        } while (node._wake_pending);
+        node._in_loop = false;
+        runEvents(true);
+    }
+}
+
+uint64_t SusiBusSim::busyTime(uint64_t from_ns, uint64_t to_ns, uint32_t idle_gap_ns) const {
+    // Edges of different nodes are logged in the order the nodes ran, not in
+    // time order
+    std::vector<WireEdge> edges(_activity);
+    std::stable_sort(edges.begin(), edges.end(),
+                     [](const WireEdge& a, const WireEdge& b) { return a.time_ns < b.time_ns; });
+
+    uint64_t busy_ns = 0;
+    bool low[2] = {false, false};
+    for (size_t i = 0; i < edges.size(); i++) {
+        low[edges[i].line] = edges[i].low;
+        uint64_t start_ns = edges[i].time_ns;
+        uint64_t end_ns = i + 1 < edges.size() ? edges[i + 1].time_ns : to_ns;
+        bool busy = low[CLOCK_LINE] || low[DATA_LINE] ||
+                    (i + 1 < edges.size() && end_ns - start_ns <= idle_gap_ns);
+        start_ns = std::max(start_ns, from_ns);
+        end_ns = std::min(end_ns, to_ns);
+        if (busy && end_ns > start_ns) {
+            busy_ns += end_ns - start_ns;
+        }
+    }
+    return busy_ns;
+}
+
+std::vector<uint64_t> SusiBusSim::clockPauses(uint64_t from_ns, uint64_t to_ns, uint64_t min_ns) const {
+    std::vector<uint64_t> times;
+    for (const WireEdge& edge : _activity) {
+        if (edge.line == CLOCK_LINE && edge.time_ns >= from_ns && edge.time_ns < to_ns) {
+            times.push_back(edge.time_ns);
+        }
+    }
+    std::sort(times.begin(), times.end());
+
+    std::vector<uint64_t> pauses;
+    for (size_t i = 1; i < times.size(); i++) {
+        if (times[i] - times[i - 1] > min_ns) {
+            pauses.push_back(times[i] - times[i - 1]);
+        }
+    }
+    return pauses;
+}
+
+void SusiBusSim::prune() {
+    // Nothing reads the lines before the running code or the next event any more
+    uint64_t floor_ns = _current->_now_ns;
+    if (!_queue.empty() && _queue.top().time_ns < floor_ns) {
+        floor_ns = _queue.top().time_ns;
+    }
+    uint64_t margin_ns = (uint64_t)_config.propagation_ns + _config.jitter_ns;
+    floor_ns = floor_ns > margin_ns ? floor_ns - margin_ns : 0;
+    for (size_t i = 0; i < _nodes.size(); i++) {
+        for (int line = 0; line < 2; line++) {
+            std::deque<SusiSimNode::Transition>& history = _nodes[i]->_drive[line];
+            while (history.size() > 1 && history[1].time_ns <= floor_ns) {
+                history.pop_front();
+            }
+        }
+    }
+}
+
+void SusiBusSim::schedule(uint64_t time_ns, EventType type, uint8_t node, bool rising, bool root) {
+    Event event;
+    event.time_ns = time_ns;
+    event.seq = _seq++;
+    event.type = type;
+    event.node = node;
+    event.rising = rising;
+    event.root = root;
+    _queue.push(event);
+}
+
+uint32_t SusiBusSim::random() {
+    // xorshift32, deterministic for a given seed
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    return _rng;
+}
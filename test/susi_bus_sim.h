@@ -0,0 +1,235 @@
+#ifndef SUSI_BUS_SIM_H
+#define SUSI_BUS_SIM_H
+
+#include "mock_hal.h"
+#include "susi_hal.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <ucontext.h>
+#include <vector>
+
+// Discrete-event simulation of a SUSI bus: a clock and a data line shared by a
+// master and any number of slaves, all running the real library code.
+//
+// Both lines are open drain with a pull-up (wired-AND): a line is LOW while any
+// node drives it LOW. Driving HIGH or switching to INPUT releases it. A level
+// change reaches the wire after the propagation delay plus random jitter.
+//
+// Every node has its own virtual clock. The test code runs as the first node,
+// normally the master, and each slave's main loop runs in a fiber of its own.
+// Code runs until it waits (delay(), delayMicroseconds() or the CPU time
+// charged for a digitalRead()); then the simulator runs whatever comes next in
+// virtual time: clock interrupts, main loops or the end of another node's wait.
+// An interrupt handler runs to completion, and if it busy-waits, edges in that
+// time collapse into one pending interrupt, like on an AVR. Idle time costs
+// nothing, so long stretches of bus time are simulated quickly.
+//
+// Creating a SusiBusSim routes the Arduino functions of mock_hal to it until it
+// is destroyed. Each node gets its own clock and data pin numbers for its
+// SusiHAL.
+
+// Timing and noise of the simulated bus.
+struct SusiBusSimConfig {
+    uint32_t propagation_ns = 100;     // From a driver to the wire
+    uint32_t jitter_ns = 0;            // Random extra delay per level change
+    uint32_t read_cost_ns = 1000;      // CPU time charged per digitalRead()
+    uint32_t loop_latency_ns = 5000;   // From an interrupt to the main loop running
+    double read_error_rate = 0.0;      // Probability that a read returns the wrong level
+    uint32_t seed = 1;
+    bool record_activity = false;      // Log the wire levels for busyTime()
+};
+
+// Counters of the simulation, for tests and benchmarks.
+struct SusiBusSimStats {
+    uint64_t events = 0;          // Events taken from the queue
+    uint64_t interrupts = 0;      // Clock interrupts run
+    uint64_t missed_edges = 0;    // Edges lost while an interrupt was pending
+    uint64_t loop_runs = 0;       // Main loop runs
+    uint64_t switches = 0;        // Switches between the test code and main loops
+    uint64_t corrupted_reads = 0; // Reads flipped by noise
+};
+
+class SusiBusSim;
+
+// A node on the bus, with its own pins and virtual clock.
+class SusiSimNode {
+public:
+    uint8_t clockPin() const { return _clock_pin; }
+    uint8_t dataPin() const { return _data_pin; }
+
+    // The virtual time of this node, in ns since the start of the simulation.
+    uint64_t now() const { return _now_ns; }
+
+    // Lets the node's crystal run fast (positive) or slow (negative).
+    void setClockDrift(int32_t ppm) { _drift_ppm = ppm; }
+
+    // Main loop of the node, run in its own fiber after an interrupt. If ready
+    // is given, the loop only runs when it returns true, e.g. when a slave has
+    // a packet available(), which saves switching to the fiber.
+    void setLoop(std::function<void()> loop, std::function<bool()> ready = nullptr);
+
+private:
+    friend class SusiBusSim;
+
+    struct Transition {
+        uint64_t time_ns;
+        bool low;
+    };
+
+    SusiSimNode(uint8_t index, uint8_t clock_pin, uint8_t data_pin);
+
+    uint8_t _index;
+    uint8_t _clock_pin;
+    uint8_t _data_pin;
+    uint64_t _now_ns;
+    int32_t _drift_ppm;
+
+    // Pin mode and written level of each line, and what the node drives on
+    // the line over time, oldest first
+    bool _output[2];
+    bool _latch_low[2];
+    std::deque<Transition> _drive[2];
+
+    // Clock interrupt attached to one of the node's pins
+    void (*_isr)();
+    int8_t _isr_line;
+    int _isr_mode;
+    bool _in_isr;
+    uint64_t _isr_busy_until_ns;
+    bool _pending_interrupt_taken;
+
+    // Main loop and its fiber
+    std::function<void()> _loop;
+    std::function<bool()> _loop_ready;
+    ucontext_t _context;
+    std::vector<char> _stack;
+    bool _fiber_started;
+    bool _in_loop;
+    bool _wake_pending;
+    bool _wake_scheduled;
+};
+
+class SusiBusSim : public MockHalBackend {
+public:
+    explicit SusiBusSim(const SusiBusSimConfig& config = SusiBusSimConfig());
+    ~SusiBusSim() override;
+
+    // Adds a node. The first node added runs the test code, normally the master.
+    SusiSimNode& addNode();
+
+    // Runs fn as code of the given node, e.g. to call a slave's API.
+    void runOn(SusiSimNode& node, const std::function<void()>& fn);
+
+    // Lets the test code wait, so the other nodes catch up.
+    void runFor(unsigned long us);
+
+    // Runs fn as an interrupt of the node after us microseconds of its time,
+    // like a one-shot hardware timer.
+    void startTimer(SusiSimNode& node, unsigned long us, std::function<void()> fn);
+
+    // The level of a line on the wire at the time of the current node.
+    bool clockLevel() const;
+    bool dataLevel() const;
+
+    uint64_t now() const;
+    const SusiBusSimStats& stats() const { return _stats; }
+
+    // Time in [from_ns, to_ns) in which the bus was busy: a line was LOW, or
+    // edges followed each other within idle_gap_ns. Needs record_activity.
+    uint64_t busyTime(uint64_t from_ns, uint64_t to_ns, uint32_t idle_gap_ns) const;
+
+    // The pauses between clock edges in [from_ns, to_ns) that are longer than
+    // min_ns, oldest first: the sync gaps the slaves see. Needs record_activity.
+    std::vector<uint64_t> clockPauses(uint64_t from_ns, uint64_t to_ns, uint64_t min_ns) const;
+
+    // MockHalBackend
+    void pinMode(uint8_t pin, uint8_t mode) override;
+    void digitalWrite(uint8_t pin, uint8_t val) override;
+    int digitalRead(uint8_t pin) override;
+    void delayMicroseconds(unsigned long us) override;
+    unsigned long micros() override;
+    void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) override;
+    void detachInterrupt(uint8_t interrupt) override;
+
+private:
+    enum Line { CLOCK_LINE = 0, DATA_LINE = 1 };
+
+    enum EventType { EDGE, WAKE, RESUME, TIMER };
+
+    struct Event {
+        uint64_t time_ns;
+        uint64_t seq;
+        EventType type;
+        uint8_t node;
+        bool rising;     // EDGE
+        bool root;       // RESUME: the test code, else the node's main loop
+    };
+
+    struct WireEdge {
+        uint64_t time_ns;
+        uint8_t line;
+        bool low;
+    };
+
+    struct EventLater {
+        bool operator()(const Event& a, const Event& b) const {
+            return a.time_ns != b.time_ns ? a.time_ns > b.time_ns : a.seq > b.seq;
+        }
+    };
+
+    bool findPin(uint8_t pin, SusiSimNode*& node, Line& line) const;
+    void drive(SusiSimNode& node, Line line, bool low);
+    bool lineLow(Line line, uint64_t time_ns) const;
+    static bool drivenLow(const SusiSimNode& node, Line line, uint64_t time_ns);
+    void advance(uint64_t target_ns);
+    void runEvents(bool idle);
+    void runInterrupt(const Event& event);
+    void runTimer(const Event& event);
+    void switchTo(SusiSimNode* fiber, SusiSimNode& node);
+    void fiberMain(SusiSimNode& node);
+    static void fiberEntry(unsigned int sim_high, unsigned int sim_low, unsigned int index);
+    void prune();
+    void schedule(uint64_t time_ns, EventType type, uint8_t node, bool rising, bool root);
+    uint32_t random();
+
+    SusiBusSimConfig _config;
+    std::vector<std::unique_ptr<SusiSimNode>> _nodes;
+    std::priority_queue<Event, std::vector<Event>, EventLater> _queue;
+    std::map<uint64_t, std::function<void()>> _timers; // By event seq
+
+    // The node whose code is running, the fiber running it (nullptr for the
+    // test code) and the node the test code runs as
+    SusiSimNode* _current;
+    SusiSimNode* _running_fiber;
+    SusiSimNode* _root_node;
+    ucontext_t _root_context;
+
+    uint64_t _seq;
+    uint32_t _rng;
+    uint32_t _prune_countdown;
+    SusiBusSimStats _stats;
+    std::vector<WireEdge> _activity;
+};
+
+// A SusiHAL on a simulated node whose ACK pulses are ended by a timer of the
+// node, so an ACK from the clock interrupt does not block the node.
+class SusiSimHAL : public SusiHAL {
+public:
+    SusiSimHAL(SusiBusSim& sim, SusiSimNode& node)
+        : SusiHAL(node.clockPin(), node.dataPin()), _sim(sim), _node(node) {}
+
+    bool startAckTimer(uint32_t us) override {
+        _sim.startTimer(_node, us, [this]() { finishAck(); });
+        return true;
+    }
+
+private:
+    SusiBusSim& _sim;
+    SusiSimNode& _node;
+};
+
+#endif // SUSI_BUS_SIM_H
@@ -2,16 +2,18 @@
 #include "susi_master.h"
 #include "susi_commands.h"
 #include "mock_susi_hal.h"
+#include "mock_susi_transport.h"
 
 TEST(SUSI_Master_API, setFunction) {
     MockSusiHAL hal;
-    SUSI_Master master(hal);
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
     SUSI_Master_API api(master);
-    hal.ack_result = SUCCESS;
+    transport.ack_result = SUCCESS;
 
     // Capture the packet that is sent
     SUSI_Packet sentPacket;
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool a) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool a) {
         sentPacket = p;
     };
 
@@ -24,13 +26,14 @@ TEST(SUSI_Master_API, setFunction) {
 
 TEST(SUSI_Master_API, setSpeed) {
     MockSusiHAL hal;
-    SUSI_Master master(hal);
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
     SUSI_Master_API api(master);
-    hal.ack_result = SUCCESS;
+    transport.ack_result = SUCCESS;
 
     // Capture the packet that is sent
     SUSI_Packet sentPacket;
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool a) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool a) {
         sentPacket = p;
     };
 
@@ -41,15 +44,93 @@ TEST(SUSI_Master_API, setSpeed) {
     EXPECT_EQ(sentPacket.data, 100); // Speed 100, backwards
 }
 
+TEST(SUSI_Master_API, setOutputsSendsOnlyChangedBytes) {
+    MockSusiHAL hal;
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
+    SUSI_Master_API api(master);
+    transport.ack_result = SUCCESS;
+
+    std::vector<SUSI_Packet> sentPackets;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool a) {
+        sentPackets.push_back(p);
+    };
+
+    // The first call sends all four bytes, low outputs first
+    EXPECT_EQ(api.setOutputs(10, 0x12345678), SUCCESS);
+    ASSERT_EQ(sentPackets.size(), 4);
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(sentPackets[i].address, 10);
+        EXPECT_EQ(sentPackets[i].command, SUSI_CMD_DIRECT_OUTPUTS + i);
+    }
+    EXPECT_EQ(sentPackets[0].data, 0x78);
+    EXPECT_EQ(sentPackets[3].data, 0x12);
+
+    sentPackets.clear();
+    EXPECT_EQ(api.setOutputs(10, 0x12FF5678), SUCCESS);
+    ASSERT_EQ(sentPackets.size(), 1);
+    EXPECT_EQ(sentPackets[0].command, SUSI_CMD_DIRECT_OUTPUTS + 2);
+    EXPECT_EQ(sentPackets[0].data, 0xFF);
+    EXPECT_EQ(api.getOutputs(10), 0x12FF5678u);
+
+    // A byte that was not acknowledged is sent again
+    sentPackets.clear();
+    transport.ack_result = TIMEOUT;
+    EXPECT_EQ(api.setOutputs(10, 0x00FF5678), TIMEOUT);
+    transport.ack_result = SUCCESS;
+    EXPECT_EQ(api.setOutputs(10, 0x00FF5678), SUCCESS);
+    EXPECT_EQ(sentPackets.size(), 2);
+}
+
+TEST(SUSI_Master_API, setBinaryStateUsesTheShortOrLongForm) {
+    MockSusiHAL hal;
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
+    SUSI_Master_API api(master);
+    transport.ack_result = SUCCESS;
+
+    std::vector<SUSI_Packet> sentPackets;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool a) {
+        sentPackets.push_back(p);
+    };
+
+    EXPECT_EQ(api.setBinaryState(10, 127, true), SUCCESS);
+    ASSERT_EQ(sentPackets.size(), 1);
+    EXPECT_EQ(sentPackets[0].command, SUSI_CMD_BINARY_STATE_SHORT);
+    EXPECT_EQ(sentPackets[0].data, 0xFF);
+
+    sentPackets.clear();
+    EXPECT_EQ(api.setBinaryState(10, 1000, true), SUCCESS); // 7 * 128 + 104
+    ASSERT_EQ(sentPackets.size(), 2);
+    EXPECT_EQ(sentPackets[0].command, SUSI_CMD_BINARY_STATE_LONG_L);
+    EXPECT_EQ(sentPackets[0].data, 0x80 | 104);
+    EXPECT_EQ(sentPackets[1].command, SUSI_CMD_BINARY_STATE_LONG_H);
+    EXPECT_EQ(sentPackets[1].data, 7);
+
+    // All states take the long form with state 0
+    sentPackets.clear();
+    EXPECT_EQ(api.setAllBinaryStates(10, true), SUCCESS);
+    ASSERT_EQ(sentPackets.size(), 2);
+    EXPECT_EQ(sentPackets[0].command, SUSI_CMD_BINARY_STATE_LONG_L);
+    EXPECT_EQ(sentPackets[0].data, 0x80);
+    EXPECT_EQ(sentPackets[1].command, SUSI_CMD_BINARY_STATE_LONG_H);
+    EXPECT_EQ(sentPackets[1].data, 0x00);
+
+    sentPackets.clear();
+    EXPECT_NE(api.setBinaryState(10, 0, true), SUCCESS);
+    EXPECT_EQ(sentPackets.size(), 0);
+}
+
 TEST(SUSI_Master_API, writeCV) {
     MockSusiHAL hal;
-    SUSI_Master master(hal);
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
     SUSI_Master_API api(master);
-    hal.ack_result = SUCCESS;
+    transport.ack_result = SUCCESS;
 
     // Capture the packets that are sent
     std::vector<SUSI_Packet> sentPackets;
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool a) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool a) {
         sentPackets.push_back(p);
     };
 
@@ -66,13 +147,14 @@ TEST(SUSI_Master_API, writeCV) {
 
 TEST(SUSI_Master_API, readCV) {
     MockSusiHAL hal;
-    SUSI_Master master(hal);
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
     SUSI_Master_API api(master);
-    hal.ack_result = SUCCESS;
+    transport.ack_result = SUCCESS;
 
     // Capture the packets that are sent
     std::vector<SUSI_Packet> sentPackets;
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool a) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool a) {
         sentPackets.push_back(p);
     };
 
@@ -81,26 +163,175 @@ TEST(SUSI_Master_API, readCV) {
     for(int i = 0; i < 8; i++) {
         hal.read_bits.push(0);
     }
-    EXPECT_EQ(api.readCV(10, 1024, value), SUCCESS);
+    EXPECT_EQ(api.readCV(10, 768, value), SUCCESS);
 
     EXPECT_EQ(sentPackets.size(), 2);
     EXPECT_EQ(sentPackets[0].address, 10);
     EXPECT_EQ(sentPackets[0].command, SUSI_CMD_READ_CV);
-    EXPECT_EQ(sentPackets[0].data, 0x03); // CV bank 3
+    EXPECT_EQ(sentPackets[0].data, 0x02); // CV bank 2
     EXPECT_EQ(sentPackets[1].address, 10);
-    EXPECT_EQ(sentPackets[1].command, 0xFF); // CV 1024 is 255 in bank 3
+    EXPECT_EQ(sentPackets[1].command, 0xFF); // CV 768 is 255 in bank 2
     EXPECT_EQ(sentPackets[1].data, 0);
 }
 
+TEST(SUSI_Master_API, readCVFrom769UsesOneBiDiCommand) {
+    MockSusiHAL hal;
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
+    SUSI_Master_API api(master);
+    transport.ack_result = SUCCESS;
+
+    std::vector<SUSI_Packet> sentPackets;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool a) {
+        sentPackets.push_back(p);
+    };
+
+    uint8_t response[] = {SUSI_MSG_BIDI_CV_RESPONSE, 0x42, SUSI_MSG_BIDI_CV_RESPONSE, 0x43};
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 8; j++) {
+            hal.read_bits.push((response[i] >> j) & 0x01);
+        }
+    }
+    uint8_t value = 0;
+    EXPECT_EQ(api.readCV(10, 1024, value), SUCCESS);
+    EXPECT_EQ(value, 0x42);
+
+    ASSERT_EQ(sentPackets.size(), 1u);
+    EXPECT_EQ(sentPackets[0].address, 10);
+    EXPECT_EQ(sentPackets[0].command, SUSI_CMD_BIDI_READ_CV);
+    EXPECT_EQ(sentPackets[0].data, 255); // CV 1024 - 769
+}
+
+TEST(SUSI_Master_API, ackTimeoutIsLearnedPerModule) {
+    MockSusiHAL hal;
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
+    SUSI_Master_API api(master);
+    SusiAckStats stats;
+    EXPECT_FALSE(api.getAckStats(1, stats));
+
+    // Until a module has answered a few times, it gets the full timeout
+    transport.ack_latency_us = 300;
+    for (int i = 0; i < SUSI_ACK_LEARN_SAMPLES; i++) {
+        EXPECT_EQ(api.setSpeed(1, 10, true), SUCCESS);
+        EXPECT_EQ(transport.ack_timeout_us, SUSI_ACK_TIMEOUT_US);
+    }
+    ASSERT_TRUE(api.getAckStats(1, stats));
+    EXPECT_EQ(stats.average_us, 300);
+    EXPECT_EQ(stats.max_us, 300);
+    EXPECT_EQ(stats.samples, SUSI_ACK_LEARN_SAMPLES);
+    EXPECT_EQ(stats.timeout_us, SUSI_ACK_TIMEOUT_MIN_US);
+    EXPECT_EQ(api.setFunction(1, 0, true), SUCCESS);
+    EXPECT_EQ(transport.ack_timeout_us, SUSI_ACK_TIMEOUT_MIN_US);
+
+    // A slow ACK raises the timeout to its latency plus the margin at once,
+    // the average follows by an eighth
+    transport.ack_latency_us = 4300;
+    EXPECT_EQ(api.setSpeed(1, 10, true), SUCCESS);
+    ASSERT_TRUE(api.getAckStats(1, stats));
+    EXPECT_EQ(stats.max_us, 4300);
+    EXPECT_EQ(stats.average_us, 800);
+    EXPECT_EQ(stats.timeout_us, 4300 + SUSI_ACK_TIMEOUT_MARGIN_US);
+
+    // Other modules and the shared CVs keep the full timeout
+    transport.ack_latency_us = 300;
+    EXPECT_EQ(api.setSpeed(2, 10, true), SUCCESS);
+    EXPECT_EQ(transport.ack_timeout_us, SUSI_ACK_TIMEOUT_US);
+    EXPECT_EQ(api.writeCV(1, 1021, 0), SUCCESS);
+    EXPECT_EQ(transport.ack_timeout_us, SUSI_ACK_TIMEOUT_US);
+    EXPECT_EQ(api.writeCV(1, 898, 0), SUCCESS);
+    EXPECT_EQ(transport.ack_timeout_us, SUSI_ACK_TIMEOUT_US);
+    EXPECT_EQ(api.writeCV(1, 900, 0), SUCCESS);
+    EXPECT_EQ(transport.ack_timeout_us, 4300 + SUSI_ACK_TIMEOUT_MARGIN_US);
+
+    // A timeout teaches nothing, and broadcasts use the full timeout
+    transport.ack_result = TIMEOUT;
+    EXPECT_EQ(api.setSpeed(1, 10, true), TIMEOUT);
+    ASSERT_TRUE(api.getAckStats(1, stats));
+    EXPECT_EQ(stats.samples, SUSI_ACK_LEARN_SAMPLES + 8);
+    api.pollSlaves();
+    EXPECT_EQ(api.registerBiDiSlave(1), SUCCESS);
+    api.pollSlaves();
+    EXPECT_EQ(transport.ack_timeout_us, SUSI_ACK_TIMEOUT_US);
+}
+
+TEST(SUSI_Master_API, deadBiDiModuleIsQuarantinedAndPromotedWhenItAnswers) {
+    MockSusiHAL hal;
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
+    SUSI_Master_API api(master);
+    api.registerBiDiSlave(1);
+    api.registerBiDiSlave(2);
+
+    int calls[3] = {0, 0, 0};
+    SusiMasterResult module_2 = SUCCESS;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool a) {
+        if (p.command == SUSI_CMD_BIDI_HOST_CALL) {
+            calls[p.data]++;
+            transport.ack_result = p.data == 2 ? module_2 : SUCCESS;
+        }
+    };
+    SusiLinkStats stats;
+    EXPECT_FALSE(api.getLinkStats(3, stats));
+
+    // Module 2 goes away: one invalid ACK and two timeouts quarantine it
+    module_2 = INVALID_ACK;
+    api.pollSlaves();
+    module_2 = TIMEOUT;
+    api.pollSlaves();
+    api.pollSlaves();
+    ASSERT_TRUE(api.getLinkStats(2, stats));
+    EXPECT_EQ(stats.invalid_acks, 1);
+    EXPECT_EQ(stats.timeouts, 2);
+    EXPECT_EQ(stats.consecutive_errors, SUSI_LINK_QUARANTINE_ERRORS);
+    EXPECT_TRUE(stats.quarantined);
+
+    // It is only probed every few cycles, module 1 in every cycle
+    for (int i = 0; i < 2 * SUSI_LINK_PROBE_INTERVAL; i++) {
+        api.pollSlaves();
+    }
+    EXPECT_EQ(calls[1], 3 + 2 * SUSI_LINK_PROBE_INTERVAL);
+    EXPECT_EQ(calls[2], 3 + 2);
+    ASSERT_TRUE(api.getLinkStats(1, stats));
+    EXPECT_FALSE(stats.quarantined);
+    EXPECT_EQ(stats.timeouts, 0);
+
+    // It answers the next probe and is polled in every cycle again
+    module_2 = SUCCESS;
+    for (int i = 0; i < SUSI_LINK_PROBE_INTERVAL; i++) {
+        api.pollSlaves();
+    }
+    ASSERT_TRUE(api.getLinkStats(2, stats));
+    EXPECT_FALSE(stats.quarantined);
+    EXPECT_EQ(stats.consecutive_errors, 0);
+    EXPECT_EQ(stats.timeouts, 4);
+    int before = calls[2];
+    api.pollSlaves();
+    EXPECT_EQ(calls[2], before + 1);
+
+    // A bank read with a wrong CRC counts as well
+    for (int i = 0; i < 40; i++) {
+        hal.sendByte(0);
+    }
+    hal.sendByte(0x55);
+    hal.sendByte(0);
+    uint8_t bank[40];
+    EXPECT_EQ(api.readCVBank(2, 0, bank), INVALID_CRC);
+    ASSERT_TRUE(api.getLinkStats(2, stats));
+    EXPECT_EQ(stats.crc_errors, 1);
+    EXPECT_EQ(stats.consecutive_errors, 1);
+}
+
 TEST(SUSI_Master_API, performHandshake) {
     MockSusiHAL hal;
-    SUSI_Master master(hal);
+    MockSusiTransport transport(hal);
+    SUSI_Master master(transport);
     SUSI_Master_API api(master);
-    hal.ack_result = SUCCESS;
+    transport.ack_result = SUCCESS;
 
     // Capture the packets that are sent
     std::vector<SUSI_Packet> sentPackets;
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool a) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool a) {
         sentPackets.push_back(p);
     };
 
@@ -0,0 +1,212 @@
+#include "gtest/gtest.h"
+#include "susi_slave.h"
+#include "susi_hal.h"
+#include "susi_commands.h"
+#include "mock_hal.h"
+#include <vector>
+
+// A SusiHAL with a one-shot timer that the test fires, or none at all
+class TimerHAL : public SusiHAL {
+public:
+    TimerHAL(uint8_t clock_pin, uint8_t data_pin) : SusiHAL(clock_pin, data_pin) {}
+
+    bool has_timer = false;
+    uint32_t timer_us = 0; // The running timer, 0 for none
+
+    bool startAckTimer(uint32_t us) override {
+        if (!has_timer) {
+            return false;
+        }
+        timer_us = us;
+        return true;
+    }
+};
+
+// Drives a slave with a real SusiHAL through its clock interrupt in virtual
+// time, acting as the host on the clock and data pins.
+class SusiBidiISRTest : public ::testing::Test {
+protected:
+    const uint8_t CLOCK_PIN = 2;
+    const uint8_t DATA_PIN = 3;
+    const uint8_t SLAVE_ADDRESS = 1;
+    const unsigned long HALF_CLOCK_US = 10;
+
+    TimerHAL hal;
+    SUSI_Slave slave;
+
+    SusiBidiISRTest() : hal(CLOCK_PIN, DATA_PIN), slave(hal) {}
+
+    void SetUp() override {
+        mock_hal_reset();
+        slave.begin(SLAVE_ADDRESS);
+        digitalWrite(CLOCK_PIN, HIGH);
+        digitalWrite(DATA_PIN, HIGH);
+    }
+
+    void clockBit(bool bit) {
+        digitalWrite(DATA_PIN, bit ? HIGH : LOW);
+        digitalWrite(CLOCK_PIN, LOW);
+        delayMicroseconds(HALF_CLOCK_US);
+        digitalWrite(CLOCK_PIN, HIGH);
+        delayMicroseconds(HALF_CLOCK_US);
+    }
+
+    // Sends a packet and returns the time of the stop bit's falling clock edge
+    unsigned long sendPacket(uint8_t address, uint8_t command, uint8_t data) {
+        uint8_t bytes[3] = {address, command, data};
+        clockBit(false);
+        for (int i = 0; i < 24; i++) {
+            clockBit((bytes[i / 8] >> (i % 8)) & 0x01);
+        }
+        unsigned long stop_time = mock_micros_time;
+        digitalWrite_calls.clear();
+        clockBit(true);
+        return stop_time;
+    }
+
+    // Clocks out a 4-byte response, sampling while the clock is low
+    std::vector<uint8_t> readResponse() {
+        std::vector<uint8_t> response(4, 0);
+        for (int i = 0; i < 32; i++) {
+            digitalWrite(CLOCK_PIN, LOW);
+            delayMicroseconds(HALF_CLOCK_US);
+            if (pin_states[DATA_PIN] == HIGH) {
+                response[i / 8] |= 1 << (i % 8);
+            }
+            digitalWrite(CLOCK_PIN, HIGH);
+            delayMicroseconds(HALF_CLOCK_US);
+        }
+        return response;
+    }
+
+    // Lets the ACK timer of the HAL run out and fire
+    void fireAckTimer() {
+        if (hal.timer_us != 0) {
+            delayMicroseconds(hal.timer_us);
+            hal.timer_us = 0;
+            hal.finishAck();
+        }
+    }
+
+    // Checks the ACK pulse that follows a host call
+    void expectAck(unsigned long stop_time) {
+        fireAckTimer();
+        const Call* ack_start = nullptr;
+        const Call* ack_end = nullptr;
+        for (const Call& call : digitalWrite_calls) {
+            if (call.pin != DATA_PIN) continue;
+            if (ack_start == nullptr && call.value == LOW) {
+                ack_start = &call;
+            } else if (ack_start != nullptr && call.value == HIGH) {
+                ack_end = &call;
+                break;
+            }
+        }
+        ASSERT_NE(ack_start, nullptr) << "No ACK";
+        ASSERT_NE(ack_end, nullptr) << "ACK not released";
+        EXPECT_LE(ack_start->time_us - stop_time, 2000u);
+        EXPECT_GE(ack_end->time_us - ack_start->time_us, 500u);
+        EXPECT_LE(ack_end->time_us - ack_start->time_us, 7000u);
+    }
+};
+
+TEST_F(SusiBidiISRTest, HandshakeAndPollAnsweredFromISR) {
+    // Handshake: forced response for our module number
+    unsigned long stop_time = sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, SLAVE_ADDRESS | 0x04);
+    expectAck(stop_time);
+    std::vector<uint8_t> expected = {SUSI_MSG_BIDI_STATUS, 0, SUSI_MSG_BIDI_STATUS, 0};
+    EXPECT_EQ(readResponse(), expected);
+    EXPECT_TRUE(slave.isBidirectionalModeEnabled());
+
+    // Events queued by the application; the main loop then stays busy for 50ms
+    // and never calls available() or read().
+    slave.sendError(3);
+    slave.sendAnalogValue(0, 9);
+    mock_hal_advance_time(50);
+
+    stop_time = sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, SLAVE_ADDRESS);
+    expectAck(stop_time);
+    expected = {SUSI_MSG_BIDI_ERROR, 3, SUSI_MSG_BIDI_ANALOG_A, 9};
+    EXPECT_EQ(readResponse(), expected);
+
+    mock_hal_advance_time(100);
+    stop_time = sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, SLAVE_ADDRESS);
+    expectAck(stop_time);
+    expected = {SUSI_MSG_BIDI_EMPTY, 0, SUSI_MSG_BIDI_EMPTY, 0};
+    EXPECT_EQ(readResponse(), expected);
+
+    EXPECT_FALSE(slave.available());
+}
+
+TEST_F(SusiBidiISRTest, OtherModulesAndPacketsAreNotAnswered) {
+    slave.enableBidirectionalMode();
+
+    // A host call for module 2 gets no ACK from us
+    sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, 2);
+    for (const Call& call : digitalWrite_calls) {
+        if (call.pin == DATA_PIN) {
+            EXPECT_EQ(call.value, HIGH); // Only the host's stop bit
+        }
+    }
+    EXPECT_FALSE(slave.available()) << "Host calls are never left for read()";
+    mock_hal_advance_time(20); // Module 2 is missing, the host waits out the ACK timeout
+
+    // After a response, regular packets are decoded again
+    unsigned long stop_time = sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, SLAVE_ADDRESS);
+    expectAck(stop_time);
+    readResponse();
+    sendPacket(SLAVE_ADDRESS, SUSI_CMD_SET_SPEED, 0x80 | 42);
+    ASSERT_TRUE(slave.available());
+    slave.read();
+    EXPECT_EQ(slave.getSpeed(), 42);
+    EXPECT_TRUE(slave.getDirection());
+}
+
+TEST_F(SusiBidiISRTest, HostCallsAreAnsweredWhileAPacketWaitsForRead) {
+    slave.enableBidirectionalMode();
+    slave.sendError(3);
+
+    // The main loop never calls read(): our own packet stays pending, then
+    // a host call of another module and ours follow.
+    sendPacket(SLAVE_ADDRESS, SUSI_CMD_SET_SPEED, 0x80 | 42);
+    ASSERT_TRUE(slave.available());
+    sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, 2);
+    mock_hal_advance_time(20); // Module 2 is missing, the host waits out the ACK timeout
+    unsigned long stop_time = sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, SLAVE_ADDRESS);
+    expectAck(stop_time);
+    std::vector<uint8_t> expected = {SUSI_MSG_BIDI_ERROR, 3, SUSI_MSG_BIDI_EMPTY, 0};
+    EXPECT_EQ(readResponse(), expected);
+
+    // The pending packet is the one read() gets, nothing was latched after it
+    SUSI_Packet packet = slave.read();
+    EXPECT_EQ(packet.command, SUSI_CMD_SET_SPEED);
+    EXPECT_EQ(slave.getSpeed(), 42);
+    EXPECT_FALSE(slave.available());
+}
+
+TEST_F(SusiBidiISRTest, HostCallOfAnotherModuleIsNotLatched) {
+    slave.enableBidirectionalMode();
+
+    sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, 2);
+    EXPECT_FALSE(slave.available());
+    // The answer of module 2 is skipped, our host call is decoded right after
+    readResponse();
+    unsigned long stop_time = sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, SLAVE_ADDRESS);
+    expectAck(stop_time);
+}
+
+TEST_F(SusiBidiISRTest, AckWithATimerDoesNotBlockTheInterrupt) {
+    hal.has_timer = true;
+    slave.enableBidirectionalMode();
+
+    unsigned long stop_time = sendPacket(0, SUSI_CMD_BIDI_HOST_CALL, SLAVE_ADDRESS);
+    // Only the rising edge of the stop bit passed since the ACK started
+    EXPECT_EQ(mock_micros_time - stop_time, 2 * HALF_CLOCK_US);
+    EXPECT_EQ(pin_states[DATA_PIN], LOW);
+    EXPECT_EQ(hal.timer_us, 1000u);
+
+    expectAck(stop_time);
+    EXPECT_EQ(pin_states[DATA_PIN], HIGH);
+    std::vector<uint8_t> expected = {SUSI_MSG_BIDI_EMPTY, 0, SUSI_MSG_BIDI_EMPTY, 0};
+    EXPECT_EQ(readResponse(), expected);
+}
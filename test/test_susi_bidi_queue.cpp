@@ -0,0 +1,196 @@
+#include "gtest/gtest.h"
+#include "susi_bidi_queue.h"
+#include "susi_slave.h"
+#include "susi_commands.h"
+#include "mock_susi_hal.h"
+#include <vector>
+
+TEST(SusiBidiQueue, UrgentMessagesGoFirst) {
+    SusiBidiQueue queue;
+    queue.push(SUSI_MSG_BIDI_ANALOG_A, 1, SUSI_BIDI_PRIORITY_ANALOG);
+    queue.push(SUSI_MSG_BIDI_AUTO_SPEED, 2, SUSI_BIDI_PRIORITY_NORMAL);
+    queue.push(SUSI_MSG_BIDI_ERROR, 3, SUSI_BIDI_PRIORITY_URGENT);
+
+    uint8_t response[4];
+    ASSERT_TRUE(queue.popResponse(response));
+    EXPECT_EQ(response[0], SUSI_MSG_BIDI_ERROR);
+    EXPECT_EQ(response[2], SUSI_MSG_BIDI_AUTO_SPEED);
+    ASSERT_TRUE(queue.popResponse(response));
+    EXPECT_EQ(response[0], SUSI_MSG_BIDI_ANALOG_A);
+    EXPECT_EQ(response[2], SUSI_MSG_BIDI_EMPTY);
+    EXPECT_EQ(response[3], 0);
+    EXPECT_FALSE(queue.popResponse(response));
+}
+
+TEST(SusiBidiQueue, SamePriorityKeepsOrder) {
+    SusiBidiQueue queue;
+    for (uint8_t i = 0; i < 4; i++) {
+        queue.push(SUSI_MSG_BIDI_SIGNAL_STATE, i, SUSI_BIDI_PRIORITY_NORMAL);
+    }
+
+    uint8_t response[4];
+    for (uint8_t i = 0; i < 4; i += 2) {
+        ASSERT_TRUE(queue.popResponse(response));
+        EXPECT_EQ(response[1], i);
+        EXPECT_EQ(response[3], i + 1);
+    }
+}
+
+TEST(SusiBidiQueue, AnalogValueReplacesPendingValue) {
+    SusiBidiQueue queue;
+    queue.pushAnalog(SUSI_MSG_BIDI_ANALOG_A, 10);
+    queue.pushAnalog(SUSI_MSG_BIDI_ANALOG_B, 20);
+    queue.pushAnalog(SUSI_MSG_BIDI_ANALOG_A, 11);
+    queue.pushAnalog(SUSI_MSG_BIDI_ANALOG_A, 12);
+
+    SusiBidiQueueStats stats;
+    queue.getStats(stats);
+    EXPECT_EQ(stats.pending, 2);
+    EXPECT_EQ(stats.overwritten, 2);
+
+    uint8_t response[4];
+    ASSERT_TRUE(queue.popResponse(response));
+    EXPECT_EQ(response[0], SUSI_MSG_BIDI_ANALOG_A);
+    EXPECT_EQ(response[1], 12);
+}
+
+TEST(SusiBidiQueue, FullQueueDropsLowerPriorityFirst) {
+    SusiBidiQueue queue;
+    for (uint8_t i = 0; i < SUSI_BIDI_QUEUE_SIZE; i++) {
+        queue.push(SUSI_MSG_BIDI_AUTO_SPEED, i, SUSI_BIDI_PRIORITY_NORMAL);
+    }
+    queue.pushAnalog(SUSI_MSG_BIDI_ANALOG_A, 1); // No room, same or higher priority pending
+
+    EXPECT_TRUE(queue.push(SUSI_MSG_BIDI_ERROR, 9, SUSI_BIDI_PRIORITY_URGENT)); // Evicts the newest normal message
+
+    SusiBidiQueueStats stats;
+    queue.getStats(stats);
+    EXPECT_EQ(stats.dropped, 2);
+    EXPECT_EQ(stats.pending, SUSI_BIDI_QUEUE_SIZE);
+
+    uint8_t response[4];
+    ASSERT_TRUE(queue.popResponse(response));
+    EXPECT_EQ(response[0], SUSI_MSG_BIDI_ERROR);
+    EXPECT_EQ(response[3], 0);
+    for (uint8_t i = 1; i < SUSI_BIDI_QUEUE_SIZE - 1; i += 2) {
+        ASSERT_TRUE(queue.popResponse(response));
+        EXPECT_EQ(response[1], i);
+        EXPECT_EQ(response[3], i + 1);
+    }
+    EXPECT_FALSE(queue.popResponse(response));
+}
+
+TEST(SusiBidiQueue, PairsStayTogether) {
+    SusiBidiQueue queue;
+    queue.push(SUSI_MSG_BIDI_AUTO_SPEED, 1, SUSI_BIDI_PRIORITY_NORMAL);
+    queue.pushPair(SUSI_MSG_BIDI_POSITION_HIGH, 0x12, SUSI_MSG_BIDI_POSITION_LOW, 0x34, SUSI_BIDI_PRIORITY_URGENT);
+
+    uint8_t response[4];
+    ASSERT_TRUE(queue.popResponse(response));
+    EXPECT_EQ(response[0], SUSI_MSG_BIDI_POSITION_HIGH);
+    EXPECT_EQ(response[1], 0x12);
+    EXPECT_EQ(response[2], SUSI_MSG_BIDI_POSITION_LOW);
+    EXPECT_EQ(response[3], 0x34);
+
+    // A pair is never split over two responses
+    queue.pushPair(SUSI_MSG_BIDI_POSITION_HIGH, 0x56, SUSI_MSG_BIDI_POSITION_LOW, 0x78, SUSI_BIDI_PRIORITY_URGENT);
+    ASSERT_TRUE(queue.popResponse(response));
+    EXPECT_EQ(response[0], SUSI_MSG_BIDI_POSITION_HIGH);
+    EXPECT_EQ(response[2], SUSI_MSG_BIDI_POSITION_LOW);
+    ASSERT_TRUE(queue.popResponse(response));
+    EXPECT_EQ(response[0], SUSI_MSG_BIDI_AUTO_SPEED);
+    EXPECT_EQ(response[2], SUSI_MSG_BIDI_EMPTY);
+
+    // A pair is dropped as a whole
+    SusiBidiQueue full;
+    for (uint8_t i = 0; i < SUSI_BIDI_QUEUE_SIZE - 1; i++) {
+        full.push(SUSI_MSG_BIDI_ERROR, i, SUSI_BIDI_PRIORITY_URGENT);
+    }
+    EXPECT_FALSE(full.pushPair(SUSI_MSG_BIDI_POSITION_HIGH, 0, SUSI_MSG_BIDI_POSITION_LOW, 0, SUSI_BIDI_PRIORITY_URGENT));
+    EXPECT_EQ(full.pending(), SUSI_BIDI_QUEUE_SIZE - 1);
+}
+
+// Test fixture for BiDi bursts between host calls
+class SusiBidiBurstTest : public ::testing::Test {
+protected:
+    const uint8_t SLAVE_ADDRESS = 1;
+
+    MockSusiHAL hal;
+    SUSI_Slave slave;
+    std::vector<uint8_t> sent;
+
+    SusiBidiBurstTest() : slave(hal) {}
+
+    void SetUp() override {
+        slave.begin(SLAVE_ADDRESS);
+        slave.enableBidirectionalMode();
+        hal.onSendByte = [&](uint8_t byte) { sent.push_back(byte); };
+    }
+
+    // Simulates one host call and returns the 4-byte response
+    std::vector<uint8_t> poll() {
+        sent.clear();
+        slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BIDI_HOST_CALL, SLAVE_ADDRESS});
+        slave.read();
+        return sent;
+    }
+};
+
+TEST_F(SusiBidiBurstTest, BurstBetweenPollsIsDelivered) {
+    // Events of 100 ms between two host calls
+    slave.sendAutoSpeed(10, true);
+    slave.sendAnalogValue(0, 1);
+    slave.sendSignalState(2);
+    slave.sendAnalogValue(0, 2);
+    slave.sendError(5);
+    slave.sendAnalogValue(0, 3);
+    slave.sendPositionResponse(0x1234);
+
+    std::vector<uint8_t> headers;
+    for (int i = 0; i < 3; i++) {
+        std::vector<uint8_t> response = poll();
+        ASSERT_EQ(response.size(), 4u);
+        for (int j = 0; j < 4; j += 2) {
+            headers.push_back(response[j]);
+            if (response[j] == SUSI_MSG_BIDI_ANALOG_A) {
+                EXPECT_EQ(response[j + 1], 3); // Only the latest analog value
+            }
+        }
+    }
+
+    // Two events per host call; the position pair fills one call on its own
+    std::vector<uint8_t> expected = {
+        SUSI_MSG_BIDI_ERROR, SUSI_MSG_BIDI_AUTO_SPEED,
+        SUSI_MSG_BIDI_POSITION_HIGH, SUSI_MSG_BIDI_POSITION_LOW,
+        SUSI_MSG_BIDI_SIGNAL_STATE, SUSI_MSG_BIDI_ANALOG_A
+    };
+    EXPECT_EQ(headers, expected);
+
+    // Nothing left: the slave answers with an empty message
+    EXPECT_EQ(poll()[0], SUSI_MSG_BIDI_EMPTY);
+
+    SusiBidiQueueStats stats;
+    slave.getBidiQueueStats(stats);
+    EXPECT_EQ(stats.overwritten, 2);
+    EXPECT_EQ(stats.dropped, 0);
+}
+
+TEST_F(SusiBidiBurstTest, OverlongBurstKeepsErrors) {
+    for (uint8_t i = 0; i < 20; i++) {
+        slave.sendSignalState(i);
+    }
+    slave.sendError(7);
+
+    SusiBidiQueueStats stats;
+    slave.getBidiQueueStats(stats);
+    EXPECT_EQ(stats.dropped, 20 - SUSI_BIDI_QUEUE_SIZE + 1);
+
+    std::vector<uint8_t> response = poll();
+    EXPECT_EQ(response[0], SUSI_MSG_BIDI_ERROR);
+    EXPECT_EQ(response[1], 7);
+    EXPECT_EQ(response[2], SUSI_MSG_BIDI_SIGNAL_STATE);
+    EXPECT_EQ(response[3], 0);
+    response = poll();
+    EXPECT_EQ(response[1], 1);
+    EXPECT_EQ(response[3], 2);
+}
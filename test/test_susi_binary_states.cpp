@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+#include "susi_binary_states.h"
+
+TEST(SusiBinaryStates, OnlyStatesThatDifferAreStored) {
+    SusiBinaryStates states;
+
+    EXPECT_TRUE(states.set(1, true));
+    EXPECT_TRUE(states.set(SUSI_BINARY_STATE_MAX, true));
+    EXPECT_TRUE(states.set(500, false));
+    EXPECT_EQ(states.size(), 2);
+
+    EXPECT_TRUE(states.get(1));
+    EXPECT_TRUE(states.get(SUSI_BINARY_STATE_MAX));
+    EXPECT_FALSE(states.get(500));
+    EXPECT_FALSE(states.get(2));
+
+    EXPECT_TRUE(states.set(1, false));
+    EXPECT_FALSE(states.get(1));
+    EXPECT_EQ(states.size(), 1);
+
+    EXPECT_FALSE(states.set(0, true));
+    EXPECT_FALSE(states.set(SUSI_BINARY_STATE_MAX + 1, true));
+}
+
+TEST(SusiBinaryStates, FullStoreRejectsNewStates) {
+    SusiBinaryStates states;
+    for (uint16_t i = 0; i < SUSI_BINARY_STATE_CAPACITY; i++) {
+        EXPECT_TRUE(states.set(100 + i, true));
+    }
+    EXPECT_FALSE(states.set(99, true));
+    EXPECT_FALSE(states.get(99));
+
+    // Setting a state to the common state always works and frees an entry
+    EXPECT_TRUE(states.set(99, false));
+    EXPECT_TRUE(states.set(100, false));
+    EXPECT_TRUE(states.set(99, true));
+    EXPECT_TRUE(states.get(99));
+}
+
+TEST(SusiBinaryStates, SetAllDropsEveryEntry) {
+    SusiBinaryStates states;
+    for (uint16_t i = 0; i < SUSI_BINARY_STATE_CAPACITY; i++) {
+        states.set(1000 + i, true);
+    }
+
+    states.setAll(false);
+    EXPECT_EQ(states.size(), 0);
+    for (uint16_t i = 0; i < SUSI_BINARY_STATE_CAPACITY; i++) {
+        EXPECT_FALSE(states.get(1000 + i));
+    }
+
+    // With all states on, the states that are off are stored
+    states.setAll(true);
+    EXPECT_TRUE(states.get(1000));
+    EXPECT_TRUE(states.get(7));
+    EXPECT_TRUE(states.set(7, false));
+    EXPECT_FALSE(states.get(7));
+    EXPECT_EQ(states.size(), 1);
+}
+
+TEST(SusiBinaryStates, OldEntriesStayDroppedWhenTheEpochWraps) {
+    SusiBinaryStates states;
+    states.set(42, true);
+    states.setAll(false);
+    states.set(43, true);
+    states.setAll(false);
+    for (int i = 0; i < 600; i++) {
+        EXPECT_FALSE(states.get(42));
+        EXPECT_FALSE(states.get(43));
+        states.setAll(false);
+    }
+    EXPECT_EQ(states.size(), 0);
+}
+
+TEST(SusiBinaryStates, SetAllShortOnlySetsTheShortRange) {
+    SusiBinaryStates states;
+    states.set(5, true);
+    states.set(200, true);
+
+    states.setAllShort(true);
+    EXPECT_TRUE(states.get(1));
+    EXPECT_TRUE(states.get(SUSI_BINARY_STATE_SHORT_MAX));
+    EXPECT_FALSE(states.get(SUSI_BINARY_STATE_SHORT_MAX + 1));
+    EXPECT_TRUE(states.get(200));
+    EXPECT_EQ(states.size(), 1);
+
+    EXPECT_TRUE(states.set(5, false));
+    EXPECT_FALSE(states.get(5));
+    states.setAllShort(false);
+    EXPECT_FALSE(states.get(5));
+    EXPECT_FALSE(states.get(7));
+    EXPECT_TRUE(states.get(200));
+    EXPECT_EQ(states.size(), 1);
+}
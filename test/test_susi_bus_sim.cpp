@@ -0,0 +1,640 @@
+#include "gtest/gtest.h"
+#include "susi_bus_sim.h"
+#include "susi_master.h"
+#include "susi_slave.h"
+#include "susi_commands.h"
+#include "EEPROM.h"
+#include <chrono>
+#include <ctime>
+#include <vector>
+
+// A master and three slaves with module numbers 1-3 on one simulated bus. The
+// master runs the test code, the slaves answer their packets in their main loop.
+class SusiBusSimTest : public ::testing::Test {
+protected:
+    static const int SLAVES = 3;
+
+    struct Bus {
+        SusiBusSim sim;
+        SusiSimNode& master_node;
+        SusiSimNode* slave_nodes[SLAVES];
+        SusiHAL master_hal;
+        SUSI_Master master;
+        SUSI_Master_API api;
+        SusiHAL* slave_hals[SLAVES];
+        SUSI_Slave* slaves[SLAVES];
+
+        explicit Bus(const SusiBusSimConfig& config, bool ack_timers)
+            : sim(config), master_node(sim.addNode()),
+              master_hal(master_node.clockPin(), master_node.dataPin()),
+              master(master_hal), api(master) {
+            for (int i = 0; i < SLAVES; i++) {
+                slave_nodes[i] = &sim.addNode();
+                if (ack_timers) {
+                    slave_hals[i] = new SusiSimHAL(sim, *slave_nodes[i]);
+                } else {
+                    slave_hals[i] = new SusiHAL(slave_nodes[i]->clockPin(), slave_nodes[i]->dataPin());
+                }
+                slaves[i] = new SUSI_Slave(*slave_hals[i]);
+                SUSI_Slave* slave = slaves[i];
+                slave_nodes[i]->setLoop([slave]() { slave->read(); },
+                                        [slave]() { return slave->available(); });
+            }
+            api.begin();
+            for (int i = 0; i < SLAVES; i++) {
+                SUSI_Slave* slave = slaves[i];
+                uint8_t address = i + 1;
+                sim.runOn(*slave_nodes[i], [slave, address]() { slave->begin(address); });
+            }
+        }
+
+        ~Bus() {
+            for (int i = 0; i < SLAVES; i++) {
+                delete slaves[i];
+                delete slave_hals[i];
+            }
+        }
+    };
+
+    std::unique_ptr<Bus> bus;
+    static std::vector<std::vector<uint8_t>> bidi_events;
+
+    void SetUp() override {
+        mock_hal_reset();
+        EEPROM.clear();
+        bidi_events.clear();
+    }
+
+    // Without ACK timers the slaves hold the ACK of a host call in their interrupt
+    void start(const SusiBusSimConfig& config = SusiBusSimConfig(), bool ack_timers = true) {
+        bus.reset(new Bus(config, ack_timers));
+    }
+
+    static void recordBidiEvent(uint8_t address, uint8_t header, uint8_t data) {
+        bidi_events.push_back({address, header, data});
+    }
+};
+
+std::vector<std::vector<uint8_t>> SusiBusSimTest::bidi_events;
+
+TEST_F(SusiBusSimTest, PacketIsDecodedAndAcknowledgedByAddressedSlave) {
+    start();
+    EXPECT_EQ(bus->api.setSpeed(2, 50, true), SUCCESS);
+    EXPECT_EQ(bus->api.setFunction(3, 4, true), SUCCESS);
+
+    EXPECT_EQ(bus->slaves[1]->getSpeed(), 50);
+    EXPECT_TRUE(bus->slaves[1]->getDirection());
+    EXPECT_TRUE(bus->slaves[2]->getFunction(4));
+    EXPECT_EQ(bus->slaves[0]->getSpeed(), 0);
+    EXPECT_FALSE(bus->slaves[1]->getFunction(4));
+
+    // The bus is released again after the ACK
+    EXPECT_TRUE(bus->sim.dataLevel());
+    EXPECT_TRUE(bus->sim.clockLevel());
+}
+
+TEST_F(SusiBusSimTest, PacketForMissingSlaveTimesOutInBusTime) {
+    start();
+    uint64_t start_ns = bus->sim.now();
+    EXPECT_EQ(bus->api.setSpeed(5, 50, true), TIMEOUT);
+
+    // Sync gap, 26 clocks and the 20ms ACK timeout
+    uint64_t elapsed_us = (bus->sim.now() - start_ns) / 1000;
+    EXPECT_GT(elapsed_us, 20000u);
+    EXPECT_LT(elapsed_us, 32000u);
+}
+
+TEST_F(SusiBusSimTest, ModuleThatStopsAnsweringCostsOnlyItsLearnedTimeout) {
+    start();
+    for (int i = 0; i < 8; i++) {
+        ASSERT_EQ(bus->api.setSpeed(2, i, true), SUCCESS);
+    }
+    SusiAckStats stats;
+    ASSERT_TRUE(bus->api.getAckStats(2, stats));
+    EXPECT_EQ(stats.timeout_us, SUSI_ACK_TIMEOUT_MIN_US);
+
+    // Module 2 crashes and no longer sees the clock
+    SusiSimNode& node = *bus->slave_nodes[1];
+    bus->sim.runOn(node, [&]() { detachInterrupt(digitalPinToInterrupt(node.clockPin())); });
+
+    uint64_t start_ns = bus->sim.now();
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(bus->api.setSpeed(2, 50, true), TIMEOUT);
+    }
+    uint64_t learned_us = (bus->sim.now() - start_ns) / 1000;
+
+    // A module that never answered costs the full 20 ms per command
+    start_ns = bus->sim.now();
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(bus->api.setSpeed(5, 50, true), TIMEOUT);
+    }
+    uint64_t full_us = (bus->sim.now() - start_ns) / 1000;
+
+    // 26 clocks and 2 ms per command, and at most one sync gap
+    EXPECT_LT(learned_us, 10 * 3000u + 9000u);
+    EXPECT_GT(full_us, 10 * 20000u);
+
+    // The other modules keep working
+    EXPECT_EQ(bus->api.setSpeed(3, 60, true), SUCCESS);
+    EXPECT_EQ(bus->slaves[2]->getSpeed(), 60);
+}
+
+TEST_F(SusiBusSimTest, CVIsWrittenOverTheWire) {
+    start();
+    EXPECT_EQ(bus->api.writeCV(1, 10, 0x5A), SUCCESS);
+
+    uint8_t value = 0;
+    SUSI_Slave* slave = bus->slaves[0];
+    bus->sim.runOn(*bus->slave_nodes[0], [&]() { value = slave->readCV(9); });
+    EXPECT_EQ(value, 0x5A);
+}
+
+TEST_F(SusiBusSimTest, CVAndBankAreReadOverTheWire) {
+    start();
+    ASSERT_EQ(bus->api.writeCV(2, 5, 0x42), SUCCESS);
+
+    uint8_t value = 0;
+    EXPECT_EQ(bus->api.readCV(2, 5, value), SUCCESS);
+    EXPECT_EQ(value, 0x42);
+
+    uint8_t bank[SUSI_CV_BANK_SIZE];
+    EXPECT_EQ(bus->api.readCVBank(2, 0, bank), SUCCESS);
+    EXPECT_EQ(bank[4], 0x42);
+
+    // The other slaves skipped the answers and decode the next packet
+    EXPECT_EQ(bus->api.setSpeed(1, 33, true), SUCCESS);
+    EXPECT_EQ(bus->api.setSpeed(3, 34, true), SUCCESS);
+    EXPECT_EQ(bus->slaves[0]->getSpeed(), 33);
+    EXPECT_EQ(bus->slaves[2]->getSpeed(), 34);
+}
+
+TEST_F(SusiBusSimTest, IdentificationBlockIsReadFasterWithTheBiDiCommand) {
+    start();
+    SUSI_Slave* slave = bus->slaves[1];
+    bus->sim.runOn(*bus->slave_nodes[1], [slave]() {
+        slave->setManufacturerID(0x1234);
+        slave->setVersionNumber(0x0102);
+    });
+
+    // The RCN-602 identification and version CVs 900-903
+    uint8_t fast[4];
+    uint64_t start_ns = bus->sim.now();
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(bus->api.readCV(2, CV_MANUFACTURER_ID + i, fast[i]), SUCCESS);
+    }
+    uint64_t fast_ns = bus->sim.now() - start_ns;
+
+    // The same CVs with the two-packet CV read
+    uint8_t slow[4];
+    start_ns = bus->sim.now();
+    for (int i = 0; i < 4; i++) {
+        uint16_t cv_addr = CV_MANUFACTURER_ID + i - 1;
+        ASSERT_EQ(bus->master.sendPacket({2, SUSI_CMD_READ_CV, (uint8_t)(cv_addr >> 8)}, true), SUCCESS);
+        ASSERT_EQ(bus->master.sendPacket({2, (uint8_t)(cv_addr & 0xFF), 0}, true), SUCCESS);
+        uint8_t answer[4];
+        for (int j = 0; j < 4; j++) {
+            answer[j] = bus->master.readByteFromSlave();
+        }
+        EXPECT_EQ(answer[0], SUSI_MSG_BIDI_CV_RESPONSE);
+        slow[i] = answer[1];
+    }
+    uint64_t slow_ns = bus->sim.now() - start_ns;
+
+    const uint8_t expected[4] = {0x12, 0x34, 0x01, 0x02};
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(fast[i], expected[i]) << "CV " << CV_MANUFACTURER_ID + i;
+        EXPECT_EQ(slow[i], expected[i]) << "CV " << CV_MANUFACTURER_ID + i;
+    }
+    ::testing::Test::RecordProperty("id_block_bidi_read_us", (int)(fast_ns / 1000));
+    ::testing::Test::RecordProperty("id_block_two_packet_read_us", (int)(slow_ns / 1000));
+    EXPECT_LT(fast_ns * 3, slow_ns * 2);
+
+    // The other slaves skipped the answers
+    EXPECT_EQ(bus->api.setSpeed(1, 12, true), SUCCESS);
+    EXPECT_EQ(bus->api.setSpeed(3, 13, true), SUCCESS);
+}
+
+TEST_F(SusiBusSimTest, CVBankIsSwitchedOverTheWire) {
+    start();
+    SUSI_Slave* slave = bus->slaves[0];
+    bus->sim.runOn(*bus->slave_nodes[0], [slave]() {
+        slave->setManufacturerID(0x1234);
+        slave->setHardwareID(0x5678);
+    });
+
+    uint8_t value = 0;
+    ASSERT_EQ(bus->api.readCV(1, CV_MANUFACTURER_ID, value), SUCCESS);
+    EXPECT_EQ(value, 0x12);
+
+    // CV 1021 selects the hardware ID in CVs 900/901
+    ASSERT_EQ(bus->api.writeCV(1, CV_SUSI_CV_BANKING, 1), SUCCESS);
+    ASSERT_EQ(bus->api.readCV(1, CV_SUSI_CV_BANKING, value), SUCCESS);
+    EXPECT_EQ(value, 1);
+    ASSERT_EQ(bus->api.readCV(1, CV_MANUFACTURER_ID, value), SUCCESS);
+    EXPECT_EQ(value, 0x56);
+    ASSERT_EQ(bus->api.readCV(1, CV_MANUFACTURER_ID + 1, value), SUCCESS);
+    EXPECT_EQ(value, 0x78);
+
+    ASSERT_EQ(bus->api.writeCV(1, CV_SUSI_CV_BANKING, 0), SUCCESS);
+    ASSERT_EQ(bus->api.readCV(1, CV_MANUFACTURER_ID, value), SUCCESS);
+    EXPECT_EQ(value, 0x12);
+}
+
+TEST_F(SusiBusSimTest, ReappliedConfigurationSkipsUnchangedCVs) {
+    start();
+    SUSI_Slave* slave = bus->slaves[0];
+    auto storedWrites = [&]() {
+        SusiCVLogStats stats;
+        bus->sim.runOn(*bus->slave_nodes[0], [&]() {
+            slave->flushCVs();
+            slave->getCVStorageStats(stats);
+        });
+        return stats.cv_writes;
+    };
+    auto storedCV = [&](uint16_t cv) {
+        uint8_t value = 0;
+        bus->sim.runOn(*bus->slave_nodes[0], [&]() { value = slave->readCV(cv - 1); });
+        return value;
+    };
+
+    // A configuration of CVs in the manipulation range and below it
+    const uint16_t cvs[] = {910, 911, 1000, 20};
+    for (uint16_t cv : cvs) {
+        ASSERT_EQ(bus->api.writeCVIfDifferent(1, cv, cv & 0x7F), SUCCESS);
+        EXPECT_EQ(storedCV(cv), cv & 0x7F);
+    }
+    uint32_t writes = storedWrites();
+
+    // Applying it again writes nothing
+    for (uint16_t cv : cvs) {
+        EXPECT_EQ(bus->api.writeCVIfDifferent(1, cv, cv & 0x7F), SUCCESS);
+    }
+    EXPECT_EQ(storedWrites(), writes);
+
+    // Plain writes of the same values do reach the EEPROM
+    for (uint16_t cv : cvs) {
+        EXPECT_EQ(bus->api.writeCV(1, cv, cv & 0x7F), SUCCESS);
+    }
+    EXPECT_GT(storedWrites(), writes);
+
+    EXPECT_EQ(bus->api.verifyCV(1, 910, 0x0E), SUCCESS);
+    EXPECT_EQ(bus->api.verifyCV(1, 910, 0x0F), VERIFY_FAILED);
+    EXPECT_EQ(bus->api.verifyCV(1, 20, 0x15), VERIFY_FAILED);
+}
+
+TEST_F(SusiBusSimTest, CVBitsAreSetWithoutAReadBack) {
+    start();
+    SUSI_Slave* slave = bus->slaves[2];
+    auto storedCV = [&](uint16_t cv) {
+        uint8_t value = 0;
+        bus->sim.runOn(*bus->slave_nodes[2], [&]() { value = slave->readCV(cv - 1); });
+        return value;
+    };
+
+    ASSERT_EQ(bus->api.writeCV(3, 1010, 0x81), SUCCESS);
+    EXPECT_EQ(bus->api.setCVBit(3, 1010, 3, true), SUCCESS);
+    EXPECT_EQ(storedCV(1010), 0x89);
+    EXPECT_EQ(bus->api.setCVBit(3, 1010, 0, false), SUCCESS);
+    EXPECT_EQ(storedCV(1010), 0x88);
+
+    // A bit that is already set costs no write
+    SusiCVLogStats before, after;
+    bus->sim.runOn(*bus->slave_nodes[2], [&]() {
+        slave->flushCVs();
+        slave->getCVStorageStats(before);
+    });
+    EXPECT_EQ(bus->api.setCVBit(3, 1010, 7, true), SUCCESS);
+    bus->sim.runOn(*bus->slave_nodes[2], [&]() {
+        slave->flushCVs();
+        slave->getCVStorageStats(after);
+    });
+    EXPECT_EQ(after.cv_writes, before.cv_writes);
+
+    // Below the manipulation range the byte is read and written
+    ASSERT_EQ(bus->api.writeCV(3, 30, 0x01), SUCCESS);
+    EXPECT_EQ(bus->api.setCVBit(3, 30, 6, true), SUCCESS);
+    EXPECT_EQ(storedCV(30), 0x41);
+}
+
+TEST_F(SusiBusSimTest, ThreeBiDiSlavesArePolledInTurn) {
+    start();
+    for (int i = 0; i < SLAVES; i++) {
+        SUSI_Slave* slave = bus->slaves[i];
+        uint8_t value = 10 * (i + 1);
+        bus->sim.runOn(*bus->slave_nodes[i], [slave, value]() {
+            slave->enableBidirectionalMode();
+            slave->sendAnalogValue(0, value);
+        });
+        bus->api.registerBiDiSlave(i + 1);
+    }
+    bus->api.onBidiEvent(recordBidiEvent);
+
+    bus->api.pollSlaves();
+
+    ASSERT_EQ(bidi_events.size(), 3u);
+    for (int i = 0; i < SLAVES; i++) {
+        EXPECT_EQ(bidi_events[i][0], i + 1);
+        EXPECT_EQ(bidi_events[i][1], SUSI_MSG_BIDI_ANALOG_A);
+        EXPECT_EQ(bidi_events[i][2], 10 * (i + 1));
+    }
+}
+
+TEST_F(SusiBusSimTest, BiDiModuleThatDisappearsIsOnlyProbedUntilItReturns) {
+    start();
+    for (int i = 0; i < SLAVES; i++) {
+        SUSI_Slave* slave = bus->slaves[i];
+        bus->sim.runOn(*bus->slave_nodes[i], [slave]() { slave->enableBidirectionalMode(); });
+        bus->api.registerBiDiSlave(i + 1);
+    }
+    bus->api.onBidiEvent(recordBidiEvent);
+    SusiLinkStats stats;
+
+    // Module 2 disappears from the bus
+    SusiSimNode& node = *bus->slave_nodes[1];
+    bus->sim.runOn(node, [&]() { detachInterrupt(digitalPinToInterrupt(node.clockPin())); });
+    for (int i = 0; i < SUSI_LINK_QUARANTINE_ERRORS; i++) {
+        bus->api.pollSlaves();
+    }
+    ASSERT_TRUE(bus->api.getLinkStats(2, stats));
+    EXPECT_TRUE(stats.quarantined);
+    EXPECT_EQ(stats.timeouts, SUSI_LINK_QUARANTINE_ERRORS);
+
+    // A cycle of the two other modules takes a few ms, not the 20 ms timeout
+    uint64_t start_ns = bus->sim.now();
+    for (int i = 0; i < SUSI_LINK_PROBE_INTERVAL; i++) {
+        bus->api.pollSlaves();
+    }
+    uint64_t cycles_us = (bus->sim.now() - start_ns) / 1000;
+    EXPECT_LT(cycles_us, SUSI_LINK_PROBE_INTERVAL * 10000u + 20000u);
+    ASSERT_TRUE(bus->api.getLinkStats(2, stats));
+    EXPECT_EQ(stats.timeouts, SUSI_LINK_QUARANTINE_ERRORS + 1);
+    ASSERT_TRUE(bus->api.getLinkStats(1, stats));
+    EXPECT_EQ(stats.timeouts, 0);
+
+    // It comes back and is found by the next probe
+    SUSI_Slave* slave = bus->slaves[1];
+    bus->sim.runOn(node, [slave]() {
+        slave->begin(2);
+        slave->sendAnalogValue(0, 42);
+    });
+    bidi_events.clear();
+    for (int i = 0; i < SUSI_LINK_PROBE_INTERVAL; i++) {
+        bus->api.pollSlaves();
+    }
+    ASSERT_TRUE(bus->api.getLinkStats(2, stats));
+    EXPECT_FALSE(stats.quarantined);
+    EXPECT_EQ(stats.consecutive_errors, 0);
+    bool received = false;
+    for (const std::vector<uint8_t>& event : bidi_events) {
+        received = received || (event[0] == 2 && event[1] == SUSI_MSG_BIDI_ANALOG_A && event[2] == 42);
+    }
+    EXPECT_TRUE(received);
+}
+
+TEST_F(SusiBusSimTest, RoundTripLongerThanHalfAClockCorruptsBiDiResponse) {
+    // The master samples 10us after its falling edge. The edge has to reach the
+    // slave and the slave's bit has to come back within that time.
+    for (uint32_t propagation_ns : {2000u, 6000u}) {
+        SusiBusSimConfig config;
+        config.propagation_ns = propagation_ns;
+        start(config);
+        bidi_events.clear();
+        SUSI_Slave* slave = bus->slaves[0];
+        bus->sim.runOn(*bus->slave_nodes[0], [slave]() {
+            slave->enableBidirectionalMode();
+            slave->sendAnalogValue(0, 0x35);
+        });
+        bus->api.registerBiDiSlave(1);
+        bus->api.onBidiEvent(recordBidiEvent);
+        bus->api.pollSlaves();
+
+        bool received = bidi_events.size() == 1 && bidi_events[0][1] == SUSI_MSG_BIDI_ANALOG_A &&
+                        bidi_events[0][2] == 0x35;
+        EXPECT_EQ(received, propagation_ns == 2000u) << propagation_ns << "ns";
+        bus.reset();
+    }
+}
+
+TEST_F(SusiBusSimTest, NoiseIsDeterministicForASeed) {
+    int failures[2] = {0, 0};
+    uint64_t corrupted[2] = {0, 0};
+    for (int run = 0; run < 2; run++) {
+        SusiBusSimConfig config;
+        config.read_error_rate = 0.01;
+        config.jitter_ns = 500;
+        config.seed = 1234;
+        start(config);
+        for (int i = 0; i < 20; i++) {
+            if (bus->api.setSpeed(1 + i % SLAVES, i, true) != SUCCESS) {
+                failures[run]++;
+            }
+        }
+        corrupted[run] = bus->sim.stats().corrupted_reads;
+        bus.reset();
+    }
+    EXPECT_GT(corrupted[0], 0u);
+    EXPECT_GT(failures[0], 0);
+    EXPECT_EQ(failures[0], failures[1]);
+    EXPECT_EQ(corrupted[0], corrupted[1]);
+}
+
+TEST_F(SusiBusSimTest, NodesKeepTheirOwnClocks) {
+    start();
+    bus->slave_nodes[0]->setClockDrift(20000); // 2% fast
+    bus->sim.runFor(1000000);
+
+    unsigned long master_us = micros();
+    unsigned long slave_us = 0;
+    bus->sim.runOn(*bus->slave_nodes[0], [&]() { slave_us = micros(); });
+    EXPECT_NEAR((double)slave_us / master_us, 1.02, 0.001);
+
+    // Still within the tolerance of the protocol
+    EXPECT_EQ(bus->api.setSpeed(1, 20, false), SUCCESS);
+    EXPECT_EQ(bus->slaves[0]->getSpeed(), 20);
+}
+
+TEST_F(SusiBusSimTest, EdgesDuringABusyInterruptCollapseIntoOne) {
+    start(SusiBusSimConfig(), false);
+    SUSI_Slave* slave = bus->slaves[0];
+    bus->sim.runOn(*bus->slave_nodes[0], [slave]() { slave->enableBidirectionalMode(); });
+
+    // Without a timer the slave answers the host call's stop bit from its
+    // interrupt and holds the ACK for 1ms. The master clocks on without waiting
+    // for it, so most of its edges in that time are lost.
+    SUSI_Packet host_call = {0, SUSI_CMD_BIDI_HOST_CALL, 1};
+    bus->master.sendPacket(host_call, false);
+    for (int i = 0; i < 8; i++) {
+        bus->master.readByteFromSlave();
+    }
+    EXPECT_GT(bus->sim.stats().missed_edges, 0u);
+}
+
+TEST_F(SusiBusSimTest, IdleBusTimeIsCheap) {
+    start();
+    EXPECT_EQ(bus->api.setSpeed(1, 10, true), SUCCESS);
+    uint64_t events = bus->sim.stats().events;
+
+    auto wall_start = std::chrono::steady_clock::now();
+    bus->sim.runFor(3600UL * 1000000); // An hour
+    EXPECT_EQ(bus->api.setSpeed(1, 11, true), SUCCESS);
+    auto wall = std::chrono::steady_clock::now() - wall_start;
+
+    EXPECT_EQ(bus->slaves[0]->getSpeed(), 11);
+    EXPECT_LT(bus->sim.stats().events - events, 2 * (events + 10));
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(wall).count(), 1000);
+}
+
+TEST_F(SusiBusSimTest, SimulatesAnHourOfLightTrafficPerCpuSecond) {
+    start();
+    // A speed refresh of every slave each 5 s, for an hour of bus time
+    std::clock_t cpu_start = std::clock();
+    for (int round = 0; round < 720; round++) {
+        for (int i = 0; i < SLAVES; i++) {
+            ASSERT_EQ(bus->api.setSpeed(i + 1, round & 0x7F, true), SUCCESS);
+        }
+        bus->sim.runFor(5000000);
+    }
+    double cpu_s = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    EXPECT_GE(bus->sim.now(), 3600ULL * 1000000000);
+    EXPECT_LT(cpu_s, 1.0);
+}
+
+TEST_F(SusiBusSimTest, SaturatedBusMissesTheHoursPerCpuSecondTarget) {
+    start();
+    // The target of hours of bus time per CPU second is NOT met here. With
+    // acknowledged packets back to back every clock edge is an event that runs
+    // the interrupt handler of each slave, so the cost grows with the bus time
+    // instead of the packet count. This only checks the simulator stays at
+    // least twice as fast as real time.
+    uint64_t start_ns = bus->sim.now();
+    std::clock_t cpu_start = std::clock();
+    for (int n = 0; bus->sim.now() - start_ns < 5000000000ULL; n++) {
+        ASSERT_EQ(bus->api.setSpeed(1 + n % SLAVES, n & 0x7F, true), SUCCESS);
+    }
+    double cpu_s = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    ::testing::Test::RecordProperty("saturated_bus_ms_per_cpu_s", (int)(5000 / cpu_s));
+    EXPECT_LT(cpu_s, 2.5) << "5 s of saturated bus time";
+}
+
+TEST_F(SusiBusSimTest, IdleBusCountsTowardTheSyncGap) {
+    SusiBusSimConfig config;
+    config.record_activity = true;
+    start(config);
+
+    bus->sim.runFor(20000);
+    uint64_t start_ns = bus->sim.now();
+    for (int i = 0; i < 100; i++) {
+        SUSI_Packet packet = {(uint8_t)(1 + i % SLAVES), SUSI_CMD_SET_SPEED, (uint8_t)(0x80 | i)};
+        ASSERT_EQ(bus->master.sendPacket(packet, true), SUCCESS);
+    }
+    EXPECT_EQ(bus->slaves[0]->getSpeed(), 99);
+    EXPECT_EQ(bus->slaves[2]->getSpeed(), 98);
+
+    // The idle bus is the first sync gap: 4 gaps of 9 ms for 100 commands
+    std::vector<uint64_t> gaps = bus->sim.clockPauses(start_ns, bus->sim.now(), 7000000);
+    ASSERT_EQ(gaps.size(), 4u);
+    for (uint64_t gap : gaps) {
+        EXPECT_GE(gap, 9000000u);
+        EXPECT_LT(gap, 9100000u);
+    }
+}
+
+TEST_F(SusiBusSimTest, SyncGapIsMeasuredFromTheLastPacket) {
+    start();
+    SUSI_Packet packet = {1, SUSI_CMD_SET_SPEED, 0x85};
+    bus->sim.runFor(20000);
+    for (int i = 0; i < 20; i++) {
+        ASSERT_EQ(bus->master.sendPacket(packet, true), SUCCESS);
+    }
+
+    unsigned long remaining = bus->master.syncGapRemaining(packet);
+    EXPECT_GT(remaining, 8000u);
+    EXPECT_LE(remaining, 9000u);
+    bus->sim.runFor(5000);
+    EXPECT_LE(bus->master.syncGapRemaining(packet), remaining - 5000);
+    bus->sim.runFor(4000);
+    EXPECT_EQ(bus->master.syncGapRemaining(packet), 0u);
+
+    // Only the packet and its ACK
+    uint64_t start_ns = bus->sim.now();
+    ASSERT_EQ(bus->master.sendPacket(packet, true), SUCCESS);
+    EXPECT_LT(bus->sim.now() - start_ns, 2000000u);
+}
+
+namespace {
+struct IdleWork {
+    SusiBusSim* sim;
+    SUSI_Master* master;
+    const SUSI_Packet* next;
+    int calls;
+    int calls_outside_gap;
+};
+
+void doIdleWork(void* context) {
+    IdleWork* work = static_cast<IdleWork*>(context);
+    work->calls++;
+    if (work->master->syncGapRemaining(*work->next) == 0) {
+        work->calls_outside_gap++;
+    }
+    delayMicroseconds(250); // E.g. a motor control step
+}
+} // namespace
+
+TEST_F(SusiBusSimTest, IdleHookRunsDuringSyncGaps) {
+    SusiBusSimConfig config;
+    config.record_activity = true;
+    start(config);
+    SUSI_Packet packet = {2, SUSI_CMD_SET_SPEED, 0x80};
+    IdleWork work = {&bus->sim, &bus->master, &packet, 0, 0};
+    bus->master.onIdle(doIdleWork, &work);
+
+    bus->sim.runFor(20000);
+    uint64_t start_ns = bus->sim.now();
+    for (int i = 0; i < 100; i++) {
+        packet.data = 0x80 | i;
+        ASSERT_EQ(bus->master.sendPacket(packet, true), SUCCESS);
+    }
+    uint64_t end_ns = bus->sim.now();
+    EXPECT_EQ(bus->slaves[1]->getSpeed(), 99);
+
+    // 4 gaps of 9 ms less the ACK, filled with calls of 250 us
+    EXPECT_GE(work.calls, 4 * 30);
+    EXPECT_LE(work.calls, 4 * 36);
+    EXPECT_EQ(work.calls_outside_gap, 0);
+
+    // On the clock line, no gap was cut short or overrun by more than a call
+    std::vector<uint64_t> gaps = bus->sim.clockPauses(start_ns, end_ns, 7000000);
+    ASSERT_EQ(gaps.size(), 4u);
+    for (uint64_t gap : gaps) {
+        EXPECT_GE(gap, 9000000u);
+        EXPECT_LT(gap, 9300000u);
+    }
+}
+
+TEST_F(SusiBusSimTest, BankReadsAllowFiftyCommandsBetweenSyncGaps) {
+    SusiBusSimConfig config;
+    config.record_activity = true;
+    start(config);
+
+    // 60 commands need 2 sync gaps
+    bus->sim.runFor(20000);
+    uint64_t start_ns = bus->sim.now();
+    for (int i = 0; i < 60; i++) {
+        ASSERT_EQ(bus->api.setSpeed(1 + i % SLAVES, i, true), SUCCESS);
+    }
+    EXPECT_EQ(bus->sim.clockPauses(start_ns, bus->sim.now(), 7000000).size(), 2u);
+
+    // 60 bank reads, answered by the slaves, only 1
+    bus->sim.runFor(20000);
+    start_ns = bus->sim.now();
+    uint8_t data[SUSI_CV_BANK_SIZE];
+    for (int i = 0; i < 60; i++) {
+        ASSERT_EQ(bus->api.readCVBank(1 + i % SLAVES, 0, data), SUCCESS); // CRC checked
+    }
+    std::vector<uint64_t> gaps = bus->sim.clockPauses(start_ns, bus->sim.now(), 7000000);
+    ASSERT_EQ(gaps.size(), 1u);
+    EXPECT_GE(gaps[0], 9000000u);
+}
+
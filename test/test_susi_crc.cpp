@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include "susi_crc.h"
+#include <cstring>
+
+namespace {
+
+const uint8_t CHECK_DATA[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+typedef SusiCRC<uint16_t, 16, 0x1021, 0xFFFF, false, false> CRC16Bytes;
+typedef SusiCRC<uint16_t, 16, 0x1021, 0xFFFF, false, true> CRC16Nibbles;
+typedef SusiCRC<uint8_t, 8, 0x31, 0x00, true, false> CRC8Bytes;
+typedef SusiCRC<uint8_t, 8, 0x31, 0x00, true, true> CRC8Nibbles;
+
+// The tables are built by the compiler
+static_assert(CRC8Bytes::entry(1) == 0x5E, "RCN-218 CRC-8 table");
+static_assert(CRC8Nibbles::entry(1) == 0x9D, "RCN-218 CRC-8 nibble table");
+static_assert(CRC16Bytes::entry(1) == 0x1021, "CRC-16-CCITT table");
+static_assert(CRC16Bytes::entry(0x80) == 0x9188, "CRC-16-CCITT table");
+
+// Bit by bit, MSB first, for any width
+uint16_t referenceCRC(const uint8_t* data, int length, uint8_t width, uint16_t poly, uint16_t init) {
+    uint16_t top = 1 << (width - 1);
+    uint16_t mask = (1UL << width) - 1;
+    uint16_t crc = init;
+    for (int i = 0; i < length; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            bool feedback = ((crc & top) != 0) != (((data[i] >> bit) & 1) != 0);
+            crc = (crc << 1) & mask;
+            if (feedback) {
+                crc ^= poly;
+            }
+        }
+    }
+    return crc;
+}
+
+} // namespace
+
+TEST(SusiCRCTest, CRC16MatchesItsCheckValue) {
+    EXPECT_EQ(crc16_ccitt(CHECK_DATA, sizeof(CHECK_DATA)), 0x29B1);
+    EXPECT_EQ(CRC16Nibbles::compute(CHECK_DATA, sizeof(CHECK_DATA)), 0x29B1);
+}
+
+TEST(SusiCRCTest, CRC8MatchesRCN218) {
+    EXPECT_EQ(crc8_rcn218(CHECK_DATA, sizeof(CHECK_DATA)), 0xA1);
+    EXPECT_EQ(CRC8Nibbles::compute(CHECK_DATA, sizeof(CHECK_DATA)), 0xA1);
+    EXPECT_EQ(crc8_rcn218(nullptr, 0), 0);
+}
+
+TEST(SusiCRCTest, CRC8OverDataAndCRCIsZero) {
+    uint8_t data[41];
+    for (int i = 0; i < 40; i++) {
+        data[i] = i * 13 + 7;
+    }
+    data[40] = crc8_rcn218(data, 40);
+    EXPECT_EQ(crc8_rcn218(data, 41), 0);
+
+    data[3] ^= 0x10;
+    EXPECT_NE(crc8_rcn218(data, 41), 0);
+}
+
+TEST(SusiCRCTest, IncrementalUpdateMatchesBlock) {
+    SusiCRC16 crc16;
+    SusiCRC8 crc8;
+    for (size_t i = 0; i < sizeof(CHECK_DATA); i++) {
+        crc16.update(CHECK_DATA[i]);
+        crc8.update(CHECK_DATA[i]);
+    }
+    EXPECT_EQ(crc16.value(), 0x29B1);
+    EXPECT_EQ(crc8.value(), 0xA1);
+
+    crc8.reset();
+    crc8.update(CHECK_DATA, 4);
+    crc8.update(CHECK_DATA + 4, sizeof(CHECK_DATA) - 4);
+    EXPECT_EQ(crc8.value(), 0xA1);
+}
+
+TEST(SusiCRCTest, OtherPolynomialsAndWidths) {
+    // CRC-8 with polynomial 0x07, MSB first
+    EXPECT_EQ((SusiCRC<uint8_t, 8, 0x07, 0x00, false>::compute(CHECK_DATA, sizeof(CHECK_DATA))), 0xF4);
+    // CRC-16/ARC: polynomial 0x8005, LSB first
+    EXPECT_EQ((SusiCRC<uint16_t, 16, 0x8005, 0x0000, true>::compute(CHECK_DATA, sizeof(CHECK_DATA))), 0xBB3D);
+    EXPECT_EQ((SusiCRC<uint16_t, 16, 0x8005, 0x0000, true, true>::compute(CHECK_DATA, sizeof(CHECK_DATA))), 0xBB3D);
+
+    // A 10-bit CRC against the bitwise reference
+    uint8_t data[64];
+    for (int i = 0; i < 64; i++) {
+        data[i] = i * 29 + 3;
+    }
+    uint16_t expected = referenceCRC(data, sizeof(data), 10, 0x233, 0x000);
+    EXPECT_EQ((SusiCRC<uint16_t, 10, 0x233, 0x000, false>::compute(data, sizeof(data))), expected);
+    EXPECT_EQ((SusiCRC<uint16_t, 10, 0x233, 0x000, false, true>::compute(data, sizeof(data))), expected);
+}
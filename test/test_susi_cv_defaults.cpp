@@ -0,0 +1,179 @@
+#include "gtest/gtest.h"
+#include "susi_cv_defaults.h"
+#include "susi_slave.h"
+#include "mock_susi_hal.h"
+#include "susi_commands.h"
+#include <EEPROM.h>
+
+const SusiCVDefault TEST_CV_DEFAULTS[] PROGMEM = {
+    {1, 3}, {2, 10}, {3, 20}, {45, 7}, {300, 128}, {1000, 9}
+};
+const uint16_t TEST_CV_DEFAULT_COUNT = sizeof(TEST_CV_DEFAULTS) / sizeof(TEST_CV_DEFAULTS[0]);
+
+TEST(SusiCVDefaults, FindsEveryEntry) {
+    SusiCVDefaults defaults;
+    ASSERT_TRUE(defaults.set(TEST_CV_DEFAULTS, TEST_CV_DEFAULT_COUNT));
+    EXPECT_EQ(defaults.size(), TEST_CV_DEFAULT_COUNT);
+
+    for (const SusiCVDefault& entry : TEST_CV_DEFAULTS) {
+        uint8_t value = 0;
+        EXPECT_TRUE(defaults.get(entry.cv, value));
+        EXPECT_EQ(value, entry.value);
+    }
+
+    uint8_t value = 0xAA;
+    EXPECT_FALSE(defaults.get(4, value));
+    EXPECT_FALSE(defaults.get(0, value));
+    EXPECT_FALSE(defaults.get(1023, value));
+    EXPECT_EQ(value, 0xAA);
+}
+
+TEST(SusiCVDefaults, RejectsUnsortedTable) {
+    const SusiCVDefault unsorted[] = {{5, 1}, {4, 2}};
+    const SusiCVDefault duplicate[] = {{5, 1}, {5, 2}};
+    SusiCVDefaults defaults;
+    EXPECT_FALSE(defaults.set(unsorted, 2));
+    EXPECT_FALSE(defaults.set(duplicate, 2));
+    EXPECT_EQ(defaults.size(), 0);
+
+    uint8_t value;
+    EXPECT_FALSE(defaults.get(5, value));
+}
+
+// A slave with a defaults table, restarted against the same mock EEPROM.
+class SusiSlaveCVDefaultsTest : public ::testing::Test {
+protected:
+    MockSusiHAL hal;
+    SUSI_Slave slave;
+
+    SusiSlaveCVDefaultsTest() : slave(hal) {}
+
+    void SetUp() override {
+        mock_hal_reset();
+        EEPROM.write_latency_us = 0;
+        EEPROM.read_latency_us = 0;
+        EEPROM.clear();
+        ASSERT_TRUE(slave.setCVDefaults(TEST_CV_DEFAULTS, TEST_CV_DEFAULT_COUNT));
+        slave.begin(1);
+        slave.flushCVs(); // Format the EEPROM
+    }
+
+    void writeCV(uint16_t cv, uint8_t value) {
+        SUSI_Packet p = {1, SUSI_CMD_WRITE_CV, (uint8_t)((cv >> 8) & 0xFF)};
+        slave._test_receive_packet(p);
+        slave.read();
+        p.command = cv & 0xFF;
+        p.data = value;
+        slave._test_receive_packet(p);
+        slave.read();
+    }
+
+    uint8_t readAfterRestart(uint16_t cv) {
+        SUSI_Slave restarted(hal);
+        restarted.setCVDefaults(TEST_CV_DEFAULTS, TEST_CV_DEFAULT_COUNT);
+        restarted.begin(1);
+        return restarted.readCV(cv);
+    }
+
+    uint32_t eepromWrites() {
+        SusiCVLogStats stats;
+        slave.getCVStorageStats(stats);
+        return stats.eeprom_writes;
+    }
+};
+
+TEST_F(SusiSlaveCVDefaultsTest, ReadsDefaultsWithoutStoringThem) {
+    EXPECT_EQ(slave.readCV(2), 10);
+    EXPECT_EQ(slave.readCV(300), 128);
+    EXPECT_EQ(slave.readCV(4), 0);
+
+    // Writing the default again needs neither RAM nor EEPROM.
+    uint32_t writes = eepromWrites();
+    writeCV(2, 10);
+    slave.flushCVs();
+    EXPECT_EQ(eepromWrites(), writes);
+}
+
+TEST_F(SusiSlaveCVDefaultsTest, OverrideReturnsToDefault) {
+    writeCV(300, 1);
+    slave.flushCVs();
+    EXPECT_EQ(slave.readCV(300), 1);
+    EXPECT_EQ(readAfterRestart(300), 1);
+
+    // Writing the default drops the override and survives a restart.
+    writeCV(300, 128);
+    slave.flushCVs();
+    EXPECT_EQ(slave.readCV(300), 128);
+    EXPECT_EQ(readAfterRestart(300), 128);
+}
+
+TEST_F(SusiSlaveCVDefaultsTest, BankImageIncludesDefaults) {
+    writeCV(45, 99);
+
+    std::vector<uint8_t> sent;
+    hal.onSendByte = [&](uint8_t byte) { sent.push_back(byte); };
+    SUSI_Packet p = {1, SUSI_CMD_READ_CV_BANK_0, 0};
+    slave._test_receive_packet(p);
+    slave.read();
+    p.command = SUSI_CMD_READ_CV_BANK_1;
+    slave._test_receive_packet(p);
+    slave.read();
+
+    ASSERT_EQ(sent.size(), 2 * (SUSI_CV_BANK_SIZE + 2u));
+    EXPECT_EQ(sent[1], 3);
+    EXPECT_EQ(sent[3], 20);
+    EXPECT_EQ(sent[4], 0);
+    // Bank 1 starts at CV 40, CV 45 is overridden
+    EXPECT_EQ(sent[SUSI_CV_BANK_SIZE + 2 + 5], 99);
+}
+
+TEST_F(SusiSlaveCVDefaultsTest, FactoryResetDropsAllOverrides) {
+    for (uint16_t cv = 100; cv < 120; cv++) {
+        writeCV(cv, 1);
+    }
+    writeCV(1, 50);
+    slave.flushCVs();
+    EXPECT_EQ(readAfterRestart(1), 50);
+
+    uint32_t writes = eepromWrites();
+    slave.resetCVs();
+    EXPECT_EQ(slave.readCV(1), 3);
+    EXPECT_EQ(slave.readCV(110), 0);
+
+    // Only the header of the other log half is written.
+    slave.flushCVs();
+    EXPECT_LE(eepromWrites() - writes, 7u);
+    EXPECT_EQ(readAfterRestart(1), 3);
+    EXPECT_EQ(readAfterRestart(110), 0);
+}
+
+TEST_F(SusiSlaveCVDefaultsTest, ResetDuringCompactionKeepsNoStaleRecords) {
+    for (uint16_t cv = 100; cv < 120; cv++) {
+        writeCV(cv, 1);
+        slave.flushCVs();
+    }
+    // Fill the 49 slots of the log half so the next write starts a compaction,
+    // then let a few of its records reach the EEPROM before resetting.
+    for (int i = 0; i < 29; i++) {
+        writeCV(100, i + 2);
+        slave.flushCVs();
+    }
+    SusiCVLogStats stats;
+    slave.getCVStorageStats(stats);
+    uint16_t compactions = stats.compactions;
+    writeCV(101, 77);
+    for (int i = 0; i < 30; i++) {
+        slave.available();
+    }
+    slave.getCVStorageStats(stats);
+    ASSERT_EQ(stats.compactions, compactions);
+    ASSERT_GT(slave.pendingCVWrites(), 0);
+
+    slave.resetCVs();
+    slave.flushCVs();
+
+    for (uint16_t cv = 100; cv < 120; cv++) {
+        EXPECT_EQ(readAfterRestart(cv), 0);
+    }
+    EXPECT_EQ(readAfterRestart(2), 10);
+}
@@ -0,0 +1,178 @@
+#include "gtest/gtest.h"
+#include "susi_cv_registry.h"
+#include "susi_slave.h"
+#include "susi_commands.h"
+#include "mock_susi_hal.h"
+#include "susi_crc.h"
+#include <vector>
+
+namespace {
+    uint8_t temperature = 0;
+    uint16_t last_written_cv = 0;
+    uint8_t last_written_value = 0;
+
+    uint8_t read_temperature(uint16_t cv, void* context) {
+        (void)cv;
+        return temperature + *static_cast<uint8_t*>(context);
+    }
+
+    void record_write(uint16_t cv, uint8_t value, void* context) {
+        (void)context;
+        last_written_cv = cv;
+        last_written_value = value;
+    }
+}
+
+TEST(SusiCVRegistry, MemoryBinding) {
+    SusiCVRegistry registry;
+    uint8_t memory[3] = {1, 2, 3};
+    ASSERT_TRUE(registry.bindMemory(100, 3, memory, true));
+
+    uint8_t value = 0;
+    EXPECT_TRUE(registry.read(101, 0, value));
+    EXPECT_EQ(value, 2);
+    EXPECT_FALSE(registry.read(103, 0, value));
+    EXPECT_FALSE(registry.read(99, 0, value));
+
+    EXPECT_TRUE(registry.write(102, 0, 42));
+    EXPECT_EQ(memory[2], 42);
+}
+
+TEST(SusiCVRegistry, ReadOnlyMemoryIgnoresWrites) {
+    SusiCVRegistry registry;
+    uint8_t memory = 5;
+    ASSERT_TRUE(registry.bindMemory(10, 1, &memory, false));
+
+    EXPECT_TRUE(registry.write(10, 0, 6));
+    EXPECT_EQ(memory, 5);
+}
+
+TEST(SusiCVRegistry, CallbackBinding) {
+    SusiCVRegistry registry;
+    uint8_t offset = 10;
+    ASSERT_TRUE(registry.bind(950, 2, read_temperature, record_write, &offset));
+
+    temperature = 21;
+    uint8_t value = 0;
+    EXPECT_TRUE(registry.read(951, 0, value));
+    EXPECT_EQ(value, 31);
+
+    EXPECT_TRUE(registry.write(950, 0, 7));
+    EXPECT_EQ(last_written_cv, 950);
+    EXPECT_EQ(last_written_value, 7);
+}
+
+TEST(SusiCVRegistry, BankQualifiedRanges) {
+    SusiCVRegistry registry;
+    uint8_t bank_0[2] = {0x12, 0x34};
+    uint8_t bank_1[2] = {0x56, 0x78};
+    registry.bindMemory(900, 2, bank_0, false, 0);
+    registry.bindMemory(900, 2, bank_1, false, 1);
+
+    uint8_t value = 0;
+    EXPECT_TRUE(registry.read(900, 0, value));
+    EXPECT_EQ(value, 0x12);
+    EXPECT_TRUE(registry.read(901, 1, value));
+    EXPECT_EQ(value, 0x78);
+
+    // Bound for other banks only: reads as 0, not as a regular CV
+    value = 0xFF;
+    EXPECT_TRUE(registry.read(900, 2, value));
+    EXPECT_EQ(value, 0);
+}
+
+TEST(SusiCVRegistry, OverlappingAndSpanningRanges) {
+    SusiCVRegistry registry;
+    uint8_t large[100] = {0};
+    uint8_t single = 9;
+    large[60] = 60;
+    registry.bindMemory(520, 100, large, false);   // Spans several pages
+    registry.bindMemory(580, 1, &single, false);   // Inside the large range
+    registry.bindMemory(10, 1, &single, false);
+
+    uint8_t value = 0;
+    EXPECT_TRUE(registry.read(580, 0, value));
+    EXPECT_EQ(value, 60); // The range that starts first wins
+    EXPECT_TRUE(registry.read(619, 0, value));
+    EXPECT_FALSE(registry.read(620, 0, value));
+    EXPECT_TRUE(registry.read(10, 0, value));
+    EXPECT_EQ(value, 9);
+    EXPECT_EQ(registry.size(), 3);
+}
+
+TEST(SusiCVRegistry, RejectsWhenFullOrOutOfRange) {
+    SusiCVRegistry registry;
+    uint8_t memory = 0;
+    EXPECT_FALSE(registry.bindMemory(1020, 8, &memory, false));
+    EXPECT_FALSE(registry.bindMemory(5, 0, &memory, false));
+    for (int i = 0; i < SUSI_CV_REGISTRY_SIZE; i++) {
+        EXPECT_TRUE(registry.bindMemory(i * 2, 1, &memory, false));
+    }
+    EXPECT_FALSE(registry.bindMemory(500, 1, &memory, false));
+
+    registry.clear();
+    EXPECT_EQ(registry.size(), 0);
+    EXPECT_FALSE(registry.read(0, 0, memory));
+}
+
+TEST(SusiCVRegistry, SlaveServesBoundCVs) {
+    MockSusiHAL hal;
+    SUSI_Slave slave(hal);
+    slave.begin(1);
+    slave.flushCVs(); // Format the EEPROM
+
+    uint8_t volume = 80;
+    uint8_t offset = 0;
+    ASSERT_TRUE(slave.bindCVMemory(960, 1, &volume, true));
+    ASSERT_TRUE(slave.bindCVs(961, 1, read_temperature, nullptr, &offset));
+    temperature = 23;
+
+    EXPECT_EQ(slave.readCV(960), 80);
+    EXPECT_EQ(slave.readCV(961), 23);
+
+    // A CV write from the master goes to the bound memory
+    slave._test_receive_packet({1, SUSI_CMD_WRITE_CV, (960 >> 8) & 0xFF});
+    slave.read();
+    slave._test_receive_packet({1, 960 & 0xFF, 50});
+    slave.read();
+    EXPECT_EQ(volume, 50);
+    EXPECT_EQ(slave.pendingCVWrites(), 0);
+}
+
+TEST(SusiCVRegistry, BankReadMatchesCVReadsOfBoundCVs) {
+    MockSusiHAL hal;
+    SUSI_Slave slave(hal);
+    slave.begin(1);
+
+    uint8_t memory[2] = {11, 12};
+    uint8_t offset = 0;
+    temperature = 30;
+    ASSERT_TRUE(slave.bindCVMemory(42, 2, memory, true));
+    ASSERT_TRUE(slave.bindCVs(45, 1, read_temperature, nullptr, &offset));
+
+    std::vector<uint8_t> sent;
+    hal.onSendByte = [&](uint8_t byte) { sent.push_back(byte); };
+    auto readBank = [&]() {
+        sent.clear();
+        slave._test_receive_packet({1, SUSI_CMD_READ_CV_BANK_1, 0});
+        slave.read();
+    };
+
+    readBank();
+    ASSERT_EQ(sent.size(), 42u);
+    for (int i = 0; i < 40; i++) {
+        EXPECT_EQ(sent[i], slave.readCV(40 + i)) << "CV " << 40 + i;
+    }
+    EXPECT_EQ(sent[2], 11);
+    EXPECT_EQ(sent[5], 30);
+    EXPECT_EQ(sent[40], crc8_rcn218(sent.data(), 40));
+
+    // Bound values change without a CV write
+    memory[1] = 99;
+    temperature = 31;
+    readBank();
+    ASSERT_EQ(sent.size(), 42u);
+    EXPECT_EQ(sent[3], 99);
+    EXPECT_EQ(sent[5], 31);
+    EXPECT_EQ(sent[40], crc8_rcn218(sent.data(), 40));
+}
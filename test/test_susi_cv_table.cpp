@@ -0,0 +1,108 @@
+#include "gtest/gtest.h"
+#include "susi_cv_table.h"
+
+TEST(SusiCVTable, StoresWholeWindow) {
+    SusiCVTable table;
+
+    for (uint16_t cv = SUSI_CV_WINDOW_START; cv < 1024; cv++) {
+        EXPECT_TRUE(table.set(cv, cv & 0xFF));
+    }
+    EXPECT_EQ(table.size(), 1024 - SUSI_CV_WINDOW_START);
+
+    for (uint16_t cv = SUSI_CV_WINDOW_START; cv < 1024; cv++) {
+        uint8_t value = 0;
+        EXPECT_TRUE(table.get(cv, value));
+        EXPECT_EQ(value, cv & 0xFF);
+    }
+}
+
+TEST(SusiCVTable, SparseCVsAreKeptSorted) {
+    SusiCVTable table;
+    uint16_t cvs[] = { 500, 3, 120, 7, 899, 250 };
+
+    for (uint16_t cv : cvs) {
+        EXPECT_TRUE(table.set(cv, cv / 4));
+    }
+    EXPECT_TRUE(table.set(120, 1)); // Update, no new entry
+    EXPECT_EQ(table.size(), 6);
+
+    uint16_t expected[] = { 3, 7, 120, 250, 500, 899 };
+    uint16_t cv = 0;
+    uint8_t value;
+    for (uint16_t want : expected) {
+        ASSERT_TRUE(table.next(cv, value));
+        EXPECT_EQ(cv, want);
+        EXPECT_EQ(value, want == 120 ? 1 : want / 4);
+        cv++;
+    }
+    EXPECT_FALSE(table.next(cv, value));
+
+    EXPECT_FALSE(table.get(4, value));
+}
+
+TEST(SusiCVTable, FullTableRejectsNewCVs) {
+    SusiCVTable table;
+
+    for (uint16_t cv = 0; cv < SUSI_CV_SPARSE_CAPACITY; cv++) {
+        EXPECT_TRUE(table.set(cv * 3, 1));
+    }
+    EXPECT_FALSE(table.set(1, 2));
+    EXPECT_TRUE(table.set(3, 2)); // Existing CVs can still be changed
+    EXPECT_TRUE(table.set(SUSI_CV_WINDOW_START, 3)); // The window has its own pages
+    EXPECT_FALSE(table.set(1024, 4));
+    EXPECT_EQ(table.size(), SUSI_CV_SPARSE_CAPACITY + 1);
+}
+
+TEST(SusiCVTable, NextMergesWindowAndSparseCVs) {
+    SusiCVTable table;
+    table.set(1000, 10);
+    table.set(900, 20);
+    table.set(40, 30);
+    table.set(1023, 40);
+
+    uint16_t cv = 41;
+    uint8_t value;
+    ASSERT_TRUE(table.next(cv, value));
+    EXPECT_EQ(cv, 900);
+    EXPECT_EQ(value, 20);
+
+    cv = 901;
+    ASSERT_TRUE(table.next(cv, value));
+    EXPECT_EQ(cv, 1000);
+
+    cv = 1001;
+    ASSERT_TRUE(table.next(cv, value));
+    EXPECT_EQ(cv, 1023);
+    EXPECT_EQ(value, 40);
+
+    table.clear();
+    cv = 0;
+    EXPECT_FALSE(table.next(cv, value));
+    EXPECT_EQ(table.size(), 0);
+}
+
+TEST(SusiCVTable, EraseRemovesWindowAndSparseCVs) {
+    SusiCVTable table;
+    table.set(10, 1);
+    table.set(20, 2);
+    table.set(30, 3);
+    table.set(SUSI_CV_WINDOW_START + 5, 4);
+
+    EXPECT_TRUE(table.erase(20));
+    EXPECT_TRUE(table.erase(SUSI_CV_WINDOW_START + 5));
+    EXPECT_FALSE(table.erase(20));
+    EXPECT_FALSE(table.erase(SUSI_CV_WINDOW_START + 6));
+    EXPECT_EQ(table.size(), 2);
+
+    uint8_t value;
+    EXPECT_FALSE(table.get(20, value));
+    EXPECT_FALSE(table.get(SUSI_CV_WINDOW_START + 5, value));
+    EXPECT_TRUE(table.get(30, value));
+    EXPECT_EQ(value, 3);
+
+    // The freed sparse entry can be reused.
+    EXPECT_TRUE(table.set(25, 5));
+    uint16_t cv = 11;
+    EXPECT_TRUE(table.next(cv, value));
+    EXPECT_EQ(cv, 25);
+}
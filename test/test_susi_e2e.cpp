@@ -3,8 +3,10 @@
 #include "susi_slave.h"
 #include "mock_hal.h"
 #include "mock_susi_hal.h"
+#include "mock_susi_transport.h"
 #include "susi_commands.h"
 #include "susi_crc.h"
+#include <vector>
 
 // Test fixture for End-to-End tests
 class LegacySusiE2ETest : public ::testing::Test {
@@ -14,15 +16,15 @@ protected:
     const uint8_t SLAVE_ADDRESS = 1;
 
     MockSusiHAL hal;
+    MockSusiTransport transport;
     SUSI_Master master;
     SUSI_Master_API api;
     SUSI_Slave slave;
 
-    LegacySusiE2ETest() : master(hal), api(master), slave(hal) {}
+    LegacySusiE2ETest() : transport(hal), master(transport), api(master), slave(hal) {}
 
     void SetUp() override {
         mock_hal_reset();
-        _susi_slave_instance = &slave;
         api.begin();
         slave.begin(SLAVE_ADDRESS);
         // Set initial clock state to HIGH
@@ -33,11 +35,11 @@ protected:
 };
 
 TEST_F(LegacySusiE2ETest, setFunction) {
-    hal.ack_result = SUCCESS;
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.ack_result = SUCCESS;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         slave._test_receive_packet(p);
     };
-    hal.afterSendPacket = [&]() {
+    transport.afterSendPacket = [&]() {
         EXPECT_TRUE(slave.available());
         slave.read();
         EXPECT_TRUE(slave.getFunction(5));
@@ -46,12 +48,41 @@ TEST_F(LegacySusiE2ETest, setFunction) {
     EXPECT_EQ(api.setFunction(SLAVE_ADDRESS, 5, true), SUCCESS);
 }
 
+TEST_F(LegacySusiE2ETest, setOutputsUpdatesWholeBanksWithOnePacketEach) {
+    int packets = 0;
+    transport.ack_result = SUCCESS;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+        packets++;
+        slave._test_receive_packet(p);
+    };
+    transport.afterSendPacket = [&]() {
+        EXPECT_TRUE(slave.available());
+        slave.read();
+    };
+
+    // All 32 outputs: 4 packets instead of 32 function commands
+    EXPECT_EQ(api.setOutputs(SLAVE_ADDRESS, 0xF00FF00F), SUCCESS);
+    EXPECT_EQ(packets, 4);
+    EXPECT_EQ(slave.getOutputs(), 0xF00FF00Fu);
+
+    // One bank changes
+    packets = 0;
+    EXPECT_EQ(api.setOutputs(SLAVE_ADDRESS, 0xF00F0FF0), SUCCESS);
+    EXPECT_EQ(packets, 2);
+    EXPECT_EQ(slave.getOutputs(), 0xF00F0FF0u);
+
+    // Nothing changes
+    packets = 0;
+    EXPECT_EQ(api.setOutputs(SLAVE_ADDRESS, 0xF00F0FF0), SUCCESS);
+    EXPECT_EQ(packets, 0);
+}
+
 TEST_F(LegacySusiE2ETest, setSpeed) {
-    hal.ack_result = SUCCESS;
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.ack_result = SUCCESS;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         slave._test_receive_packet(p);
     };
-    hal.afterSendPacket = [&]() {
+    transport.afterSendPacket = [&]() {
         EXPECT_TRUE(slave.available());
         slave.read();
         EXPECT_EQ(slave.getSpeed(), 100);
@@ -62,11 +93,11 @@ TEST_F(LegacySusiE2ETest, setSpeed) {
 }
 
 TEST_F(LegacySusiE2ETest, writeCV) {
-    hal.ack_result = SUCCESS;
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.ack_result = SUCCESS;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         slave._test_receive_packet(p);
     };
-    hal.afterSendPacket = [&]() {
+    transport.afterSendPacket = [&]() {
         EXPECT_TRUE(slave.available());
         slave.read();
     };
@@ -75,11 +106,11 @@ TEST_F(LegacySusiE2ETest, writeCV) {
 }
 
 TEST_F(LegacySusiE2ETest, readCV) {
-    hal.ack_result = SUCCESS;
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.ack_result = SUCCESS;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         slave._test_receive_packet(p);
     };
-    hal.afterSendPacket = [&]() {
+    transport.afterSendPacket = [&]() {
         EXPECT_TRUE(slave.available());
         slave.read();
     };
@@ -114,18 +145,18 @@ namespace {
 }
 
 TEST_F(LegacySusiE2ETest, Handshake) {
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         if (p.command == SUSI_CMD_BIDI_HOST_CALL && (p.data & 0x04) != 0) {
             if ((p.data & 0x03) == SLAVE_ADDRESS) {
                 slave._test_receive_packet(p);
                 if (slave.available()) {
                     slave.read(); // This will trigger the sendAck and sendByte calls in the slave
-                    hal.ack_result = SUCCESS;
+                    transport.ack_result = SUCCESS;
                 } else {
-                    hal.ack_result = TIMEOUT;
+                    transport.ack_result = TIMEOUT;
                 }
             } else {
-                hal.ack_result = TIMEOUT;
+                transport.ack_result = TIMEOUT;
             }
         }
     };
@@ -136,12 +167,12 @@ TEST_F(LegacySusiE2ETest, Handshake) {
     _callback_fired_e2e = false;
     api.onBidiResponse(bidi_callback_e2e);
 
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         if (p.command == SUSI_CMD_BIDI_HOST_CALL && p.data == SLAVE_ADDRESS) {
             slave._test_receive_packet(p);
             if (slave.available()) {
                 slave.read();
-                hal.ack_result = SUCCESS;
+                transport.ack_result = SUCCESS;
             }
         }
     };
@@ -164,14 +195,14 @@ TEST_F(LegacySusiE2ETest, Poll) {
     api.onBidiResponse(bidi_callback_e2e);
 
     // Setup mock for packet sending.
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         if (p.command == SUSI_CMD_BIDI_HOST_CALL && p.data == SLAVE_ADDRESS) {
             slave._test_receive_packet(p);
             if (slave.available()) {
                 slave.read(); // This should trigger ACK and response from slave
-                hal.ack_result = SUCCESS;
+                transport.ack_result = SUCCESS;
             } else {
-                hal.ack_result = TIMEOUT;
+                transport.ack_result = TIMEOUT;
             }
         }
     };
@@ -207,18 +238,18 @@ TEST_F(LegacySusiE2ETest, Poll) {
 }
 
 TEST_F(LegacySusiE2ETest, readCVBank) {
-    hal.ack_result = SUCCESS;
+    transport.ack_result = SUCCESS;
 
     // Write some CVs to the slave
     api.writeCV(SLAVE_ADDRESS, 1, 10);
     api.writeCV(SLAVE_ADDRESS, 20, 20);
     api.writeCV(SLAVE_ADDRESS, 40, 30);
 
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         slave._test_receive_packet(p);
     };
 
-    hal.afterSendPacket = [&]() {
+    transport.afterSendPacket = [&]() {
         EXPECT_TRUE(slave.available());
         slave.read();
     };
@@ -228,18 +259,15 @@ TEST_F(LegacySusiE2ETest, readCVBank) {
     bank_data[0] = 10;
     bank_data[19] = 20;
     bank_data[39] = 30;
-    uint16_t crc = crc16_ccitt(bank_data, 40);
+    uint8_t crc = crc8_rcn218(bank_data, 40);
 
     for (int i = 0; i < 40; i++) {
         for (int j = 0; j < 8; j++) {
             hal.read_bits.push((bank_data[i] >> j) & 0x01);
         }
     }
-    for (int j = 0; j < 8; j++) {
-        hal.read_bits.push((crc >> (j + 8)) & 0x01);
-    }
-    for (int j = 0; j < 8; j++) {
-        hal.read_bits.push((crc >> j) & 0x01);
+    for (int j = 0; j < 16; j++) {
+        hal.read_bits.push(j < 8 && ((crc >> j) & 0x01)); // CRC-8 and a 0 byte
     }
 
     uint8_t received_data[40];
@@ -251,12 +279,12 @@ TEST_F(LegacySusiE2ETest, readCVBank) {
 }
 
 TEST_F(LegacySusiE2ETest, readCV_BiDi) {
-    hal.ack_result = SUCCESS;
+    transport.ack_result = SUCCESS;
 
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         slave._test_receive_packet(p);
     };
-    hal.afterSendPacket = [&]() {
+    transport.afterSendPacket = [&]() {
         EXPECT_TRUE(slave.available());
         slave.read();
     };
@@ -281,16 +309,16 @@ TEST_F(LegacySusiE2ETest, readCV_BiDi) {
 }
 
 TEST_F(LegacySusiE2ETest, readSpecialCVs) {
-    hal.ack_result = SUCCESS;
+    transport.ack_result = SUCCESS;
 
     slave.setManufacturerID(0x1234);
     slave.setHardwareID(0x5678);
     slave.setVersionNumber(0x9ABC);
 
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         slave._test_receive_packet(p);
     };
-    hal.afterSendPacket = [&]() {
+    transport.afterSendPacket = [&]() {
         EXPECT_TRUE(slave.available());
         slave.read();
     };
@@ -328,14 +356,14 @@ TEST_F(LegacySusiE2ETest, PollPositionResponse) {
     api.onBidiResponse(bidi_callback_e2e);
 
     // Setup mock for packet sending.
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         if (p.command == SUSI_CMD_BIDI_HOST_CALL && p.data == SLAVE_ADDRESS) {
             slave._test_receive_packet(p);
             if (slave.available()) {
                 slave.read(); // This should trigger ACK and response from slave
-                hal.ack_result = SUCCESS;
+                transport.ack_result = SUCCESS;
             } else {
-                hal.ack_result = TIMEOUT;
+                transport.ack_result = TIMEOUT;
             }
         }
     };
@@ -375,14 +403,14 @@ void LegacySusiE2ETest::runPollTest(const uint8_t* response_data) {
     api.onBidiResponse(bidi_callback_e2e);
 
     // Setup mock for packet sending.
-    hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         if (p.command == SUSI_CMD_BIDI_HOST_CALL && p.data == SLAVE_ADDRESS) {
             slave._test_receive_packet(p);
             if (slave.available()) {
                 slave.read(); // This should trigger ACK and response from slave
-                hal.ack_result = SUCCESS;
+                transport.ack_result = SUCCESS;
             } else {
-                hal.ack_result = TIMEOUT;
+                transport.ack_result = TIMEOUT;
             }
         }
     };
@@ -515,3 +543,58 @@ TEST_F(LegacySusiE2ETest, PollError) {
     EXPECT_EQ(_callback_data_e2e[2], SUSI_MSG_BIDI_EMPTY);
     EXPECT_EQ(_callback_data_e2e[3], 0);
 }
+
+namespace {
+    struct BidiEventE2E {
+        uint8_t address;
+        uint8_t header;
+        uint8_t data;
+    };
+    std::vector<BidiEventE2E> _bidi_events_e2e;
+
+    void bidi_event_callback_e2e(uint8_t address, uint8_t header, uint8_t data) {
+        _bidi_events_e2e.push_back({address, header, data});
+    }
+}
+
+TEST_F(LegacySusiE2ETest, PollDeliversTwoEventsPerHostCall) {
+    api.registerBiDiSlave(SLAVE_ADDRESS);
+    slave.enableBidirectionalMode();
+    _bidi_events_e2e.clear();
+    api.onBidiEvent(bidi_event_callback_e2e);
+
+    // The master reads back exactly what the slave sends.
+    int polls = 0;
+    transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+        if (p.command == SUSI_CMD_BIDI_HOST_CALL && p.data == SLAVE_ADDRESS) {
+            polls++;
+            slave._test_receive_packet(p);
+            slave.read();
+        }
+    };
+
+    slave.sendAutoSpeed(50, true);
+    slave.sendAnalogValue(0, 0x42);
+    slave.sendSignalState(3);
+    slave.sendError(1);
+
+    api.pollSlaves();
+    ASSERT_EQ(_bidi_events_e2e.size(), 2u);
+    EXPECT_EQ(_bidi_events_e2e[0].address, SLAVE_ADDRESS);
+    EXPECT_EQ(_bidi_events_e2e[0].header, SUSI_MSG_BIDI_ERROR);
+    EXPECT_EQ(_bidi_events_e2e[0].data, 1);
+    EXPECT_EQ(_bidi_events_e2e[1].header, SUSI_MSG_BIDI_AUTO_SPEED);
+    EXPECT_EQ(_bidi_events_e2e[1].data, 50 | 0x80);
+
+    api.pollSlaves();
+    ASSERT_EQ(_bidi_events_e2e.size(), 4u);
+    EXPECT_EQ(_bidi_events_e2e[2].header, SUSI_MSG_BIDI_SIGNAL_STATE);
+    EXPECT_EQ(_bidi_events_e2e[2].data, 3);
+    EXPECT_EQ(_bidi_events_e2e[3].header, SUSI_MSG_BIDI_ANALOG_A);
+    EXPECT_EQ(_bidi_events_e2e[3].data, 0x42);
+
+    // Four events in two host calls; an empty response yields no event
+    api.pollSlaves();
+    EXPECT_EQ(polls, 3);
+    EXPECT_EQ(_bidi_events_e2e.size(), 4u);
+}
@@ -0,0 +1,177 @@
+#include "gtest/gtest.h"
+#include "susi_slave.h"
+#include "susi_hal.h"
+#include "susi_commands.h"
+#include "mock_hal.h"
+
+// Runs two slaves with their own SusiHAL on different pins and clocks both
+// buses at the same time, so the edges of the two clock interrupts interleave.
+class SusiSlaveInstancesTest : public ::testing::Test {
+protected:
+    const uint8_t CLOCK_PIN_A = 2;
+    const uint8_t DATA_PIN_A = 3;
+    const uint8_t CLOCK_PIN_B = 4;
+    const uint8_t DATA_PIN_B = 5;
+    const unsigned long HALF_CLOCK_US = 10;
+
+    SusiHAL hal_a;
+    SusiHAL hal_b;
+    SUSI_Slave slave_a;
+    SUSI_Slave slave_b;
+
+    SusiSlaveInstancesTest()
+        : hal_a(CLOCK_PIN_A, DATA_PIN_A), hal_b(CLOCK_PIN_B, DATA_PIN_B),
+          slave_a(hal_a), slave_b(hal_b) {}
+
+    void SetUp() override {
+        mock_hal_reset();
+        ASSERT_TRUE(slave_a.begin(1));
+        ASSERT_TRUE(slave_b.begin(2));
+        digitalWrite(CLOCK_PIN_A, HIGH);
+        digitalWrite(DATA_PIN_A, HIGH);
+        digitalWrite(CLOCK_PIN_B, HIGH);
+        digitalWrite(DATA_PIN_B, HIGH);
+    }
+
+    static bool packetBit(const uint8_t* bytes, int index) {
+        if (index == 0) {
+            return false; // Start bit
+        }
+        if (index == 25) {
+            return true; // Stop bit
+        }
+        return (bytes[(index - 1) / 8] >> ((index - 1) % 8)) & 0x01;
+    }
+
+    // Clocks one packet on each bus, bit by bit in lockstep.
+    void sendPackets(const SUSI_Packet& a, const SUSI_Packet& b) {
+        uint8_t bytes_a[3] = {a.address, a.command, a.data};
+        uint8_t bytes_b[3] = {b.address, b.command, b.data};
+        for (int i = 0; i < 26; i++) {
+            digitalWrite(DATA_PIN_A, packetBit(bytes_a, i) ? HIGH : LOW);
+            digitalWrite(DATA_PIN_B, packetBit(bytes_b, i) ? HIGH : LOW);
+            digitalWrite(CLOCK_PIN_A, LOW);
+            digitalWrite(CLOCK_PIN_B, LOW);
+            delayMicroseconds(HALF_CLOCK_US);
+            digitalWrite(CLOCK_PIN_B, HIGH);
+            digitalWrite(CLOCK_PIN_A, HIGH);
+            delayMicroseconds(HALF_CLOCK_US);
+        }
+    }
+
+    // Clocks a packet on bus A only.
+    void sendPacketA(uint8_t address, uint8_t command, uint8_t data) {
+        uint8_t bytes[3] = {address, command, data};
+        for (int i = 0; i < 26; i++) {
+            digitalWrite(DATA_PIN_A, packetBit(bytes, i) ? HIGH : LOW);
+            digitalWrite(CLOCK_PIN_A, LOW);
+            delayMicroseconds(HALF_CLOCK_US);
+            digitalWrite(CLOCK_PIN_A, HIGH);
+            delayMicroseconds(HALF_CLOCK_US);
+        }
+    }
+};
+
+TEST_F(SusiSlaveInstancesTest, DecodesInterleavedPacketsOnBothBuses) {
+    SUSI_Packet speed = {1, SUSI_CMD_SET_SPEED, 0x80 | 50};
+    SUSI_Packet function = {2, SUSI_CMD_SET_FUNCTION, 0x80 | 3};
+    sendPackets(speed, function);
+
+    ASSERT_TRUE(slave_a.available());
+    ASSERT_TRUE(slave_b.available());
+
+    SUSI_Packet received_a = slave_a.read();
+    EXPECT_EQ(received_a.address, 1);
+    EXPECT_EQ(received_a.command, SUSI_CMD_SET_SPEED);
+    EXPECT_EQ(slave_a.getSpeed(), 50);
+    EXPECT_TRUE(slave_a.getDirection());
+
+    SUSI_Packet received_b = slave_b.read();
+    EXPECT_EQ(received_b.address, 2);
+    EXPECT_EQ(received_b.command, SUSI_CMD_SET_FUNCTION);
+    EXPECT_TRUE(slave_b.getFunction(3));
+    EXPECT_FALSE(slave_a.getFunction(3));
+}
+
+TEST_F(SusiSlaveInstancesTest, TrafficOnOneBusDoesNotReachTheOtherSlave) {
+    slave_b.addAddress(1);
+    sendPacketA(1, SUSI_CMD_SET_SPEED, 20);
+
+    EXPECT_TRUE(slave_a.available());
+    EXPECT_FALSE(slave_b.available());
+}
+
+TEST_F(SusiSlaveInstancesTest, AnswersForASetOfModuleNumbers) {
+    EXPECT_TRUE(slave_a.addAddress(3));
+    EXPECT_FALSE(slave_a.addAddress(0));
+    EXPECT_TRUE(slave_a.hasAddress(1));
+    EXPECT_TRUE(slave_a.hasAddress(3));
+    EXPECT_FALSE(slave_a.hasAddress(2));
+
+    sendPacketA(3, SUSI_CMD_SET_SPEED, 30);
+    ASSERT_TRUE(slave_a.available());
+    EXPECT_EQ(slave_a.read().address, 3);
+    EXPECT_EQ(slave_a.getSpeed(), 30);
+
+    sendPacketA(2, SUSI_CMD_SET_SPEED, 40);
+    EXPECT_FALSE(slave_a.available());
+
+    // CV 897 keeps reporting the address passed to begin()
+    EXPECT_EQ(slave_a.readCV(CV_SUSI_MODULE_NUM - 1), 1);
+}
+
+TEST_F(SusiSlaveInstancesTest, AddressSetIsLimited) {
+    for (uint8_t address = 10; address < 10 + SUSI_SLAVE_MAX_ADDRESSES - 1; address++) {
+        EXPECT_TRUE(slave_a.addAddress(address));
+    }
+    EXPECT_FALSE(slave_a.addAddress(100));
+    EXPECT_TRUE(slave_a.addAddress(10)) << "Adding a known address must succeed";
+}
+
+TEST_F(SusiSlaveInstancesTest, HostCallForAddedModuleIsAnsweredFromTheISR) {
+    slave_a.addAddress(3);
+    sendPacketA(0, SUSI_CMD_BIDI_HOST_CALL, 0x04 | 3);
+    EXPECT_FALSE(slave_a.available());
+
+    // Clock out the handshake response, sampling while the clock is low
+    uint8_t response[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 32; i++) {
+        digitalWrite(CLOCK_PIN_A, LOW);
+        delayMicroseconds(HALF_CLOCK_US);
+        if (pin_states[DATA_PIN_A] == HIGH) {
+            response[i / 8] |= 1 << (i % 8);
+        }
+        digitalWrite(CLOCK_PIN_A, HIGH);
+        delayMicroseconds(HALF_CLOCK_US);
+    }
+    EXPECT_EQ(response[0], SUSI_MSG_BIDI_STATUS);
+    EXPECT_EQ(response[2], SUSI_MSG_BIDI_STATUS);
+    EXPECT_TRUE(slave_a.isBidirectionalModeEnabled());
+    EXPECT_FALSE(slave_b.isBidirectionalModeEnabled());
+}
+
+TEST_F(SusiSlaveInstancesTest, BeginFailsWhenAllSlotsAreInUse) {
+    // Fill the slots left after slave_a and slave_b
+    SusiHAL extra_hal[4] = {
+        SusiHAL(10, 11), SusiHAL(12, 13), SusiHAL(14, 15), SusiHAL(16, 17)};
+    SUSI_Slave* extra[4] = {};
+    for (int i = 0; i < SUSI_MAX_SLAVE_INSTANCES - 2; i++) {
+        extra[i] = new SUSI_Slave(extra_hal[i]);
+        EXPECT_TRUE(extra[i]->begin(3));
+    }
+
+    SusiHAL hal_c(6, 7);
+    SUSI_Slave slave_c(hal_c);
+    EXPECT_FALSE(slave_c.begin(3));
+    EXPECT_EQ(isr_map.count(6), 0u);
+    for (int i = 0; i < SUSI_MAX_SLAVE_INSTANCES - 2; i++) {
+        delete extra[i];
+    }
+
+    // A slave on a pin that is already in use takes the slot over.
+    SUSI_Slave slave_d(hal_a);
+    EXPECT_TRUE(slave_d.begin(4));
+    sendPacketA(4, SUSI_CMD_SET_SPEED, 60);
+    EXPECT_TRUE(slave_d.available());
+    EXPECT_FALSE(slave_a.available());
+}
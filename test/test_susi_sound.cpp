@@ -2,6 +2,7 @@
 #include "susi_master.h"
 #include "susi_slave.h"
 #include "mock_susi_hal.h"
+#include "mock_susi_transport.h"
 #include <sstream>
 
 namespace {
@@ -17,11 +18,12 @@ protected:
     const uint8_t SLAVE_ADDRESS = 1;
 
     MockSusiHAL hal;
+    MockSusiTransport transport;
     SUSI_Master master;
     SUSI_Master_API api;
     SUSI_Slave slave;
 
-    SoundSusiE2ETest() : master(hal), api(master), slave(hal) {}
+    SoundSusiE2ETest() : transport(hal), master(transport), api(master), slave(hal) {}
 
     void SetUp() override {
         sound_output.str(""); // Clear the stream
@@ -29,7 +31,7 @@ protected:
         slave.begin(SLAVE_ADDRESS);
 
         // Forward packets from master to slave
-        hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+        transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
             slave._test_receive_packet(p);
             if (slave.available()) {
                 slave.read();
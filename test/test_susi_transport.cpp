@@ -0,0 +1,242 @@
+#include "gtest/gtest.h"
+#include "susi_master.h"
+#include "susi_slave.h"
+#include "susi_loopback_transport.h"
+#include "susi_spi_transport.h"
+#include "susi_commands.h"
+#include "mock_hal.h"
+#include "mock_clock.h"
+#include <SPI.h>
+#include <vector>
+
+TEST(SusiFrame, RoundTrip) {
+    SUSI_Packet packet = {0x5A, 0xC3, 0x81};
+    uint32_t frame = susiEncodeFrame(packet);
+
+    EXPECT_EQ(frame & 0x01, 0u) << "Start bit must be LOW";
+    EXPECT_EQ((frame >> 25) & 0x01, 1u) << "Stop bit must be HIGH";
+    EXPECT_EQ((frame >> 1) & 0x01, 0u); // LSB of the address first
+    EXPECT_EQ((frame >> 2) & 0x01, 1u);
+
+    SUSI_Packet decoded;
+    ASSERT_TRUE(susiDecodeFrame(frame, decoded));
+    EXPECT_EQ(decoded.address, packet.address);
+    EXPECT_EQ(decoded.command, packet.command);
+    EXPECT_EQ(decoded.data, packet.data);
+}
+
+TEST(SusiFrame, RejectsBadStartOrStopBit) {
+    SUSI_Packet packet = {1, 2, 3};
+    uint32_t frame = susiEncodeFrame(packet);
+    SUSI_Packet decoded;
+    EXPECT_FALSE(susiDecodeFrame(frame | 0x01, decoded));
+    EXPECT_FALSE(susiDecodeFrame(frame & ~((uint32_t)1 << 25), decoded));
+}
+
+struct LoopbackPeer {
+    std::vector<SUSI_Packet> packets;
+    std::vector<bool> acks;
+};
+
+static SusiMasterResult recordPacket(const SUSI_Packet& packet, bool expectAck, void* context) {
+    LoopbackPeer* peer = static_cast<LoopbackPeer*>(context);
+    peer->packets.push_back(packet);
+    peer->acks.push_back(expectAck);
+    return SUCCESS;
+}
+
+TEST(SusiLoopbackTransport, DeliversFramedPackets) {
+    LoopbackPeer peer;
+    SusiLoopbackTransport transport(recordPacket, &peer);
+    SUSI_Master master(transport);
+    SUSI_Master_API api(master);
+    api.begin();
+
+    EXPECT_EQ(api.writeCV(7, 291, 171), SUCCESS);
+    ASSERT_EQ(peer.packets.size(), 2u);
+    EXPECT_EQ(peer.packets[0].address, 7);
+    EXPECT_EQ(peer.packets[0].command, SUSI_CMD_WRITE_CV);
+    EXPECT_EQ(peer.packets[1].command, 0x22);
+    EXPECT_EQ(peer.packets[1].data, 171);
+    EXPECT_TRUE(peer.acks[1]);
+}
+
+TEST(SusiLoopbackTransport, MasterReadsQueuedResponse) {
+    LoopbackPeer peer;
+    SusiLoopbackTransport transport(recordPacket, &peer);
+    SUSI_Master master(transport);
+    SUSI_Master_API api(master);
+    api.begin();
+
+    uint8_t response[] = {SUSI_MSG_BIDI_CV_RESPONSE, 42, SUSI_MSG_BIDI_CV_RESPONSE, 43};
+    ASSERT_TRUE(transport.queueResponse(response, sizeof(response)));
+
+    uint8_t value = 0;
+    EXPECT_EQ(api.readCV(7, 10, value), SUCCESS);
+    EXPECT_EQ(value, 42);
+    EXPECT_EQ(transport.pendingResponse(), 0);
+    EXPECT_EQ(transport.readByte(), 0xFF) << "An idle line reads HIGH";
+}
+
+TEST(SusiLoopbackTransport, UnansweredPacketTimesOut) {
+    SusiLoopbackTransport transport;
+    SUSI_Master master(transport);
+    SUSI_Master_API api(master);
+
+    EXPECT_EQ(api.setSpeed(3, 10, true), TIMEOUT);
+    SUSI_Packet packet = {3, SUSI_CMD_SET_SPEED, 10};
+    EXPECT_EQ(master.sendPacket(packet, false), SUCCESS);
+}
+
+TEST(SusiLoopbackTransport, KeepsSyncGapsAndAckTimeoutOnItsClock) {
+    LoopbackPeer peer;
+    SusiLoopbackTransport transport(recordPacket, &peer);
+    MockClock clock;
+    transport.setClock(clock);
+    transport.begin();
+
+    SUSI_Packet packet = {3, SUSI_CMD_SET_SPEED, 10};
+    for (int i = 0; i < 20; i++) {
+        ASSERT_EQ(transport.sendPacket(packet, true), SUCCESS);
+    }
+    EXPECT_EQ(transport.ackLatency(), 0u);
+    uint32_t before = clock.delayed_us;
+    ASSERT_EQ(transport.sendPacket(packet, true), SUCCESS);
+    EXPECT_EQ(clock.delayed_us - before, 9000u) << "The 21st packet must follow a sync gap";
+
+    SusiLoopbackTransport silent;
+    silent.setClock(clock);
+    silent.setAckTimeout(3000);
+    before = clock.delayed_us;
+    EXPECT_EQ(silent.sendPacket(packet, true), TIMEOUT);
+    EXPECT_EQ(clock.delayed_us - before, 3000u);
+}
+
+TEST(SusiLoopbackTransport, ResponseBufferIsBounded) {
+    SusiLoopbackTransport transport;
+    uint8_t data[SUSI_LOOPBACK_BUFFER_SIZE] = {0};
+    EXPECT_TRUE(transport.queueResponse(data, SUSI_LOOPBACK_BUFFER_SIZE));
+    EXPECT_FALSE(transport.queueResponse(data, 1));
+}
+
+// A slave with a real SusiHAL on the pins that the mock SPI clocks.
+class SusiSPITransportTest : public ::testing::Test {
+protected:
+    const uint8_t CLOCK_PIN = 2;
+    const uint8_t DATA_PIN = 3;
+
+    SusiHAL master_hal;
+    SusiHAL slave_hal;
+    SusiSPITransport transport;
+    SUSI_Master master;
+    SUSI_Master_API api;
+    SUSI_Slave slave;
+
+    SusiSPITransportTest()
+        : master_hal(CLOCK_PIN, DATA_PIN), slave_hal(CLOCK_PIN, DATA_PIN),
+          transport(master_hal), master(transport), api(master), slave(slave_hal) {}
+
+    void SetUp() override {
+        mock_hal_reset();
+        SPI.reset();
+        SPI.attachPins(CLOCK_PIN, DATA_PIN, DATA_PIN);
+        api.begin();
+        slave.begin(1);
+        digitalWrite(CLOCK_PIN, HIGH);
+        digitalWrite(DATA_PIN, HIGH);
+    }
+};
+
+TEST_F(SusiSPITransportTest, SlaveDecodesPacketsShiftedOutBySPI) {
+    // Simulate the slave's ACK after the packet
+    ack_pulse_start_time = mock_micros_time + 2000;
+    ack_pulse_duration = 1000;
+
+    EXPECT_EQ(api.setSpeed(1, 77, true), SUCCESS);
+
+    EXPECT_TRUE(SPI.enabled);
+    EXPECT_EQ(SPI.settings.dataMode, SPI_MODE2);
+    EXPECT_EQ(SPI.settings.bitOrder, LSBFIRST);
+    ASSERT_EQ(SPI.transferred.size(), 4u);
+    EXPECT_EQ(SPI.transferred[0] & 0x7F, 0x3F) << "6 idle bits, then the start bit";
+
+    ASSERT_TRUE(slave.available());
+    SUSI_Packet packet = slave.read();
+    EXPECT_EQ(packet.command, SUSI_CMD_SET_SPEED);
+    EXPECT_EQ(slave.getSpeed(), 77);
+    EXPECT_TRUE(slave.getDirection());
+}
+
+TEST(SusiClock, MasterTimingRunsOnTheInjectedClock) {
+    mock_hal_reset();
+    SusiHAL hal(2, 3);
+    SUSI_Master master(hal);
+    MockClock clock(0xFFFFFFFF - 3000);
+    master.setClock(clock);
+    master.begin();
+    EXPECT_EQ(&hal.clock(), &clock);
+
+    // 20 packets of 26 clocks of 20 us wrap the clock around
+    SUSI_Packet packet = {1, SUSI_CMD_SET_SPEED, 0x81};
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(master.sendPacket(packet), SUCCESS);
+    }
+    EXPECT_EQ(clock.delayed_us, 20u * SUSI_FRAME_BITS * 20);
+    EXPECT_LT(clock.now_us, 0x10000u);
+
+    // The sync gap is timed exactly from the end of the last packet
+    EXPECT_EQ(master.syncGapRemaining(packet), 9000u);
+    clock.now_us += 5000;
+    EXPECT_EQ(master.syncGapRemaining(packet), 4000u);
+    uint32_t before = clock.delayed_us;
+    EXPECT_EQ(master.sendPacket(packet), SUCCESS);
+    EXPECT_EQ(clock.delayed_us - before, 4000u + SUSI_FRAME_BITS * 20);
+
+    // So is the ACK timeout, and mock time never moved
+    before = clock.now_us;
+    EXPECT_EQ(master.sendPacket(packet, true), TIMEOUT);
+    uint32_t ack_wait = clock.now_us - before - SUSI_FRAME_BITS * 20;
+    EXPECT_GT(ack_wait, 20000u);
+    EXPECT_LE(ack_wait, 20010u);
+    EXPECT_EQ(mock_micros_time, 0u);
+}
+
+TEST(SusiClock, SlaveDropsAStalledPacketOnItsClock) {
+    mock_hal_reset();
+    SusiHAL hal(2, 3);
+    MockClock clock(0xFFFFFFFF - 100);
+    hal.setClock(clock);
+    SUSI_Slave slave(hal);
+    slave.begin(1);
+    void (*clock_isr)() = isr_map[2];
+
+    auto clockBit = [&](bool bit) {
+        pin_states[3] = bit ? HIGH : LOW;
+        pin_states[2] = LOW;
+        clock_isr();
+        pin_states[2] = HIGH;
+        clock_isr();
+        clock.now_us += 20;
+    };
+    auto clockPacket = [&](uint8_t address, uint8_t command, uint8_t data, uint32_t stall_us) {
+        uint8_t bytes[3] = {address, command, data};
+        clockBit(false);
+        for (int i = 0; i < 24; i++) {
+            clockBit((bytes[i / 8] >> (i % 8)) & 0x01);
+            if (i == 11) {
+                clock.now_us += stall_us;
+            }
+        }
+        clockBit(true);
+    };
+
+    // A stall of 8 ms in the middle drops the packet, even across the wrap
+    clockPacket(1, SUSI_CMD_SET_SPEED, 0x85, 8100);
+    EXPECT_FALSE(slave.available());
+
+    clock.now_us += 10000;
+    clockPacket(1, SUSI_CMD_SET_SPEED, 0x85, 7000);
+    ASSERT_TRUE(slave.available());
+    slave.read();
+    EXPECT_EQ(slave.getSpeed(), 5);
+}
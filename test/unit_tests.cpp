@@ -66,8 +66,37 @@ TEST_F(SusiHALTest, WaitForAck_TooLong) {
     EXPECT_EQ(hal.waitForAck(), INVALID_ACK);
 }
 
+TEST_F(SusiHALTest, WaitForAck_ShortTimeout) {
+    // The timeout only limits the wait for the start of the ACK
+    ack_pulse_start_time = 3000;
+    ack_pulse_duration = 1000;
+    EXPECT_EQ(hal.waitForAck(2000), TIMEOUT);
+    EXPECT_LE(mock_micros_time, 2020u);
+
+    mock_micros_time = 0;
+    ack_pulse_start_time = 1500;
+    ack_pulse_duration = 5000;
+    EXPECT_EQ(hal.waitForAck(2000), SUCCESS);
+    EXPECT_GE(hal.ackLatency(), 1500u);
+    EXPECT_LE(hal.ackLatency(), 1510u);
+}
+
+TEST_F(SusiHALTest, WaitForAck_AcrossMicrosWrap) {
+    // The 32-bit microsecond counter wraps 4ms into the wait
+    mock_micros_time = 0xFFFFF000;
+    EXPECT_EQ(hal.waitForAck(), TIMEOUT);
+    EXPECT_GE(mock_micros_time - 0xFFFFF000, 20000u);
+    EXPECT_LE(mock_micros_time - 0xFFFFF000, 20020u);
+
+    mock_micros_time = 0xFFFFF000;
+    ack_pulse_start_time = mock_micros_time + 3500;
+    ack_pulse_duration = 1000;  // Ends after the wrap
+    EXPECT_EQ(hal.waitForAck(), SUCCESS);
+}
+
 
 #include "mock_susi_hal.h"
+#include "mock_susi_transport.h"
 
 class SUSIMasterAPITest : public ::testing::Test {
 protected:
@@ -75,10 +104,11 @@ protected:
     const uint8_t DATA_PIN = 3;
 
     MockSusiHAL mock_hal; // Use the mock HAL
+    MockSusiTransport mock_transport;
     SUSI_Master master;
     SUSI_Master_API api;
 
-    SUSIMasterAPITest() : master(mock_hal), api(master) {}
+    SUSIMasterAPITest() : mock_transport(mock_hal), master(mock_transport), api(master) {}
 
     void SetUp() override {
         mock_hal_reset();
@@ -94,7 +124,7 @@ TEST_F(SUSIMasterAPITest, Initialization) {
 
 TEST_F(SUSIMasterAPITest, SetFunction) {
     SUSI_Packet sentPacket;
-    mock_hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    mock_transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         sentPacket = p;
     };
 
@@ -106,7 +136,7 @@ TEST_F(SUSIMasterAPITest, SetFunction) {
 
 TEST_F(SUSIMasterAPITest, SetSpeed) {
     SUSI_Packet sentPacket;
-    mock_hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    mock_transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         sentPacket = p;
     };
 
@@ -118,7 +148,7 @@ TEST_F(SUSIMasterAPITest, SetSpeed) {
 
 TEST_F(SUSIMasterAPITest, WriteCV) {
     std::vector<SUSI_Packet> sentPackets;
-    mock_hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    mock_transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         sentPackets.push_back(p);
     };
 
@@ -133,7 +163,7 @@ TEST_F(SUSIMasterAPITest, WriteCV) {
 }
 
 TEST_F(SUSIMasterAPITest, GetFunction) {
-    mock_hal.ack_result = SUCCESS;
+    mock_transport.ack_result = SUCCESS;
 
     // Initially, the function should be off
     EXPECT_FALSE(api.getFunction(5, 10));
@@ -159,7 +189,7 @@ TEST_F(SUSIMasterAPITest, GetFunction) {
 }
 
 TEST_F(SUSIMasterAPITest, ReadCV_Success) {
-    mock_hal.ack_result = SUCCESS;
+    mock_transport.ack_result = SUCCESS;
 
     // This is a simplified test. A full end-to-end test
     // would be required to verify the data path.
@@ -172,27 +202,27 @@ TEST_F(SUSIMasterAPITest, ReadCV_Success) {
 }
 
 TEST_F(SUSIMasterAPITest, ReadCV_Timeout) {
-    mock_hal.ack_result = TIMEOUT;
+    mock_transport.ack_result = TIMEOUT;
     uint8_t value;
     EXPECT_EQ(api.readCV(5, 123, value), TIMEOUT);
     EXPECT_EQ(value, 0); // Should be set to 0 on failure
 }
 
 TEST_F(SUSIMasterAPITest, SetFunction_Error) {
-    mock_hal.ack_result = TIMEOUT;
+    mock_transport.ack_result = TIMEOUT;
     EXPECT_EQ(api.setFunction(10, 5, true), TIMEOUT);
 
-    mock_hal.ack_result = INVALID_ACK;
+    mock_transport.ack_result = INVALID_ACK;
     EXPECT_EQ(api.setFunction(10, 5, true), INVALID_ACK);
 }
 
 TEST_F(SUSIMasterAPITest, PerformHandshake) {
     std::vector<SUSI_Packet> sentPackets;
-    mock_hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    mock_transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         sentPackets.push_back(p);
     };
 
-    mock_hal.ack_result = SUCCESS;
+    mock_transport.ack_result = SUCCESS;
     // We need to push the bits for the 4-byte response
     uint8_t response[] = {SUSI_MSG_BIDI_STATUS, 0x00, SUSI_MSG_BIDI_STATUS, 0x00};
     for (int i = 0; i < 4; i++) {
@@ -215,11 +245,11 @@ TEST_F(SUSIMasterAPITest, PerformHandshake) {
 
 TEST_F(SUSIMasterAPITest, ReadCVBank_Success) {
     SUSI_Packet sentPacket;
-    mock_hal.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
+    mock_transport.onSendPacket = [&](const SUSI_Packet& p, bool expectAck) {
         sentPacket = p;
     };
 
-    mock_hal.ack_result = SUCCESS;
+    mock_transport.ack_result = SUCCESS;
 
     // Prepare the data that the slave will "send" back
     uint8_t bank_data[40];
@@ -227,7 +257,7 @@ TEST_F(SUSIMasterAPITest, ReadCVBank_Success) {
         bank_data[i] = i;
     }
 
-    uint16_t crc = crc16_ccitt(bank_data, 40);
+    uint8_t crc = crc8_rcn218(bank_data, 40);
 
     // Push the data and CRC into the mock HAL's read buffer
     for (int i = 0; i < 40; i++) {
@@ -235,11 +265,8 @@ TEST_F(SUSIMasterAPITest, ReadCVBank_Success) {
             mock_hal.read_bits.push((bank_data[i] >> j) & 0x01);
         }
     }
-    for (int j = 0; j < 8; j++) {
-        mock_hal.read_bits.push((crc >> (j + 8)) & 0x01);
-    }
-    for (int j = 0; j < 8; j++) {
-        mock_hal.read_bits.push((crc >> j) & 0x01);
+    for (int j = 0; j < 16; j++) {
+        mock_hal.read_bits.push(j < 8 && ((crc >> j) & 0x01)); // CRC-8 and a 0 byte
     }
 
     uint8_t received_data[40];
@@ -255,21 +282,18 @@ TEST_F(SUSIMasterAPITest, ReadCVBank_Success) {
 }
 
 TEST_F(SUSIMasterAPITest, ReadCVBank_InvalidCRC) {
-    mock_hal.ack_result = SUCCESS;
+    mock_transport.ack_result = SUCCESS;
 
     uint8_t bank_data[40] = {0};
-    uint16_t crc = 0x1234; // Invalid CRC
+    uint8_t crc = 0x12; // Invalid CRC
 
     for (int i = 0; i < 40; i++) {
         for (int j = 0; j < 8; j++) {
             mock_hal.read_bits.push((bank_data[i] >> j) & 0x01);
         }
     }
-    for (int j = 0; j < 8; j++) {
-        mock_hal.read_bits.push((crc >> (j + 8)) & 0x01);
-    }
-    for (int j = 0; j < 8; j++) {
-        mock_hal.read_bits.push((crc >> j) & 0x01);
+    for (int j = 0; j < 16; j++) {
+        mock_hal.read_bits.push(j < 8 && ((crc >> j) & 0x01)); // CRC-8 and a 0 byte
     }
 
     uint8_t received_data[40];
@@ -378,33 +402,33 @@ TEST_F(SUSISlaveTest, ReadSpecialCVs) {
     slave.setVersionNumber(0x0102);
 
     // Bank 0 should be selected by default
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID), 0x12);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID + 1), 0x34);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM), 0x01);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM + 1), 0x02);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID - 1), 0x12);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID + 1 - 1), 0x34);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM - 1), 0x01);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM + 1 - 1), 0x02);
 
     // Switch to bank 1
     SUSI_Packet packet;
     packet.address = SLAVE_ADDRESS;
     packet.command = SUSI_CMD_WRITE_CV;
-    packet.data = (CV_SUSI_CV_BANKING >> 8) & 0xFF;
+    packet.data = ((CV_SUSI_CV_BANKING - 1) >> 8) & 0xFF;
     slave._test_receive_packet(packet);
     slave.read();
 
-    packet.command = CV_SUSI_CV_BANKING & 0xFF;
+    packet.command = (CV_SUSI_CV_BANKING - 1) & 0xFF;
     packet.data = 1;
     slave._test_receive_packet(packet);
     slave.read();
 
     // Now, reading CV_MANUFACTURER_ID should return the hardware ID
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID), 0x56);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID + 1), 0x78);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID - 1), 0x56);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID + 1 - 1), 0x78);
 
     // Status bits
     slave.setStatusBits(1 << STATUS_BIT_WAIT);
-    EXPECT_EQ(slave.readCV(CV_STATUS_BITS), 1 << STATUS_BIT_WAIT);
+    EXPECT_EQ(slave.readCV(CV_STATUS_BITS - 1), 1 << STATUS_BIT_WAIT);
     slave.clearStatusBits(1 << STATUS_BIT_WAIT);
-    EXPECT_EQ(slave.readCV(CV_STATUS_BITS), 0);
+    EXPECT_EQ(slave.readCV(CV_STATUS_BITS - 1), 0);
 }
 
 TEST_F(SUSISlaveTest, ReadSpecialCVs_Banked) {
@@ -414,51 +438,51 @@ TEST_F(SUSISlaveTest, ReadSpecialCVs_Banked) {
 
     // Default bank 0
     // Reading any of the manufacturer ID CVs should return the manufacturer ID
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID), 0x12);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID + 1), 0x34);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_1), 0x12);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_1 + 1), 0x34);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_2), 0x12);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_2 + 1), 0x34);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID - 1), 0x12);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID + 1 - 1), 0x34);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_1 - 1), 0x12);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_1 + 1 - 1), 0x34);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_2 - 1), 0x12);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_2 + 1 - 1), 0x34);
 
     // Reading version number CV should return the version number
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM), 0x9A);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM + 1), 0xBC);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM - 1), 0x9A);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM + 1 - 1), 0xBC);
     // Reading other version number CVs should return 0, as they are for other banks
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_1), 0);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_1 + 1), 0);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_2), 0);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_2 + 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_1 - 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_1 + 1 - 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_2 - 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_2 + 1 - 1), 0);
 
 
     // Switch to bank 1
     SUSI_Packet packet;
     packet.address = SLAVE_ADDRESS;
     packet.command = SUSI_CMD_WRITE_CV;
-    packet.data = (CV_SUSI_CV_BANKING >> 8) & 0xFF;
+    packet.data = ((CV_SUSI_CV_BANKING - 1) >> 8) & 0xFF;
     slave._test_receive_packet(packet);
     slave.read();
 
-    packet.command = CV_SUSI_CV_BANKING & 0xFF;
+    packet.command = (CV_SUSI_CV_BANKING - 1) & 0xFF;
     packet.data = 1;
     slave._test_receive_packet(packet);
     slave.read();
 
     // Now, reading any of the manufacturer ID CVs should return the hardware ID
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID), 0x56);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID + 1), 0x78);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_1), 0x56);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_1 + 1), 0x78);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_2), 0x56);
-    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_2 + 1), 0x78);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID - 1), 0x56);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID + 1 - 1), 0x78);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_1 - 1), 0x56);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_1 + 1 - 1), 0x78);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_2 - 1), 0x56);
+    EXPECT_EQ(slave.readCV(CV_MANUFACTURER_ID_BANK_2 + 1 - 1), 0x78);
 
     // Reading any version number CVs should return 0
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM), 0);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM + 1), 0);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_1), 0);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_1 + 1), 0);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_2), 0);
-    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_2 + 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM - 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM + 1 - 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_1 - 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_1 + 1 - 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_2 - 1), 0);
+    EXPECT_EQ(slave.readCV(CV_VERSION_NUM_BANK_2 + 1 - 1), 0);
 }
 
 TEST_F(SUSISlaveTest, BiDiStatusResponse) {
@@ -483,14 +507,210 @@ TEST_F(SUSISlaveTest, BiDiStatusResponse) {
     slave.read();
 }
 
+namespace {
+int output_callbacks;
+uint32_t last_outputs;
+uint32_t last_changed;
+
+void recordOutputs(uint32_t outputs, uint32_t changed) {
+    output_callbacks++;
+    last_outputs = outputs;
+    last_changed = changed;
+}
+} // namespace
+
+TEST_F(SUSISlaveTest, DirectCommandsSetEightOutputsAtOnce) {
+    output_callbacks = 0;
+    slave.onOutputsChange(recordOutputs);
+
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_DIRECT_OUTPUTS + 1, 0xA5});
+    slave.read();
+    EXPECT_EQ(slave.getOutputs(), 0xA500u);
+    EXPECT_EQ(output_callbacks, 1);
+    EXPECT_EQ(last_outputs, 0xA500u);
+    EXPECT_EQ(last_changed, 0xA500u);
+
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_DIRECT_OUTPUTS + 3, 0x80});
+    slave.read();
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_DIRECT_OUTPUTS + 1, 0xA4});
+    slave.read();
+    EXPECT_EQ(slave.getOutputs(), 0x8000A400u);
+    EXPECT_EQ(output_callbacks, 3);
+    EXPECT_EQ(last_changed, 0x0100u);
+
+    // Repeating the state does not call back
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_DIRECT_OUTPUTS + 1, 0xA4});
+    slave.read();
+    EXPECT_EQ(output_callbacks, 3);
+
+    // Another module's outputs are ignored
+    slave._test_receive_packet({(uint8_t)(SLAVE_ADDRESS + 1), SUSI_CMD_DIRECT_OUTPUTS, 0xFF});
+    slave.read();
+    EXPECT_EQ(slave.getOutputs(), 0x8000A400u);
+}
+
+TEST_F(SUSISlaveTest, BinaryStatesShortAndLongForm) {
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_SHORT, 0x80 | 69});
+    slave.read();
+    EXPECT_TRUE(slave.getBinaryState(69));
+
+    // State 20000 = 156 * 128 + 32
+    hal.ack_count = 0;
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_LONG_L, 0x80 | 32});
+    slave.read();
+    EXPECT_FALSE(slave.getBinaryState(20000));
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_LONG_H, 156});
+    slave.read();
+    EXPECT_TRUE(slave.getBinaryState(20000));
+    EXPECT_EQ(hal.ack_count, 2);
+
+    // The high byte alone does nothing
+    hal.ack_count = 0;
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_LONG_H, 1});
+    slave.read();
+    EXPECT_EQ(hal.ack_count, 0);
+
+    // The short form with L = 0 only switches the states 1-127 off
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_SHORT, 0x00});
+    slave.read();
+    EXPECT_FALSE(slave.getBinaryState(69));
+    EXPECT_TRUE(slave.getBinaryState(20000));
+
+    // The long form with state 0 switches all states
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_LONG_L, 0x80});
+    slave.read();
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_LONG_H, 0});
+    slave.read();
+    EXPECT_TRUE(slave.getBinaryState(1));
+    EXPECT_TRUE(slave.getBinaryState(SUSI_BINARY_STATE_MAX));
+}
+
+TEST_F(SUSISlaveTest, PacketBetweenLongFormPacketsDropsThePair) {
+    // State 20000 = 156 * 128 + 32
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_LONG_L, 0x80 | 32});
+    slave.read();
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_SET_SPEED, 10});
+    slave.read();
+
+    hal.ack_count = 0;
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_LONG_H, 156});
+    slave.read();
+    EXPECT_EQ(hal.ack_count, 0);
+    EXPECT_FALSE(slave.getBinaryState(20000));
+}
+
+TEST_F(SUSISlaveTest, ShortFormBroadcastLeavesHigherStates) {
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_SHORT, 0x80 | 5});
+    slave.read();
+    // State 200 = 1 * 128 + 72
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_LONG_L, 0x80 | 72});
+    slave.read();
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_LONG_H, 1});
+    slave.read();
+    ASSERT_TRUE(slave.getBinaryState(200));
+
+    hal.ack_count = 0;
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_SHORT, 0x00});
+    slave.read();
+    EXPECT_EQ(hal.ack_count, 1);
+    EXPECT_FALSE(slave.getBinaryState(5));
+    EXPECT_TRUE(slave.getBinaryState(200));
+
+    // All on with the short form: 1-127 on, 200 unchanged, 128 still off
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BINARY_STATE_SHORT, 0x80});
+    slave.read();
+    EXPECT_TRUE(slave.getBinaryState(1));
+    EXPECT_TRUE(slave.getBinaryState(127));
+    EXPECT_FALSE(slave.getBinaryState(128));
+    EXPECT_TRUE(slave.getBinaryState(200));
+}
+
+TEST_F(SUSISlaveTest, VerifyByteIsOnlyAcknowledgedOnAMatch) {
+    const uint16_t cv = 920;
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_WRITE_CV, (uint8_t)((cv - 1) >> 8)});
+    slave.read();
+    slave._test_receive_packet({SLAVE_ADDRESS, (uint8_t)((cv - 1) & 0xFF), 0x5A});
+    slave.read();
+
+    auto verify = [&](uint8_t value) {
+        hal.ack_count = 0;
+        slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_VERIFY_CV_BYTE, (uint8_t)(0x80 | (cv - 897))});
+        slave.read();
+        slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_VERIFY_CV_BYTE, value});
+        slave.read();
+        return hal.ack_count;
+    };
+    EXPECT_EQ(verify(0x5A), 2);
+    EXPECT_EQ(verify(0x5B), 1);
+
+    // The next packet is decoded normally again
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_SET_SPEED, 0x85});
+    slave.read();
+    EXPECT_EQ(slave.getSpeed(), 5);
+}
+
+TEST_F(SUSISlaveTest, BitManipulationVerifiesAndWritesOneBit) {
+    const uint16_t cv = 1000;
+    auto bitCommand = [&](uint8_t data) {
+        hal.ack_count = 0;
+        slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_CV_BIT, (uint8_t)(0x80 | (cv - 897))});
+        slave.read();
+        slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_CV_BIT, data});
+        slave.read();
+        return hal.ack_count;
+    };
+
+    EXPECT_EQ(bitCommand(0xE0 | 0x10 | 0x08 | 5), 2); // Write 1 to bit 5
+    EXPECT_EQ(slave.readCV(cv - 1), 0x20);
+    EXPECT_EQ(bitCommand(0xE0 | 0x08 | 5), 2);        // Verify bit 5 is 1
+    EXPECT_EQ(bitCommand(0xE0 | 5), 1);               // Verify bit 5 is 0
+    EXPECT_EQ(bitCommand(0xE0 | 0x10 | 5), 2);        // Write 0 to bit 5
+    EXPECT_EQ(slave.readCV(cv - 1), 0x00);
+}
+
+TEST_F(SUSISlaveTest, BiDiReadCVAnswersTheCVAndTheNextOne) {
+    slave.setManufacturerID(0x1234);
+    slave.setVersionNumber(0x0102);
+    std::vector<uint8_t> sent;
+    hal.onSendByte = [&](uint8_t byte) { sent.push_back(byte); };
+
+    // CVs 900 and 901, the manufacturer ID
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BIDI_READ_CV,
+                                (uint8_t)(CV_MANUFACTURER_ID - SUSI_BIDI_READ_CV_OFFSET)});
+    slave.read();
+    std::vector<uint8_t> expected = {SUSI_MSG_BIDI_CV_RESPONSE, 0x12, SUSI_MSG_BIDI_CV_RESPONSE, 0x34};
+    EXPECT_EQ(sent, expected);
+
+    // CVs 902 and 903, the version number
+    sent.clear();
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BIDI_READ_CV,
+                                (uint8_t)(CV_VERSION_NUM - SUSI_BIDI_READ_CV_OFFSET)});
+    slave.read();
+    expected = {SUSI_MSG_BIDI_CV_RESPONSE, 0x01, SUSI_MSG_BIDI_CV_RESPONSE, 0x02};
+    EXPECT_EQ(sent, expected);
+
+    // There is no CV after 1024
+    sent.clear();
+    slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_BIDI_READ_CV, 255});
+    slave.read();
+    expected = {SUSI_MSG_BIDI_CV_RESPONSE, slave.readCV(1023), SUSI_MSG_BIDI_ERROR,
+                SUSI_BIDI_ERROR_CV_NOT_AVAILABLE};
+    EXPECT_EQ(sent, expected);
+}
+
 #include "EEPROM.h"
 
-// --- Constants for EEPROM layout ---
+// --- Constants for the legacy EEPROM layout ---
 const uint8_t EEPROM_MAGIC_BYTE_TEST = 0x55;
 const int EEPROM_ADDR_MAGIC_TEST = 0;
 const int EEPROM_ADDR_CV_COUNT_TEST = 1;
 const int EEPROM_ADDR_CV_DATA_START_TEST = 2;
 
+// --- Constants for the CV log layout ---
+const uint8_t CV_LOG_MAGIC_TEST = 0x5C;
+const int CV_LOG_HEADER_SIZE_TEST = 7;
+const int CV_LOG_RECORD_SIZE_TEST = 5;
+
 
 // Test fixture for CV persistence tests
 class SUSISlaveCVPersistenceTest : public ::testing::Test {
@@ -507,8 +727,10 @@ protected:
     void SetUp() override {
         mock_hal_reset();
 
-        // "Clear" the EEPROM before each test by writing a different magic byte
-        EEPROM.write(EEPROM_ADDR_MAGIC_TEST, 0x00);
+        // Start every test with an erased EEPROM
+        EEPROM.write_latency_us = 0;
+        EEPROM.read_latency_us = 0;
+        EEPROM.clear();
     }
 
     // Helper to simulate writing a CV via SUSI packets
@@ -525,50 +747,77 @@ protected:
         slave._test_receive_packet(p);
         slave.read();
     }
+
+    // Helper to read a CV back after a simulated restart
+    uint8_t readAfterRestart(uint16_t cv) {
+        SUSI_Slave restarted(hal);
+        restarted.begin(SLAVE_ADDRESS);
+        return restarted.readCV(cv);
+    }
+
+    int halfSize() const {
+        return EEPROM.length() / 2;
+    }
 };
 
-TEST_F(SUSISlaveCVPersistenceTest, BeginInitializesEmptyEEPROM) {
+TEST_F(SUSISlaveCVPersistenceTest, BeginFormatsEmptyEEPROM) {
+    EEPROM.write_latency_us = 3300; // AVR byte write time
+    unsigned long start = mock_micros_time;
     slave.begin(SLAVE_ADDRESS);
 
-    // Check that the magic byte and a CV count of 0 were written
-    EXPECT_EQ(EEPROM.read(EEPROM_ADDR_MAGIC_TEST), EEPROM_MAGIC_BYTE_TEST);
-    EXPECT_EQ(EEPROM.read(EEPROM_ADDR_CV_COUNT_TEST), 0);
+    // The format is deferred to idle time like any other write
+    EXPECT_EQ(mock_micros_time - start, 0u);
+    EXPECT_GT(slave.pendingCVWrites(), 0);
+    EXPECT_NE(EEPROM.read(halfSize()), CV_LOG_MAGIC_TEST);
+
+    // The first generation is written to the second half, header last
+    slave.flushCVs();
+    SusiCVLogStats stats;
+    slave.getCVStorageStats(stats);
+    EXPECT_EQ(stats.generation, 1);
+    EXPECT_EQ(EEPROM.read(halfSize()), CV_LOG_MAGIC_TEST);
+    EXPECT_EQ(slave.pendingCVWrites(), 0);
 }
 
-TEST_F(SUSISlaveCVPersistenceTest, WriteNewCVUpdatesEEPROM) {
+TEST_F(SUSISlaveCVPersistenceTest, WriteNewCVPersistsAcrossRestart) {
     slave.begin(SLAVE_ADDRESS);
     writeCV(123, 45);
 
     // Check RAM
     EXPECT_EQ(slave.readCV(123), 45);
 
-    // Check EEPROM
-    EXPECT_EQ(EEPROM.read(EEPROM_ADDR_CV_COUNT_TEST), 1);
-    uint16_t key;
-    EEPROM.get(EEPROM_ADDR_CV_DATA_START_TEST, key);
-    EXPECT_EQ(key, 123);
-    EXPECT_EQ(EEPROM.read(EEPROM_ADDR_CV_DATA_START_TEST + 2), 45);
+    // Check EEPROM once the deferred writes are committed
+    slave.flushCVs();
+    EXPECT_EQ(readAfterRestart(123), 45);
+    EXPECT_EQ(readAfterRestart(99), 0); // Check a non-existent CV
 }
 
-TEST_F(SUSISlaveCVPersistenceTest, UpdateExistingCVUpdatesEEPROM) {
+TEST_F(SUSISlaveCVPersistenceTest, UpdateExistingCVAppendsRecord) {
     slave.begin(SLAVE_ADDRESS);
+    slave.flushCVs(); // Format the EEPROM
     writeCV(123, 45); // First write
+    slave.flushCVs();
     writeCV(123, 99); // Second write to the same CV
+    slave.flushCVs();
 
     // Check RAM
     EXPECT_EQ(slave.readCV(123), 99);
 
-    // Check EEPROM (count should still be 1, but value should be updated)
-    EXPECT_EQ(EEPROM.read(EEPROM_ADDR_CV_COUNT_TEST), 1);
-    uint16_t key;
-    EEPROM.get(EEPROM_ADDR_CV_DATA_START_TEST, key);
-    EXPECT_EQ(key, 123);
-    EXPECT_EQ(EEPROM.read(EEPROM_ADDR_CV_DATA_START_TEST + 2), 99);
-}
+    // The update is appended as a new record, the first record is not rewritten
+    int first_value_cell = halfSize() + CV_LOG_HEADER_SIZE_TEST + 3;
+    EXPECT_EQ(EEPROM.read(first_value_cell), 45);
+    EXPECT_EQ(EEPROM.writeCount(first_value_cell), 1u);
+    EXPECT_EQ(EEPROM.read(first_value_cell + CV_LOG_RECORD_SIZE_TEST), 99);
 
+    SusiCVLogStats stats;
+    slave.getCVStorageStats(stats);
+    EXPECT_EQ(stats.cv_writes, 2u);
 
-TEST_F(SUSISlaveCVPersistenceTest, BeginLoadsDataFromEEPROM) {
-    // Manually "pre-load" the mock EEPROM with data
+    EXPECT_EQ(readAfterRestart(123), 99);
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, BeginMigratesLegacyLayout) {
+    // Manually "pre-load" the mock EEPROM with data in the old layout
     EEPROM.write(EEPROM_ADDR_MAGIC_TEST, EEPROM_MAGIC_BYTE_TEST);
     EEPROM.write(EEPROM_ADDR_CV_COUNT_TEST, 2);
     // CV[0]: key=10, value=20
@@ -585,6 +834,346 @@ TEST_F(SUSISlaveCVPersistenceTest, BeginLoadsDataFromEEPROM) {
     EXPECT_EQ(slave.readCV(10), 20);
     EXPECT_EQ(slave.readCV(30), 40);
     EXPECT_EQ(slave.readCV(99), 0); // Check a non-existent CV
+
+    // The CVs now live in the new log format
+    slave.flushCVs();
+    EXPECT_EQ(EEPROM.read(halfSize()), CV_LOG_MAGIC_TEST);
+    EXPECT_EQ(readAfterRestart(10), 20);
+    EXPECT_EQ(readAfterRestart(30), 40);
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, WriteCVDoesNotBlockOnEEPROM) {
+    slave.begin(SLAVE_ADDRESS);
+    EEPROM.write_latency_us = 3300; // AVR byte write time
+
+    unsigned long start = mock_micros_time;
+    writeCV(123, 45);
+    unsigned long elapsed = mock_micros_time - start;
+
+    // The command path only touches RAM.
+    EXPECT_EQ(elapsed, 0u);
+    EXPECT_EQ(slave.readCV(123), 45);
+    EXPECT_GT(slave.pendingCVWrites(), 0);
+    EXPECT_EQ(readAfterRestart(123), 0);
+
+    slave.flushCVs();
+    EXPECT_EQ(slave.pendingCVWrites(), 0);
+    EXPECT_EQ(readAfterRestart(123), 45);
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, IdleCommitsOneByteAtATimeChecksumLast) {
+    slave.begin(SLAVE_ADDRESS);
+    slave.flushCVs(); // Format the EEPROM
+    EEPROM.write_latency_us = 3300;
+    writeCV(123, 45);
+
+    // A power loss before the record's checksum is written loses only this write.
+    for (int i = 0; i < CV_LOG_RECORD_SIZE_TEST - 1; i++) {
+        unsigned long start = mock_micros_time;
+        EXPECT_FALSE(slave.available());
+        EXPECT_LE(mock_micros_time - start, 3300u);
+        EXPECT_EQ(readAfterRestart(123), 0);
+    }
+
+    EXPECT_FALSE(slave.available());
+    EXPECT_EQ(slave.pendingCVWrites(), 0);
+    EXPECT_EQ(readAfterRestart(123), 45);
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, FullQueueNeverDropsWrites) {
+    slave.begin(SLAVE_ADDRESS);
+    EEPROM.write_latency_us = 3300;
+
+    // More changed CVs than the log can hold back at once. The overflow is
+    // left to a compaction instead of writing the EEPROM on the command path.
+    unsigned long start = mock_micros_time;
+    for (uint16_t cv = 10; cv < 10 + SUSI_CV_LOG_DIRTY_SIZE + 4; cv++) {
+        writeCV(cv, cv * 2);
+    }
+    EXPECT_EQ(mock_micros_time - start, 0u);
+    EXPECT_EQ(hal.ack_count, 2 * (SUSI_CV_LOG_DIRTY_SIZE + 4));
+    slave.flushCVs();
+
+    SUSI_Slave reloaded(hal);
+    reloaded.begin(SLAVE_ADDRESS);
+    for (uint16_t cv = 10; cv < 10 + SUSI_CV_LOG_DIRTY_SIZE + 4; cv++) {
+        EXPECT_EQ(reloaded.readCV(cv), cv * 2);
+    }
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, ChangesWhileCompactingAreNotLost) {
+    slave.begin(SLAVE_ADDRESS);
+    for (uint16_t cv = 1; cv <= 20; cv++) {
+        writeCV(cv, cv);
+    }
+    slave.flushCVs();
+
+    // Overflowing the dirty set starts a compaction
+    for (uint16_t cv = 1; cv <= 20; cv++) {
+        writeCV(cv, cv + 100);
+    }
+    for (int i = 0; i < 30; i++) {
+        slave.available();
+    }
+
+    // It has passed the low CVs when they change again and overflow the
+    // dirty set, so another compaction follows.
+    for (uint16_t cv = 20; cv >= 1; cv--) {
+        writeCV(cv, cv + 150);
+    }
+    slave.flushCVs();
+
+    SUSI_Slave reloaded(hal);
+    reloaded.begin(SLAVE_ADDRESS);
+    for (uint16_t cv = 1; cv <= 20; cv++) {
+        EXPECT_EQ(reloaded.readCV(cv), cv + 150);
+    }
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, WriteThatCannotBePersistedIsNotAcknowledged) {
+    slave.begin(SLAVE_ADDRESS);
+    SusiCVLogStats stats;
+
+    // More live CVs than one log half holds, in the window below the ID banks
+    uint16_t cv = 910;
+    do {
+        writeCV(cv++, 1);
+        slave.flushCVs();
+        slave.getCVStorageStats(stats);
+    } while (!stats.overflow && cv < 980);
+    ASSERT_TRUE(stats.overflow);
+
+    int acks = hal.ack_count;
+    writeCV(cv, 7);
+    EXPECT_EQ(slave.readCV(cv), 7); // Kept in RAM
+    EXPECT_EQ(hal.ack_count, acks + 1); // Only the first packet
+
+    // Resetting the CVs makes room again
+    slave.resetCVs();
+    slave.flushCVs();
+    writeCV(cv, 7);
+    EXPECT_EQ(hal.ack_count, acks + 3);
+    slave.flushCVs();
+    EXPECT_EQ(readAfterRestart(cv), 7);
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, StoresMoreThan32CVsInWindow) {
+    slave.begin(SLAVE_ADDRESS);
+
+    // Sound modules use many CVs in the 900-1000 range; skip the ID banks
+    // (keys 979-982) and the status bits (key 1019).
+    for (uint16_t cv = 944; cv < 1019; cv++) {
+        if (cv < 979 || cv >= 983) {
+            writeCV(cv, cv - 900);
+        }
+    }
+    for (uint16_t cv = 944; cv < 1019; cv++) {
+        if (cv < 979 || cv >= 983) {
+            EXPECT_EQ(slave.readCV(cv), cv - 900);
+        }
+    }
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, CompactionKeepsLatestValues) {
+    slave.begin(SLAVE_ADDRESS);
+
+    for (uint16_t cv = 1; cv <= 20; cv++) {
+        writeCV(cv, cv);
+    }
+    slave.flushCVs();
+
+    // Enough updates to fill both halves several times
+    for (int round = 0; round < 20; round++) {
+        for (uint16_t cv = 1; cv <= 10; cv++) {
+            writeCV(cv, cv + round);
+            slave.flushCVs();
+        }
+    }
+
+    SusiCVLogStats stats;
+    slave.getCVStorageStats(stats);
+    EXPECT_GT(stats.compactions, 2);
+    EXPECT_FALSE(stats.overflow);
+
+    SUSI_Slave reloaded(hal);
+    reloaded.begin(SLAVE_ADDRESS);
+    for (uint16_t cv = 1; cv <= 10; cv++) {
+        EXPECT_EQ(reloaded.readCV(cv), cv + 19);
+    }
+    for (uint16_t cv = 11; cv <= 20; cv++) {
+        EXPECT_EQ(reloaded.readCV(cv), cv);
+    }
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, InterruptedCompactionKeepsPreviousGeneration) {
+    slave.begin(SLAVE_ADDRESS);
+    for (uint16_t cv = 1; cv <= 20; cv++) {
+        writeCV(cv, cv);
+    }
+    slave.flushCVs();
+
+    // Fill the active half until the next change needs a compaction
+    SusiCVLogStats before;
+    SusiCVLogStats stats;
+    slave.getCVStorageStats(before);
+    uint8_t value = 0;
+    do {
+        writeCV(5, ++value);
+        slave.flushCVs();
+        slave.getCVStorageStats(stats);
+    } while (stats.compactions == before.compactions);
+
+    // 20 live records in a half of 49 slots: 29 more appends fill it up
+    int free_slots = (halfSize() - CV_LOG_HEADER_SIZE_TEST) / CV_LOG_RECORD_SIZE_TEST - 20;
+    for (int i = 0; i < free_slots; i++) {
+        writeCV(5, ++value);
+        slave.flushCVs();
+    }
+    slave.getCVStorageStats(before);
+
+    writeCV(6, 200);
+    for (int i = 0; i < 30; i++) {
+        slave.available(); // Power fails in the middle of the compaction
+    }
+    slave.getCVStorageStats(stats);
+    EXPECT_EQ(stats.compactions, before.compactions);
+
+    SUSI_Slave reloaded(hal);
+    reloaded.begin(SLAVE_ADDRESS);
+    EXPECT_EQ(reloaded.readCV(5), value);
+    EXPECT_EQ(reloaded.readCV(6), 6);
+    EXPECT_EQ(reloaded.readCV(20), 20);
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, WearLevelling100kWritesToOneCV) {
+    slave.begin(SLAVE_ADDRESS);
+    writeCV(1, 0);
+    slave.flushCVs();
+
+    const uint32_t writes = 100000;
+    for (uint32_t i = 1; i <= writes; i++) {
+        writeCV(123, i & 0xFF);
+        slave.flushCVs();
+    }
+
+    SusiCVLogStats stats;
+    slave.getCVStorageStats(stats);
+    ::testing::Test::RecordProperty("max_cell_writes", EEPROM.maxWriteCount());
+    ::testing::Test::RecordProperty("eeprom_writes", stats.eeprom_writes);
+    ::testing::Test::RecordProperty("compactions", stats.compactions);
+
+    // An in-place layout writes the same cell 100k times; the log spreads the
+    // writes over both halves.
+    EXPECT_LT(EEPROM.maxWriteCount(), writes / 40);
+    EXPECT_LT(stats.eeprom_writes, writes * 8);
+    EXPECT_EQ(readAfterRestart(123), writes & 0xFF);
+    EXPECT_EQ(readAfterRestart(1), 0);
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, DamagedRecordIsSkippedAndLogCompacted) {
+    slave.begin(SLAVE_ADDRESS);
+    slave.flushCVs(); // Format the EEPROM
+    for (uint16_t cv = 10; cv < 15; cv++) {
+        writeCV(cv, cv - 9);
+        slave.flushCVs();
+    }
+
+    // Flip the value of the third record; its checksum no longer matches.
+    int value_cell = halfSize() + CV_LOG_HEADER_SIZE_TEST + 2 * CV_LOG_RECORD_SIZE_TEST + 3;
+    EEPROM.write(value_cell, 0x99);
+
+    SUSI_Slave restarted(hal);
+    restarted.begin(SLAVE_ADDRESS);
+    EXPECT_EQ(restarted.readCV(11), 2);
+    EXPECT_EQ(restarted.readCV(12), 0) << "A damaged record must fall back to the default";
+    EXPECT_EQ(restarted.readCV(13), 4) << "Records behind a damaged one must not be lost";
+    EXPECT_EQ(restarted.readCV(14), 5);
+
+    SusiCVLogStats stats;
+    restarted.getCVStorageStats(stats);
+    EXPECT_EQ(stats.corrupt_records, 1);
+    EXPECT_GT(restarted.pendingCVWrites(), 0);
+
+    // The damaged half is retired by a compaction.
+    restarted.flushCVs();
+    restarted.getCVStorageStats(stats);
+    EXPECT_EQ(stats.generation, 2);
+    EXPECT_EQ(readAfterRestart(13), 4);
+    EXPECT_EQ(readAfterRestart(12), 0);
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, BootReadsLogInBlocks) {
+    slave.begin(SLAVE_ADDRESS);
+    const uint16_t cvs = 30;
+    for (uint16_t cv = 1; cv <= cvs; cv++) {
+        writeCV(cv, cv + 100);
+        slave.flushCVs();
+    }
+
+    // Charge a fixed setup time per EEPROM access to measure boot-to-ready.
+    EEPROM.read_latency_us = 50;
+    uint32_t reads_before = EEPROM.readCount();
+    SUSI_Slave restarted(hal);
+    restarted.begin(SLAVE_ADDRESS);
+    uint32_t reads = EEPROM.readCount() - reads_before;
+
+    for (uint16_t cv = 1; cv <= cvs; cv++) {
+        EXPECT_EQ(restarted.readCV(cv), cv + 100);
+    }
+
+    SusiCVLogStats stats;
+    restarted.getCVStorageStats(stats);
+    ::testing::Test::RecordProperty("boot_eeprom_reads", (int)reads);
+    ::testing::Test::RecordProperty("boot_load_time_us", (int)stats.load_time_us);
+
+    // Reading the 30 records byte by byte takes 150 accesses.
+    EXPECT_LT(reads, 30u);
+    EXPECT_EQ(stats.corrupt_records, 0);
+    // RCN-600 modules may go autonomous 100ms after reset, loading must be far quicker.
+    EXPECT_LT(stats.load_time_us, 2000u);
+}
+
+TEST_F(SUSISlaveCVPersistenceTest, BankReadStreamsFromReadyImage) {
+    slave.begin(SLAVE_ADDRESS);
+    for (uint16_t cv = 40; cv < 64; cv++) {
+        writeCV(cv, cv * 3);
+    }
+    for (uint16_t cv = 944; cv < 980; cv++) {
+        writeCV(cv, cv & 0xFF);
+    }
+    writeCV(45, 7); // Update after the image was built
+    uint8_t level = 99;
+    ASSERT_TRUE(slave.bindCVMemory(70, 1, &level, false));
+
+    uint8_t expected[40] = {0};
+    for (int i = 0; i < 24; i++) {
+        expected[i] = (40 + i) * 3;
+    }
+    expected[5] = 7;
+    expected[30] = 99;
+
+    std::vector<uint8_t> sent;
+    hal.onSendByte = [&](uint8_t byte) { sent.push_back(byte); };
+
+    // Only the bound CV is looked up again; the stored CVs are sent from the
+    // image without a lookup per byte.
+    for (int run = 0; run < 3; run++) {
+        sent.clear();
+        uint32_t lookups = slave._test_cv_lookups();
+        slave._test_receive_packet({SLAVE_ADDRESS, SUSI_CMD_READ_CV_BANK_1, 0});
+        slave.read();
+        EXPECT_EQ(slave._test_cv_lookups() - lookups, 1u);
+
+        ASSERT_EQ(sent.size(), 42u);
+        for (int i = 0; i < 40; i++) {
+            EXPECT_EQ(sent[i], expected[i]) << "byte " << i;
+        }
+        EXPECT_EQ(sent[40], crc8_rcn218(expected, 40));
+        EXPECT_EQ(sent[41], 0);
+
+        level++;
+        expected[30]++;
+    }
 }
 
 // --- Test Fixture for ISR Initialization Bug ---
@@ -601,26 +1190,15 @@ public:
 class SUSISlaveISRTest : public ::testing::Test {
 protected:
     SpyingMockSusiHAL hal;
-    SUSI_Slave slave;
-
-    SUSISlaveISRTest() : slave(hal) {}
 
     void SetUp() override {
         mock_hal_reset();
-        // Explicitly clear the global instance to simulate startup state
-        _susi_slave_instance = nullptr;
-    }
-
-    void TearDown() override {
-        _susi_slave_instance = nullptr;
     }
 };
 
-TEST_F(SUSISlaveISRTest, BeginInitializesGlobalInstance) {
-    // Before begin, it should be null
-    EXPECT_EQ(_susi_slave_instance, nullptr);
-
-    slave.begin(1);
+TEST_F(SUSISlaveISRTest, BeginRegistersClockInterrupt) {
+    SUSI_Slave slave(hal);
+    EXPECT_TRUE(slave.begin(1));
 
     // Check if ISR is registered on the clock pin (0 in MockSusiHAL)
     uint8_t clock_pin = hal.get_clock_pin();
@@ -631,8 +1209,15 @@ TEST_F(SUSISlaveISRTest, BeginInitializesGlobalInstance) {
         FAIL() << "ISR not registered on clock pin " << (int)clock_pin;
     }
 
-    // With the bug, _susi_slave_instance is null, so handleClockFall() is not called.
-    // So read_data() is not called.
-    // With the fix, it should be called.
-    EXPECT_GT(hal.read_data_calls, 0) << "ISR did not call read_data(), indicating _susi_slave_instance might be null";
+    EXPECT_GT(hal.read_data_calls, 0) << "ISR did not call read_data(), the slave is not registered";
+}
+
+TEST_F(SUSISlaveISRTest, DestructorReleasesClockInterrupt) {
+    uint8_t clock_pin = hal.get_clock_pin();
+    {
+        SUSI_Slave slave(hal);
+        slave.begin(1);
+        EXPECT_EQ(isr_map.count(clock_pin), 1u);
+    }
+    EXPECT_EQ(isr_map.count(clock_pin), 0u);
 }